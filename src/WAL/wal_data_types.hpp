@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 namespace WAL {
 
 using OpID = uint32_t;
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace WAL {
+
+// The group commit timeout for WAL::FlushTimeoutMode::Adaptive: how long the first writer of a block waits for more entries before sealing and flushing it.
+// A longer wait puts more operations into each flush, but every operation in the block pays for it with commit latency.
+// The timeout is bounded by the time it takes to fill a block at the recent arrival rate (waiting for more than fits is pointless),
+// and by the commit latency target minus the recent p99 flush latency, so that waiting and flushing together stay within the target.
+// Within these bounds it follows the blocks sealed on timeout: if nothing else arrived during the wait, the wait was wasted and the timeout is halved.
+// If the entries stopped arriving early on, it shrinks towards twice the time they took, otherwise it grows. A lone writer ends up not waiting at all.
+// blockSealed() and flushed() may be called concurrently with each other, but each one by a single thread at a time.
+class AdaptiveFlushTimeout
+{
+public:
+	struct Stats {
+		uint64_t timeoutUs = 0;
+		double arrivalRateOpsPerSecond = 0.0;
+		uint64_t flushLatencyUs = 0;
+		uint64_t flushLatencyP99Us = 0; // Estimate
+	};
+
+	constexpr AdaptiveFlushTimeout(const uint64_t maxTimeoutUs, const uint64_t latencyTargetUs, const size_t blockCapacity) noexcept :
+		_maxTimeoutUs{ maxTimeoutUs },
+		_latencyTargetUs{ latencyTargetUs },
+		_blockCapacity{ static_cast<double>(blockCapacity) },
+		_timeoutUs{ std::min(maxTimeoutUs, latencyTargetUs) }
+	{}
+
+	[[nodiscard]] uint64_t timeoutUs() const noexcept
+	{
+		return _timeoutUs.load(std::memory_order_relaxed);
+	}
+
+	// A block holding 'count' entries and completion markers, 'size' bytes in total, has been sealed at 'timeStampUs'.
+	// 'arrivalSpanUs' is the time between the first and the last of them being added.
+	void blockSealed(const size_t count, const size_t size, const uint64_t timeStampUs, const bool onTimeout, const uint64_t arrivalSpanUs = 0) noexcept
+	{
+		const uint64_t previousTimeStamp = _lastSealTimeStampUs;
+		_lastSealTimeStampUs = timeStampUs;
+		if (previousTimeStamp != 0 && timeStampUs > previousTimeStamp)
+		{
+			const double intervalUs = static_cast<double>(timeStampUs - previousTimeStamp);
+			updateAverage(_arrivalRateOps, static_cast<double>(count) / intervalUs, RateWeight, !_haveArrivalRate);
+			updateAverage(_arrivalRateBytes, static_cast<double>(size) / intervalUs, RateWeight, !_haveArrivalRate);
+			_haveArrivalRate = true;
+		}
+
+		uint64_t timeout = timeoutUs();
+		if (onTimeout)
+		{
+			if (count <= 1)
+				timeout /= 2;
+			else if (arrivalSpanUs * 2 < timeout)
+				timeout = (timeout + arrivalSpanUs * 2) / 2;
+			else
+				timeout += std::max(timeout / 4, MinTimeoutStepUs);
+		}
+
+		_timeoutUs.store(std::min(timeout, maxUsefulTimeoutUs()), std::memory_order_relaxed);
+	}
+
+	// A group commit took 'latencyUs' to write and sync
+	void flushed(const uint64_t latencyUs) noexcept
+	{
+		const double latency = static_cast<double>(latencyUs);
+		if (_haveFlushLatency)
+		{
+			const double mean = _flushLatencyUs.load(std::memory_order_relaxed);
+			updateAverage(_flushLatencyDeviationUs, latency > mean ? latency - mean : mean - latency, LatencyWeight, false);
+		}
+
+		updateAverage(_flushLatencyUs, latency, LatencyWeight, !_haveFlushLatency);
+		_haveFlushLatency = true;
+	}
+
+	[[nodiscard]] Stats stats() const noexcept
+	{
+		return Stats{
+			.timeoutUs = timeoutUs(),
+			.arrivalRateOpsPerSecond = _arrivalRateOps.load(std::memory_order_relaxed) * 1'000'000.0,
+			.flushLatencyUs = static_cast<uint64_t>(_flushLatencyUs.load(std::memory_order_relaxed)),
+			.flushLatencyP99Us = flushLatencyP99Us()
+		};
+	}
+
+private:
+	// For the latencies with a long tail, the mean + 4 deviations is close enough to p99
+	[[nodiscard]] uint64_t flushLatencyP99Us() const noexcept
+	{
+		return static_cast<uint64_t>(_flushLatencyUs.load(std::memory_order_relaxed) + 4.0 * _flushLatencyDeviationUs.load(std::memory_order_relaxed));
+	}
+
+	[[nodiscard]] uint64_t maxUsefulTimeoutUs() const noexcept
+	{
+		const uint64_t flushLatency = flushLatencyP99Us();
+		uint64_t bound = std::min(_maxTimeoutUs, _latencyTargetUs > flushLatency ? _latencyTargetUs - flushLatency : 0);
+
+		const double byteRate = _arrivalRateBytes.load(std::memory_order_relaxed);
+		if (byteRate > 0.0)
+			bound = std::min(bound, static_cast<uint64_t>(std::min(_blockCapacity / byteRate, static_cast<double>(bound))));
+
+		return bound;
+	}
+
+	// Exponential moving average. The first sample is taken as is.
+	static void updateAverage(std::atomic<double>& average, const double sample, const double weight, const bool firstSample) noexcept
+	{
+		const double current = average.load(std::memory_order_relaxed);
+		average.store(firstSample ? sample : current + (sample - current) * weight, std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr uint64_t MinTimeoutStepUs = 20;
+	static constexpr double RateWeight = 1.0 / 8;
+	static constexpr double LatencyWeight = 1.0 / 8;
+
+	const uint64_t _maxTimeoutUs;
+	const uint64_t _latencyTargetUs;
+	const double _blockCapacity;
+
+	std::atomic<uint64_t> _timeoutUs;
+
+	// Per microsecond. Only written by blockSealed().
+	std::atomic<double> _arrivalRateOps{ 0.0 };
+	std::atomic<double> _arrivalRateBytes{ 0.0 };
+	uint64_t _lastSealTimeStampUs = 0;
+	bool _haveArrivalRate = false;
+
+	// Only written by flushed()
+	std::atomic<double> _flushLatencyUs{ 0.0 };
+	std::atomic<double> _flushLatencyDeviationUs{ 0.0 };
+	bool _haveFlushLatency = false;
+};
+
+}
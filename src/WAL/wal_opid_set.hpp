@@ -0,0 +1,53 @@
+#pragma once
+
+#include "wal_data_types.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace WAL {
+
+// A set of OpIDs with O(1) insertion and lookup: one bit per ID, starting from the base ID.
+// The IDs in the log are dense and ascending, so the bitmap only takes as many bits as there are operations since the base.
+// IDs below the base are ignored, they can't belong to the operations found in the log.
+class OpIdSet
+{
+public:
+	constexpr void setBase(const OpID base) noexcept
+	{
+		_base = base;
+		_bits.clear();
+	}
+
+	[[nodiscard]] constexpr bool hasBase() const noexcept
+	{
+		return _base != 0;
+	}
+
+	void insert(const OpID id)
+	{
+		if (id < _base || _base == 0)
+			return;
+
+		const size_t index = id - _base;
+		if (index >= _bits.size())
+			_bits.resize(index + 1, false);
+		_bits[index] = true;
+	}
+
+	[[nodiscard]] bool contains(const OpID id) const noexcept
+	{
+		if (id < _base || _base == 0)
+			return false;
+
+		const size_t index = id - _base;
+		return index < _bits.size() && _bits[index];
+	}
+
+private:
+	std::vector<bool> _bits;
+	OpID _base = 0; // OpID 0 is never assigned
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace WAL {
+
+// How a thread that has registered an operation waits for the block holding it to be flushed.
+enum class FlushWaitMode : uint8_t {
+	Park, // Sleep on the flush counter of the block (futex-based std::atomic::wait), woken when that block is written
+	Spin  // Busy-wait with std::this_thread::yield(). Only makes sense when there are fewer writers than cores.
+};
+
+// Which thread writes the blocks to the log file.
+enum class FlushMode : uint8_t {
+	Inline,       // The writer that doesn't fit into the block or the first writer of the block (on timeout) flushes it
+	FlusherThread // A dedicated I/O thread owns the log file; worker threads only fill the block and wait
+};
+
+// How the written blocks are made durable. Trades commit latency and throughput for the amount of data a crash can lose.
+enum class Durability : uint8_t {
+	SyncPerCommit, // fdatasync() after every group commit: registerOperation() returns once the operation is on stable storage
+	WriteThrough,  // The log is opened with O_DSYNC, so the commit write itself is synchronous. Adapters that can't do it sync per commit instead.
+	Periodic,      // A background thread syncs the log every 'syncIntervalMs'. A crash can lose the operations of the last interval.
+	None           // Never sync, leave it to the OS. Only for benchmarking.
+};
+
+// How updateOpStatus() logs the completion of an operation
+enum class CompletionMarkers : uint8_t {
+	Durable, // Waits for the block holding the marker to be flushed, like registerOperation() does
+	Lazy     // Returns right away, the marker goes out with its block. A marker lost in a crash only gets the operation replayed once more.
+};
+
+// How verifyLog() finds the operations that need to be replayed
+enum class VerificationMode : uint8_t {
+	TwoPass,   // The first pass collects the completion markers, the second one reports the operations that weren't completed
+	SinglePass // The log is read once, remembering where the pending entries are. Only those are read again, at the end.
+};
+
+// How long the first writer of a block waits for more entries before flushing it
+enum class FlushTimeoutMode : uint8_t {
+	Fixed,   // Always 'flushTimeoutMs'
+	Adaptive // Follows the load, from 0 for a lone writer up to 'flushTimeoutMs', keeping the wait plus the p99 flush latency within 'commitLatencyTargetUs'
+};
+
+// How the log blocks are checksummed. Every block records its algorithm, so the log is readable whatever the current setting.
+enum class BlockChecksum : uint8_t {
+	Crc32c = 1,   // CRC-32C, computed by the CPU (SSE 4.2, ARMv8) when it can, table-driven otherwise. Detects any error burst of up to 32 bits.
+	WheatHash = 2 // wheathash32, the original checksum of the log
+};
+
+struct Options {
+	FlushWaitMode flushWaitMode = FlushWaitMode::Park;
+	FlushMode flushMode = FlushMode::Inline;
+	Durability durability = Durability::SyncPerCommit;
+	VerificationMode verificationMode = VerificationMode::TwoPass;
+	CompletionMarkers completionMarkers = CompletionMarkers::Durable;
+	BlockChecksum blockChecksum = BlockChecksum::Crc32c;
+	FlushTimeoutMode flushTimeoutMode = FlushTimeoutMode::Fixed;
+
+	// The block is flushed once its oldest entry has been waiting for this long...
+	uint32_t flushTimeoutMs = 50;
+	// FlushTimeoutMode::Adaptive only
+	uint32_t commitLatencyTargetUs = 10'000;
+	// ...or as soon as it holds this many bytes or operations. 0 = only flush a block when it's full.
+	uint32_t flushThresholdBytes = 0;
+	uint32_t flushThresholdOps = 0;
+
+	// Durability::Periodic only
+	uint32_t syncIntervalMs = 100;
+
+	// Segmented log: the log file is a ring of preallocated segments of 'segmentBlocks' blocks each, the first one being the segment header.
+	// A segment whose operations have all completed is overwritten by a new one, so the file only grows if the oldest segment is still needed.
+	// 0 = a single log file that keeps growing until cleared.
+	uint32_t segmentBlocks = 0;
+	// How many segments are preallocated when the log is opened
+	uint32_t segmentCount = 4;
+
+	// Threads used by verifyLog() to verify the block checksums and decode the pending operations, including the calling thread.
+	// 1 = verify on the calling thread only, 0 = one thread per hardware core. The receiver is always called on the calling thread, in the OpID order.
+	uint32_t verificationThreads = 1;
+
+	// Times every registerOperation(), registerOperations() and waiting updateOpStatus() call for the latency histograms of DbWAL::stats().
+	// Costs three clock reads per call. The other statistics are always collected.
+	bool latencyStats = false;
+};
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "wal_data_types.hpp"
+
+#include <bit>
+#include <deque>
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace WAL {
+
+// The operations that have been registered but haven't completed yet.
+// A bitmap over a sliding window of OpIDs: the IDs are handed out in ascending order and most operations complete soon after, so the window stays short.
+// Adding and completing an operation and finding the oldest pending one are all O(1), amortized over the window sliding forward.
+class PendingOperations
+{
+public:
+	void insert(const OpID id)
+	{
+		if (_count == 0)
+		{
+			_words.clear();
+			_base = wordBase(id);
+		}
+
+		// The IDs are reserved in order, but concurrent writers may add them slightly out of order, after the window has moved past them
+		while (id < _base)
+		{
+			_words.push_front(0);
+			_base -= BitsPerWord;
+		}
+
+		const size_t wordIndex = static_cast<size_t>((id - _base) / BitsPerWord);
+		if (wordIndex >= _words.size())
+			_words.resize(wordIndex + 1, 0);
+
+		const uint64_t bit = uint64_t{ 1 } << ((id - _base) % BitsPerWord);
+		if ((_words[wordIndex] & bit) == 0)
+		{
+			_words[wordIndex] |= bit;
+			++_count;
+		}
+	}
+
+	// Returns false if the operation isn't pending
+	[[nodiscard]] bool remove(const OpID id) noexcept
+	{
+		if (!contains(id))
+			return false;
+
+		const size_t wordIndex = static_cast<size_t>((id - _base) / BitsPerWord);
+		_words[wordIndex] &= ~(uint64_t{ 1 } << ((id - _base) % BitsPerWord));
+		--_count;
+
+		// Sliding the window past the completed operations
+		while (!_words.empty() && _words.front() == 0)
+		{
+			_words.pop_front();
+			_base += BitsPerWord;
+		}
+
+		return true;
+	}
+
+	[[nodiscard]] bool contains(const OpID id) const noexcept
+	{
+		if (id < _base)
+			return false;
+
+		const uint64_t wordIndex = (id - _base) / BitsPerWord;
+		return wordIndex < _words.size() && (_words[static_cast<size_t>(wordIndex)] & (uint64_t{ 1 } << ((id - _base) % BitsPerWord))) != 0;
+	}
+
+	// The first word of the window is never empty
+	[[nodiscard]] std::optional<OpID> oldest() const noexcept
+	{
+		if (_count == 0)
+			return {};
+
+		return static_cast<OpID>(_base + static_cast<uint64_t>(std::countr_zero(_words.front())));
+	}
+
+	[[nodiscard]] size_t size() const noexcept
+	{
+		return _count;
+	}
+
+	[[nodiscard]] bool empty() const noexcept
+	{
+		return _count == 0;
+	}
+
+private:
+	static constexpr uint64_t BitsPerWord = 64;
+
+	[[nodiscard]] static constexpr uint64_t wordBase(const OpID id) noexcept
+	{
+		return id - id % BitsPerWord;
+	}
+
+private:
+	std::deque<uint64_t> _words;
+	uint64_t _base = 0; // The ID of the lowest bit of the first word, a multiple of 64
+	size_t _count = 0;
+};
+
+}
@@ -6,15 +6,42 @@
 #include "../dbschema.hpp"
 #include "../storage/storage_io_interface.hpp"
 #include "../serialization/dbrecord-serializer.hpp"
+#include "../serialization/record-view.hpp"
 #include "../utils/dbutilities.hpp"
 
 #include "tuple/tuple_helpers.hpp"
 #include "utility/template_magic.hpp"
 
 #include <array>
+#include <span>
+#include <type_traits>
+#include <utility>
 
 namespace WAL {
 
+// Wrapping the receiver of the deserialized operations in RecordViews has them passed on with RecordView<Record> in place of the record type
+// (Operation::Insert<RecordView<Record>> and so on), so the records aren't materialized: the views point into the buffer being deserialized
+// and are only valid during the call. Requires an in-memory adapter and a record type in the default encoding.
+template <typename Receiver>
+struct RecordViews {
+	Receiver receiver;
+
+	template <class Op>
+	void operator()(Op&& op)
+	{
+		receiver(std::forward<Op>(op));
+	}
+};
+
+template <typename Receiver>
+RecordViews(Receiver) -> RecordViews<Receiver>;
+
+template <typename Receiver>
+inline constexpr bool receivesRecordViews_v = false;
+
+template <typename Receiver>
+inline constexpr bool receivesRecordViews_v<RecordViews<Receiver>> = true;
+
 template <RecordType Record>
 class Serializer
 {
@@ -39,6 +66,10 @@ public:
 	template <class MarkerStruct, class StorageAdapter, sfinae<MarkerStruct::markerID != 0> = true>
 	[[nodiscard]] static bool serialize(const MarkerStruct& op, StorageIO<StorageAdapter>& io) noexcept;
 
+	// The exact number of bytes serialize() writes for the operation or marker, so that it can be serialized in place
+	template <class Operation>
+	[[nodiscard]] static size_t serializedSize(const Operation& op) noexcept;
+
 	template <class StorageAdapter, typename Receiver>
 	[[nodiscard]] static bool deserialize(StorageIO<StorageAdapter>& io, Receiver&& receiver) noexcept;
 	
@@ -48,29 +79,91 @@ public:
 private:
 	using RecordSerializer = DbRecordSerializer<Record>;
 
-	template <typename Functor, size_t currentIndex = 0, typename TypesPack = type_pack<Record>, size_t N>
-	static constexpr void constructFindOperationType([[maybe_unused]] Functor&& receiver, const std::array<uint8_t, N>& fieldIds, const size_t nFieldIds) noexcept
+	// The record type of the operations passed to the receiver
+	template <typename Receiver>
+	using ReceivedRecord = std::conditional_t<receivesRecordViews_v<std::remove_cv_t<Receiver>>, RecordView<Record>, Record>;
+
+	template <typename Receiver, class StorageAdapter>
+	[[nodiscard]] static bool readRecord(StorageIO<StorageAdapter>& io, ReceivedRecord<Receiver>& record) noexcept
 	{
-		// Get the compile-time ID of the current type
-		constexpr_for_fold<0, Schema::Fields::type_count>([&]<auto I>() {
-			using Type = typename Schema::template FieldByIndex_t<I>;
-			if (Type::id == fieldIds[currentIndex])
-			{
-				using UpdatedTypesPack = typename TypesPack::template Append<Type>;
-				if ((currentIndex + 1) == nFieldIds)
-				{
-					// All done - compose the final type and exit.
-					using FindOpType = typename UpdatedTypesPack::template Construct<Operation::Find>;
-					receiver.template operator()<FindOpType>();
-				}
-				else
-				{
-					if constexpr (currentIndex + 1 < Operation::Find<Record>::maxFieldCount) // Keep recursing
-						constructFindOperationType<Functor, currentIndex + 1, UpdatedTypesPack>(std::forward<Functor>(receiver), fieldIds, nFieldIds);
-				}
-			}
+		if constexpr (receivesRecordViews_v<std::remove_cv_t<Receiver>>)
+			return record.read(io);
+		else
+			return RecordSerializer::deserialize(record, io);
+	}
+
+	// The key, array and Find field values, in the record's encoding
+	template <typename T>
+	[[nodiscard]] static size_t serializedValueSize(const T& value) noexcept
+	{
+		if constexpr (compactEncoding_v<Record>)
+			return compact::valueSize(value);
+		else if constexpr (is_trivially_serializable_v<T>)
+			return sizeof(T);
+		else
+			return ::valueSize(value);
+	}
+
+	template <typename T, class StorageAdapter>
+	[[nodiscard]] static bool writeValue(StorageIO<StorageAdapter>& io, const T& value) noexcept
+	{
+		if constexpr (compactEncoding_v<Record>)
+			return compact::write(io, value);
+		else
+			return io.write(value);
+	}
+
+	template <typename T, class StorageAdapter>
+	[[nodiscard]] static bool readValue(StorageIO<StorageAdapter>& io, T& value) noexcept
+	{
+		if constexpr (compactEncoding_v<Record>)
+			return compact::read(io, value);
+		else
+			return io.read(value);
+	}
+
+	// The field IDs read from the log are resolved with dispatch tables: entry #id points to the handler instantiated for the schema field with that ID,
+	// or is null if there's no such field or the handler doesn't apply to it. One lookup per ID instead of a scan over all the fields.
+	template <typename Handler, typename HandlerFactory>
+	[[nodiscard]] static constexpr std::array<Handler, 256> fieldDispatchTable(HandlerFactory factory) noexcept
+	{
+		std::array<Handler, 256> table{};
+		constexpr_for_fold<0, Schema::fieldsCount_v>([&]<auto I>() {
+			using FieldType = typename Schema::template FieldByIndex_t<I>;
+			// The IDs are serialized as uint8_t
+			if constexpr (FieldType::id >= 0 && FieldType::id <= 255)
+				table[FieldType::id] = factory.template operator()<FieldType>();
 		});
+		return table;
 	}
+
+	template <class StorageAdapter, typename Receiver, class... ResolvedFields>
+	using FindHandler = bool (*)(StorageIO<StorageAdapter>&, Receiver&, std::span<const uint8_t>, ResolvedFields&&...) noexcept;
+	template <class StorageAdapter, typename Receiver>
+	using UpdateFullHandler = bool (*)(StorageIO<StorageAdapter>&, Receiver&, ReceivedRecord<Receiver>&&, bool) noexcept;
+	template <class StorageAdapter, typename Receiver>
+	using AppendToArrayHandler = bool (*)(StorageIO<StorageAdapter>&, Receiver&, uint8_t, bool) noexcept;
+	template <class KeyField, class StorageAdapter, typename Receiver>
+	using AppendToArrayFieldHandler = bool (*)(StorageIO<StorageAdapter>&, Receiver&, typename KeyField::ValueType&&, bool) noexcept;
+	template <class StorageAdapter, typename Receiver>
+	using DeleteHandler = bool (*)(StorageIO<StorageAdapter>&, Receiver&) noexcept;
+
+	// Reads the value of the Find operation field 'NewField', whose ID has been resolved after 'ResolvedFields'.
+	// Then resolves the next field ID, or passes the operation on once all of them are done. The values follow the IDs in the same order.
+	template <class StorageAdapter, typename Receiver, class NewField, class... ResolvedFields>
+	[[nodiscard]] static bool deserializeFind(StorageIO<StorageAdapter>& io, Receiver& receiver, std::span<const uint8_t> fieldIds, ResolvedFields&&... resolvedFields) noexcept;
+
+	template <class KeyField, class StorageAdapter, typename Receiver>
+	[[nodiscard]] static bool deserializeUpdateFull(StorageIO<StorageAdapter>& io, Receiver& receiver, ReceivedRecord<Receiver>&& record, bool insertIfNotPresent) noexcept;
+
+	// Reads the key value and resolves the array field ID
+	template <class KeyField, class StorageAdapter, typename Receiver>
+	[[nodiscard]] static bool deserializeAppendToArrayKey(StorageIO<StorageAdapter>& io, Receiver& receiver, uint8_t arrayFieldId, bool insertIfNotPresent) noexcept;
+	template <class KeyField, class ArrayField, class StorageAdapter, typename Receiver>
+	[[nodiscard]] static bool deserializeAppendToArray(StorageIO<StorageAdapter>& io, Receiver& receiver, typename KeyField::ValueType&& keyValue, bool insertIfNotPresent) noexcept;
+
+	template <class KeyField, class StorageAdapter, typename Receiver>
+	[[nodiscard]] static bool deserializeDelete(StorageIO<StorageAdapter>& io, Receiver& receiver) noexcept;
 };
 
 template <RecordType Record>
@@ -130,7 +223,7 @@ bool Serializer<Record>::serialize(const Operation& op, StorageIO<StorageAdapter
 	// And now the values
 	constexpr_for_fold<0, nFields>([&]<auto I>() {
 		const auto& field = std::get<I>(op._fields);
-		if (success && !io.writeField(field))
+		if (success && !writeValue(io, field.value))
 			success = false;
 	});
 
@@ -156,7 +249,7 @@ bool Serializer<Record>::serialize(const Operation& op, StorageIO<StorageAdapter
 	if (!RecordSerializer::serialize(op.record, io))
 		return false;
 
-	return io.write(op.keyValue);
+	return writeValue(io, op.keyValue);
 }
 
 template <RecordType Record>
@@ -181,13 +274,13 @@ bool Serializer<Record>::serialize(const Operation& op, StorageIO<StorageAdapter
 	if (!io.write(op.insertIfNotPresent()))
 		return false;
 
-	if (!io.write(op.keyValue))
+	if (!writeValue(io, op.keyValue))
 		return false;
 
 	if constexpr (op.insertIfNotPresent())
 		return RecordSerializer::serialize(op.record, io);
 	else
-		return io.write(op.array);
+		return writeValue(io, op.array);
 }
 
 template <RecordType Record>
@@ -204,13 +297,55 @@ bool Serializer<Record>::serialize(const Operation& op, StorageIO<StorageAdapter
 	if (!io.write(static_cast<uint8_t>(keyFieldId)))
 		return false;
 
-	return io.write(op.keyValue);
+	return writeValue(io, op.keyValue);
+}
+
+template <RecordType Record>
+template <class Operation>
+size_t Serializer<Record>::serializedSize(const Operation& op) noexcept
+{
+	if constexpr (requires { Operation::markerID; })
+		return sizeof(op.markerID) + sizeof(op.status);
+	else
+	{
+		size_t size = sizeof(Operation::op);
+		if constexpr (Operation::op == OpCode::Insert)
+			size += RecordSerializer::serializedSize(op._record);
+		else if constexpr (Operation::op == OpCode::Find)
+		{
+			// The field count, the IDs and the values
+			constexpr auto nFields = std::tuple_size_v<decltype(op._fields)>;
+			size += sizeof(uint8_t) + nFields * sizeof(uint8_t);
+			constexpr_for_fold<0, nFields>([&]<auto I>() {
+				size += serializedValueSize(std::get<I>(op._fields).value);
+			});
+		}
+		else if constexpr (Operation::op == OpCode::UpdateFull)
+			size += sizeof(uint8_t) + sizeof(Operation::insertIfNotPresent()) + RecordSerializer::serializedSize(op.record) + serializedValueSize(op.keyValue);
+		else if constexpr (Operation::op == OpCode::AppendToArray)
+		{
+			size += 2 * sizeof(uint8_t) + sizeof(Operation::insertIfNotPresent()) + serializedValueSize(op.keyValue);
+			if constexpr (Operation::insertIfNotPresent())
+				size += RecordSerializer::serializedSize(op.record);
+			else
+				size += serializedValueSize(op.array);
+		}
+		else
+		{
+			static_assert(Operation::op == OpCode::Delete, "Unknown operation type");
+			size += sizeof(uint8_t) + serializedValueSize(op.keyValue);
+		}
+
+		return size;
+	}
 }
 
 template <RecordType Record>
 template <class StorageAdapter, typename Receiver>
 bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& receiver) noexcept
 {
+	using ReceiverType = std::remove_reference_t<Receiver>;
+
 	static_assert(sizeof(OpCode) == sizeof(OperationCompletedMarker::markerID));
 	std::underlying_type_t<OpCode> entryType;
 	assert_and_return_r(io.read(entryType), false);
@@ -219,9 +354,9 @@ bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& r
 	{
 		case (decltype(entryType)) OpCode::Insert:
 		{
-			using Op = Operation::Insert<Record>;
-			Record r;
-			assert_and_return_r(RecordSerializer::deserialize(r, io), false);
+			using Op = Operation::Insert<ReceivedRecord<ReceiverType>>;
+			ReceivedRecord<ReceiverType> r;
+			assert_and_return_r(readRecord<ReceiverType>(io, r), false);
 
 			receiver(Op{ std::move(r) });
 			return true;
@@ -240,25 +375,12 @@ bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& r
 				assert_and_return_r(io.read(ids[i]), false);
 			}
 
-			bool success = true;
-			constructFindOperationType([&]<class OpType>() {
-				typename OpType::TupleOfFields fieldsTuple;
-				constexpr_for_fold<0, std::tuple_size_v<typename OpType::TupleOfFields>>([&]<auto I>() {
-					auto& field = std::get<I>(fieldsTuple);
-					if (success && !io.readField(field))
-					{
-						assert_unconditional_r("io.readField(field) failed!");
-						success = false;
-						return;
-					}
-				});
-
-				if (success)
-					receiver(OpType{std::move(fieldsTuple)});
-
-			}, ids, nFields);
-
-			return success;
+			static constexpr auto handlers = fieldDispatchTable<FindHandler<StorageAdapter, ReceiverType>>([]<class Field>() {
+				return &deserializeFind<StorageAdapter, ReceiverType, Field>;
+			});
+
+			const auto handler = handlers[ids[0]];
+			return handler != nullptr && handler(io, receiver, std::span{ ids }.first(nFields));
 		}
 		case (decltype(entryType)) OpCode::UpdateFull:
 		{
@@ -268,32 +390,15 @@ bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& r
 			bool insertIfNotPresent;
 			assert_and_return_r(io.read(insertIfNotPresent), false);
 
-			Record r;
-			assert_and_return_r(RecordSerializer::deserialize(r, io), false);
-
-			bool success = false;
-			constexpr_for_fold<0, Schema::fieldsCount_v>([&]<auto I>() {
-				using KeyField = typename Schema::template FieldByIndex_t<I>;
-				if (KeyField::id == keyFieldId)
-				{
-					typename KeyField::ValueType keyFieldValue;
-					assert_and_return_r(io.read(keyFieldValue), );
-
-					if (insertIfNotPresent)
-					{
-						using Op = Operation::UpdateFull<Record, KeyField, true>;
-						receiver(Op{ std::move(r), std::move(keyFieldValue) });
-					}
-					else
-					{
-						using Op = Operation::UpdateFull<Record, KeyField, false>;
-						receiver(Op{ std::move(r), std::move(keyFieldValue) });
-					}
-					success = true;
-				}
+			ReceivedRecord<ReceiverType> r;
+			assert_and_return_r(readRecord<ReceiverType>(io, r), false);
+
+			static constexpr auto handlers = fieldDispatchTable<UpdateFullHandler<StorageAdapter, ReceiverType>>([]<class KeyField>() {
+				return &deserializeUpdateFull<KeyField, StorageAdapter, ReceiverType>;
 			});
 
-			return success;
+			const auto handler = handlers[keyFieldId];
+			return handler != nullptr && handler(io, receiver, std::move(r), insertIfNotPresent);
 		}
 		case (decltype(entryType)) OpCode::AppendToArray:
 		{
@@ -306,68 +411,24 @@ bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& r
 			bool insertIfNotPresent;
 			assert_and_return_r(io.read(insertIfNotPresent), false);
 
-			bool success = false;
-			// Searching the compile-time value for keyFieldId
-			constexpr_for_fold<0, Schema::fieldsCount_v>([&]<auto KeyFieldIndex>() {
-				using KeyField = typename Schema::template FieldByIndex_t<KeyFieldIndex>;
-				if (KeyField::id == keyFieldId)
-				{
-					typename KeyField::ValueType keyFieldValue;
-					assert_and_return_r(io.read(keyFieldValue), );
-
-					// Searching the compile-time value for arrayFieldId
-					constexpr_for_fold<0, Schema::fieldsCount_v>([&]<auto ArrayFieldIndex>() {
-						using ArrayField = typename Schema::template FieldByIndex_t<ArrayFieldIndex>;
-						if constexpr (ArrayField::isArray())
-						{
-							if (ArrayField::id == arrayFieldId)
-							{
-								if (insertIfNotPresent)
-								{
-									Record r;
-									assert_and_return_r(RecordSerializer::deserialize(r, io), );
-
-									using Op = Operation::AppendToArray<Record, KeyField, ArrayField, true>;
-									receiver(Op{ std::move(keyFieldValue), std::move(r) });
-								}
-								else
-								{
-									typename ArrayField::ValueType array;
-									assert_and_return_r(io.read(array), );
-
-									using Op = Operation::AppendToArray<Record, KeyField, ArrayField, false>;
-									receiver(Op{ std::move(keyFieldValue), std::move(array) });
-								}
-
-								success = true;
-							}
-						}
-					});
-				}
+			static constexpr auto handlers = fieldDispatchTable<AppendToArrayHandler<StorageAdapter, ReceiverType>>([]<class KeyField>() {
+				return &deserializeAppendToArrayKey<KeyField, StorageAdapter, ReceiverType>;
 			});
 
-			return success;
+			const auto handler = handlers[keyFieldId];
+			return handler != nullptr && handler(io, receiver, arrayFieldId, insertIfNotPresent);
 		}
 		case (decltype(entryType)) OpCode::Delete:
 		{
 			uint8_t keyFieldId;
 			assert_and_return_r(io.read(keyFieldId), false);
 
-			bool success = false;
-			constexpr_for_fold<0, Schema::fieldsCount_v>([&]<auto I>() {
-				using KeyField = typename Schema::template FieldByIndex_t<I>;
-				if (KeyField::id == keyFieldId)
-				{
-					typename KeyField::ValueType keyFieldValue;
-					assert_and_return_r(io.read(keyFieldValue), );
-
-					using Op = Operation::Delete<Record, KeyField>;
-					receiver(Op{ std::move(keyFieldValue) });
-					success = true;
-				}
+			static constexpr auto handlers = fieldDispatchTable<DeleteHandler<StorageAdapter, ReceiverType>>([]<class KeyField>() {
+				return &deserializeDelete<KeyField, StorageAdapter, ReceiverType>;
 			});
 
-			return success;
+			const auto handler = handlers[keyFieldId];
+			return handler != nullptr && handler(io, receiver);
 		}
 		// Markers are currently handled by the WAL itself
 		/*case OperationCompletedMarker::markerID:
@@ -384,6 +445,114 @@ bool Serializer<Record>::deserialize(StorageIO<StorageAdapter>& io, Receiver&& r
 	return false;
 }
 
+template <RecordType Record>
+template <class StorageAdapter, typename Receiver, class NewField, class... ResolvedFields>
+bool Serializer<Record>::deserializeFind(StorageIO<StorageAdapter>& io, Receiver& receiver, const std::span<const uint8_t> fieldIds, ResolvedFields&&... resolvedFields) noexcept
+{
+	NewField field;
+	if (!readValue(io, field.value))
+	{
+		assert_unconditional_r("readValue(field) failed!");
+		return false;
+	}
+
+	constexpr size_t nResolved = sizeof...(ResolvedFields) + 1;
+	if (nResolved == fieldIds.size())
+	{
+		// All done - compose the final type and pass the operation on
+		using FindOpType = Operation::Find<ReceivedRecord<Receiver>, ResolvedFields..., NewField>;
+		receiver(FindOpType{ std::move(resolvedFields)..., std::move(field) });
+		return true;
+	}
+
+	if constexpr (nResolved < Operation::Find<Record>::maxFieldCount)
+	{
+		static constexpr auto handlers = fieldDispatchTable<FindHandler<StorageAdapter, Receiver, ResolvedFields..., NewField>>([]<class Field>() {
+			return &deserializeFind<StorageAdapter, Receiver, Field, ResolvedFields..., NewField>;
+		});
+
+		const auto handler = handlers[fieldIds[nResolved]];
+		return handler != nullptr && handler(io, receiver, fieldIds, std::move(resolvedFields)..., std::move(field));
+	}
+	else
+		return false;
+}
+
+template <RecordType Record>
+template <class KeyField, class StorageAdapter, typename Receiver>
+bool Serializer<Record>::deserializeUpdateFull(StorageIO<StorageAdapter>& io, Receiver& receiver, ReceivedRecord<Receiver>&& record, const bool insertIfNotPresent) noexcept
+{
+	typename KeyField::ValueType keyFieldValue;
+	assert_and_return_r(readValue(io, keyFieldValue), false);
+
+	if (insertIfNotPresent)
+	{
+		using Op = Operation::UpdateFull<ReceivedRecord<Receiver>, KeyField, true>;
+		receiver(Op{ std::move(record), std::move(keyFieldValue) });
+	}
+	else
+	{
+		using Op = Operation::UpdateFull<ReceivedRecord<Receiver>, KeyField, false>;
+		receiver(Op{ std::move(record), std::move(keyFieldValue) });
+	}
+
+	return true;
+}
+
+template <RecordType Record>
+template <class KeyField, class StorageAdapter, typename Receiver>
+bool Serializer<Record>::deserializeAppendToArrayKey(StorageIO<StorageAdapter>& io, Receiver& receiver, const uint8_t arrayFieldId, const bool insertIfNotPresent) noexcept
+{
+	static constexpr auto handlers = fieldDispatchTable<AppendToArrayFieldHandler<KeyField, StorageAdapter, Receiver>>([]<class ArrayField>() {
+		if constexpr (ArrayField::isArray())
+			return &deserializeAppendToArray<KeyField, ArrayField, StorageAdapter, Receiver>;
+		else
+			return AppendToArrayFieldHandler<KeyField, StorageAdapter, Receiver>{ nullptr };
+	});
+
+	typename KeyField::ValueType keyFieldValue;
+	assert_and_return_r(readValue(io, keyFieldValue), false);
+
+	const auto handler = handlers[arrayFieldId];
+	return handler != nullptr && handler(io, receiver, std::move(keyFieldValue), insertIfNotPresent);
+}
+
+template <RecordType Record>
+template <class KeyField, class ArrayField, class StorageAdapter, typename Receiver>
+bool Serializer<Record>::deserializeAppendToArray(StorageIO<StorageAdapter>& io, Receiver& receiver, typename KeyField::ValueType&& keyValue, const bool insertIfNotPresent) noexcept
+{
+	if (insertIfNotPresent)
+	{
+		ReceivedRecord<Receiver> r;
+		assert_and_return_r(readRecord<Receiver>(io, r), false);
+
+		using Op = Operation::AppendToArray<ReceivedRecord<Receiver>, KeyField, ArrayField, true>;
+		receiver(Op{ std::move(keyValue), std::move(r) });
+	}
+	else
+	{
+		typename ArrayField::ValueType array;
+		assert_and_return_r(readValue(io, array), false);
+
+		using Op = Operation::AppendToArray<ReceivedRecord<Receiver>, KeyField, ArrayField, false>;
+		receiver(Op{ std::move(keyValue), std::move(array) });
+	}
+
+	return true;
+}
+
+template <RecordType Record>
+template <class KeyField, class StorageAdapter, typename Receiver>
+bool Serializer<Record>::deserializeDelete(StorageIO<StorageAdapter>& io, Receiver& receiver) noexcept
+{
+	typename KeyField::ValueType keyFieldValue;
+	assert_and_return_r(readValue(io, keyFieldValue), false);
+
+	using Op = Operation::Delete<ReceivedRecord<Receiver>, KeyField>;
+	receiver(Op{ std::move(keyFieldValue) });
+	return true;
+}
+
 template<RecordType Record>
 template<class StorageAdapter>
 inline bool Serializer<Record>::isOperationCompletionMarker(StorageIO<StorageAdapter>& io) noexcept
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "wal_flush_timeout.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace WAL {
+
+// Bucket #0 counts the zeros, bucket #i the values in [2^(i - 1), 2^i)
+struct Histogram {
+	static constexpr size_t BucketCount = 32;
+
+	std::array<uint64_t, BucketCount> buckets{};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	[[nodiscard]] static constexpr size_t bucketIndex(const uint64_t value) noexcept
+	{
+		return std::min(static_cast<size_t>(std::bit_width(value)), BucketCount - 1);
+	}
+
+	[[nodiscard]] double mean() const noexcept
+	{
+		return count != 0 ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+	}
+
+	// The upper bound of the bucket holding the percentile 'p' (0 to 100), never more than the maximum
+	[[nodiscard]] uint64_t percentile(const double p) const noexcept
+	{
+		const auto rank = static_cast<uint64_t>(static_cast<double>(count) * p / 100.0);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BucketCount; ++i)
+		{
+			seen += buckets[i];
+			if (seen > rank || (seen == count && seen != 0))
+				return i == 0 ? 0 : std::min((uint64_t{ 1 } << i) - 1, max);
+		}
+
+		return max;
+	}
+};
+
+struct Stats {
+	uint64_t operationCount = 0; // Registered operations
+	uint64_t completionMarkerCount = 0;
+
+	uint64_t blockCount = 0; // Blocks written to the log
+	uint64_t bytesWritten = 0; // The blocks including the padding, without the segment headers
+	uint64_t paddingBytesWritten = 0;
+	uint64_t maxBlockFill = 0; // In bytes
+	std::array<uint64_t, 10> blockFillHistogram{}; // The blocks written by the share of the block size they fill, in 10 % steps
+
+	// Why the blocks were sealed
+	uint64_t fullBlockCount = 0; // Out of space, or the flush threshold has been reached
+	uint64_t timeoutBlockCount = 0;
+	uint64_t closeBlockCount = 0; // Closing the log
+
+	uint64_t groupCommitCount = 0;
+	uint64_t maxBlocksPerGroupCommit = 0;
+
+	// In microseconds. Only collected with Options::latencyStats.
+	Histogram commitLatencyUs; // registerOperation(), registerOperations() and a waiting updateOpStatus() from start to end
+	Histogram flushWaitTimeUs; // The part of the above spent waiting for the block to be written
+
+	// In microseconds
+	Histogram blockLockHoldTimeUs; // Sealing a block and opening the next one under the block lock
+	Histogram groupCommitTimeUs; // Writing and syncing a group of blocks under the log file lock
+
+	AdaptiveFlushTimeout::Stats flushTimeout;
+};
+
+// The counters behind WAL::Stats, sharded by thread. Each thread sticks to one of the cache line aligned shards,
+// so the writers don't contend on the counters unless there are more of them than shards. A snapshot sums the shards up.
+class StatsCounters
+{
+public:
+	struct AtomicHistogram {
+		std::array<std::atomic<uint64_t>, Histogram::BucketCount> buckets{};
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> max{ 0 };
+
+		void record(const uint64_t value) noexcept
+		{
+			buckets[Histogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(value, std::memory_order_relaxed);
+			updateMax(max, value);
+		}
+
+		void addTo(Histogram& histogram) const noexcept
+		{
+			for (size_t i = 0; i < Histogram::BucketCount; ++i)
+			{
+				const uint64_t count = buckets[i].load(std::memory_order_relaxed);
+				histogram.buckets[i] += count;
+				histogram.count += count;
+			}
+			histogram.sum += sum.load(std::memory_order_relaxed);
+			histogram.max = std::max(histogram.max, max.load(std::memory_order_relaxed));
+		}
+	};
+
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> operationCount{ 0 };
+		std::atomic<uint64_t> completionMarkerCount{ 0 };
+
+		std::atomic<uint64_t> blockCount{ 0 };
+		std::atomic<uint64_t> bytesWritten{ 0 };
+		std::atomic<uint64_t> paddingBytesWritten{ 0 };
+		std::atomic<uint64_t> maxBlockFill{ 0 };
+		std::array<std::atomic<uint64_t>, 10> blockFillHistogram{};
+
+		std::atomic<uint64_t> fullBlockCount{ 0 };
+		std::atomic<uint64_t> timeoutBlockCount{ 0 };
+		std::atomic<uint64_t> closeBlockCount{ 0 };
+
+		std::atomic<uint64_t> groupCommitCount{ 0 };
+		std::atomic<uint64_t> maxBlocksPerGroupCommit{ 0 };
+
+		AtomicHistogram commitLatencyUs;
+		AtomicHistogram flushWaitTimeUs;
+		AtomicHistogram blockLockHoldTimeUs;
+		AtomicHistogram groupCommitTimeUs;
+
+		void blockWritten(const size_t fill, const size_t writeSize, const size_t blockSize) noexcept
+		{
+			add(blockCount, 1);
+			add(bytesWritten, writeSize);
+			add(paddingBytesWritten, writeSize - fill);
+			updateMax(maxBlockFill, fill);
+			add(blockFillHistogram[std::min(fill * blockFillHistogram.size() / blockSize, blockFillHistogram.size() - 1)], 1);
+		}
+	};
+
+	// The shard of the calling thread
+	[[nodiscard]] Shard& local() noexcept
+	{
+		return _shards[threadIndex() % ShardCount];
+	}
+
+	[[nodiscard]] Stats snapshot() const noexcept
+	{
+		Stats stats;
+		for (const Shard& shard : _shards)
+		{
+			stats.operationCount += load(shard.operationCount);
+			stats.completionMarkerCount += load(shard.completionMarkerCount);
+
+			stats.blockCount += load(shard.blockCount);
+			stats.bytesWritten += load(shard.bytesWritten);
+			stats.paddingBytesWritten += load(shard.paddingBytesWritten);
+			stats.maxBlockFill = std::max(stats.maxBlockFill, load(shard.maxBlockFill));
+			for (size_t i = 0; i < stats.blockFillHistogram.size(); ++i)
+				stats.blockFillHistogram[i] += load(shard.blockFillHistogram[i]);
+
+			stats.fullBlockCount += load(shard.fullBlockCount);
+			stats.timeoutBlockCount += load(shard.timeoutBlockCount);
+			stats.closeBlockCount += load(shard.closeBlockCount);
+
+			stats.groupCommitCount += load(shard.groupCommitCount);
+			stats.maxBlocksPerGroupCommit = std::max(stats.maxBlocksPerGroupCommit, load(shard.maxBlocksPerGroupCommit));
+
+			shard.commitLatencyUs.addTo(stats.commitLatencyUs);
+			shard.flushWaitTimeUs.addTo(stats.flushWaitTimeUs);
+			shard.blockLockHoldTimeUs.addTo(stats.blockLockHoldTimeUs);
+			shard.groupCommitTimeUs.addTo(stats.groupCommitTimeUs);
+		}
+
+		return stats;
+	}
+
+	static void add(std::atomic<uint64_t>& counter, const uint64_t value) noexcept
+	{
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	static void updateMax(std::atomic<uint64_t>& maximum, const uint64_t value) noexcept
+	{
+		uint64_t current = maximum.load(std::memory_order_relaxed);
+		while (current < value && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+
+private:
+	static constexpr size_t ShardCount = 16;
+
+	[[nodiscard]] static uint64_t load(const std::atomic<uint64_t>& counter) noexcept
+	{
+		return counter.load(std::memory_order_relaxed);
+	}
+
+	// Assigned round-robin on the first use, shared by all the WAL instances
+	[[nodiscard]] static size_t threadIndex() noexcept
+	{
+		static std::atomic<size_t> nextIndex{ 0 };
+		thread_local const size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+private:
+	std::array<Shard, ShardCount> _shards;
+};
+
+}
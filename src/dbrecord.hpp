@@ -160,3 +160,9 @@ private:
 private:
 	std::tuple<FieldsSequence...> _fields;
 };
+
+// Records are serialized with fixed-size integers and uint32_t lengths by default. Specialize this for a record type
+// to opt in to the compact encoding (serialization/compact-encoding.hpp) of the record and of its WAL entries:
+//   template <> inline constexpr bool compactEncoding_v<MyRecord> = true;
+template <RecordType Record>
+inline constexpr bool compactEncoding_v = false;
@@ -3,22 +3,70 @@
 /*
 
 Operation basics:
-* Disk I/O is done in blocks of 4 KiB.
-* An internal 4 KiB buffer is kept for incoming operations. The buffer is flushed to disk when full or on timeout.
-  'registerOperation()' call blocks until the flush occurs.
+* Disk I/O is done in blocks of up to BlockSize bytes: 4 KiB by default, up to 64 KiB for devices that write large units atomically
+  (only a segmented log keeps the blocks aligned to BlockSize, so that they map onto the device blocks).
+  A block is written in whole 512-byte sectors, only as many as it fills, so a block sealed on timeout with a handful of entries doesn't cost a whole block of log.
+  In a segmented log every block takes its full slot.
+* A ring of block buffers is kept for incoming operations. Writers fill the current block, which is sealed when full or on timeout.
+  Sealed blocks are written to disk in order while the writers carry on filling the next block, so appending doesn't stall for the duration of the disk write.
+  Only when all the blocks in the ring are sealed and waiting to be written, the writers have to wait for the disk.
+  'registerOperation()' call blocks until the block holding the operation has been written.
+  'registerOperations()' logs a batch of operations under consecutive OpIDs, spanning as many blocks as needed, and waits only once.
+  'registerOperationAsync()' returns right away with a ticket that can be waited on, given a callback or co_await-ed.
+  Its callbacks and coroutines are run on a dedicated completion thread, so that they can't stall the flusher.
+
+* Appending to the current block is lock-free. A single atomic fetch-add on the block's cursor reserves both the entry's index in the block
+  (which gives its OpID) and its byte range. Writers copy their entries in parallel and then publish them by incrementing the block's completion counter.
+  The writer whose entry is the first not to fit seals the block; the block is finalized (header, padding, checksum) by whoever completes it last:
+  the sealer or the last writer to publish. The block mutex is only taken to rotate the ring to the next block.
+
+* 'updateOpStatus()' doesn't log an entry of its own. The completion marker is a compact (OpID delta, status) pair in the footer of the current block,
+  reserved with the same atomic fetch-add as the entries and growing from the end of the block towards them. It doesn't take an OpID.
+  By default 'updateOpStatus()' waits for the marker to be flushed. With WAL::CompletionMarkers::Lazy it returns right away, and the marker goes out
+  with its block: a lost marker only makes verifyLog() report an operation that has completed already, and replaying it has to be harmless anyway.
+  In the inline flush mode a block holding nothing but lazy markers waits for the next writer or for closing the log.
 
 * Among the thread currently waiting for flush, one is designated responsible for timeout handling. Other wait passively.
   This one is the thread that first added data to the empty buffer after the previous flush cleared it.
+  Passive waiters are parked on the flush counter of their block's ring slot (std::atomic::wait), the timeout handler sleeps on a condition variable with a deadline.
+  Writing a block out only wakes up the threads waiting for that very block (and the timeout handlers).
+
+* In the default inline mode the thread that seals a block also writes it (together with any other sealed blocks), after releasing the block mutex.
+  Optionally (WAL::FlushMode::FlusherThread), a dedicated flusher thread owns the log file and does all the writes.
+  There is no timeout handling by the writers in this mode: the flusher seals the block when its oldest entry has been waiting for the flush timeout.
+  In both modes, a block is also sealed as soon as it's full or reaches the configured byte / op count threshold.
+
+* The flush timeout is 'flushTimeoutMs', or, with WAL::FlushTimeoutMode::Adaptive, picked by WAL::AdaptiveFlushTimeout from the recent arrival rate,
+  flush latency and the blocks sealed on timeout.
+
+* 'stats()' returns a snapshot of the counters of the instance: blocks and bytes written, why the blocks were sealed, how full they were,
+  and the histograms of the group commit and block lock hold times (and, with WAL::Options::latencyStats, of the commit latency and flush wait time).
+  The counters are sharded by thread (WAL::StatsCounters), so the writers don't contend on them.
+
+* By default every group commit is followed by sync(), so an operation is durable once 'registerOperation()' returns.
+  WAL::Options::durability can relax that: write-through (O_DSYNC) writes, a background sync every 'syncIntervalMs', or no syncing at all.
+
+* Optionally (WAL::Options::segmentBlocks), the log file is a ring of fixed-size segments, preallocated when the log is opened.
+  Every segment starts with a header holding the checkpoint: the oldest operation that was still pending when the segment was started.
+  When a segment is full, the next one overwrites the oldest segment whose operations have all completed. Only if there's none, the ring grows by a segment.
+  The block checksums are salted with the segment's sequence number, so that the blocks left over from the segment's previous use are recognized as such.
 
 * Only one thread, dubbed the owner thread, is supposed to create, open, verify and close the log. Any number of threads can actually log events.
 
-* Unique operation IDs are generated by incrementing a counter such that the counter reflects the relative order in which threads acquired the buffer mutex.
+* Unique operation IDs are generated from the block's first ID and the entry's index in the block, so they reflect the order of the reservations.
   This way older requests always have lower IDs, so threads can easily track which operations were flushed and which were not.
 
+* The record types that opt in to the compact encoding (compactEncoding_v) have it in the log as well: the entry size is a varint,
+  and instead of the whole OpID the entry holds its difference from the ID implied by the entry's index in the block, which is 0 (one byte) for the operations.
+
 * Verification of the log is done in two passes.
-  The first pass only looks for operation completion markers and stores them.
+  The first pass only looks for operation completion markers (in the block footers) and stores them.
   The second pass reads operation IDs of every record, but skips all the other data for IDs that have been successful.
   This eliminates the need to store operations until their status is known, which would be highly problematic due to unknown template arguments.
+  The completed IDs are kept in a bitmap, so the lookup is O(1) and verification is linear in the log size.
+  Optionally (WAL::VerificationMode::SinglePass), the log is read only once, storing the locations of the operations. Only the pending ones are read again.
+* The log is read in chunks of 'VerificationChunkBlocks'. With WAL::Options::verificationThreads > 1, a pool of workers verifies the checksums of the chunk's blocks
+  and decodes the pending operations in parallel. Everything that depends on the order (collecting the markers, calling the receiver) stays on the calling thread.
 
 * During verification, operations that were pending and not marked as completed are reported to the supplied receiver function object.
   Completed operations are skipped. Whether the operation has completed successfully or otherwise, it has been handled by the storage and no replay is required.
@@ -28,10 +76,18 @@ Operation basics:
 #include "dbschema.hpp"
 #include "storage/storage_io_interface.hpp"
 #include "storage/storage_static_buffer.hpp"
+#include "serialization/compact-encoding.hpp"
 #include "utils/dbutilities.hpp"
 #include "WAL/wal_serializer.hpp"
 #include "WAL/wal_data_types.hpp"
+#include "WAL/wal_flush_timeout.hpp"
+#include "WAL/wal_opid_set.hpp"
+#include "WAL/wal_pending_operations.hpp"
+#include "WAL/wal_stats.hpp"
+#include "WAL/wal_options.hpp"
+#include "utils/crc32c.hpp"
 #include "utils/mutex_checked.hpp"
+#include "utils/worker_pool.hpp"
 
 #include "container/std_container_helpers.hpp"
 #include "hash/wheathash.hpp"
@@ -39,15 +95,23 @@ Operation basics:
 #include "system/timing.h"
 #include "utility/memory_cast.hpp"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string.h>
 #include <thread>
+#include <utility>
 #include <vector>
 
-static std::atomic_uint64_t maxFill = 0;
-static std::atomic_uint64_t totalBlockCount = 0;
-static std::atomic_uint64_t totalSizeWritten = 0;
-
 //#define ENABLE_TRACING
 
 #ifdef ENABLE_TRACING
@@ -65,14 +129,44 @@ static std::atomic_uint64_t totalSizeWritten = 0;
 #define TRACE(...)
 #endif
 
-template <RecordType Record, class StorageAdapter>
+template <RecordType Record, class StorageAdapter, size_t BlockSizeBytes = 4096>
 class DbWAL final
 {
 public:
-	constexpr explicit DbWAL(StorageAdapter& walIoDevice) noexcept :
+	// Returned by registerOperationAsync(). Tells when the operation has been flushed to the log.
+	// Must not outlive the DbWAL it came from.
+	class FlushTicket
+	{
+	public:
+		[[nodiscard]] WAL::OpID opId() const noexcept { return _opId; }
+		[[nodiscard]] bool flushed() const noexcept { return _wal->_lastFlushedOpId >= _opId; }
+
+		// Blocks until the operation has been flushed
+		void wait() const noexcept;
+		// Calls 'callback' once the operation has been flushed: right away if it already has been, otherwise on the completion thread.
+		template <typename Callback>
+		void onFlushed(Callback&& callback) const;
+		// 'co_await ticket' resumes the coroutine once the operation has been flushed and returns its OpID
+		[[nodiscard]] auto operator co_await() const noexcept;
+
+	private:
+		friend class DbWAL;
+		constexpr FlushTicket(DbWAL& wal, const WAL::OpID opId, const uint64_t blockSeq) noexcept :
+			_wal{ &wal }, _opId{ opId }, _blockSeq{ blockSeq }
+		{}
+
+	private:
+		DbWAL* _wal;
+		WAL::OpID _opId;
+		uint64_t _blockSeq;
+	};
+
+	constexpr explicit DbWAL(StorageAdapter& walIoDevice, const WAL::Options& options = {}) noexcept :
+		_options{ options },
+		_adaptiveFlushTimeout{ uint64_t{ options.flushTimeoutMs } * 1000, options.commitLatencyTargetUs, BlockEntriesCapacity },
 		_logFile{ walIoDevice }
 	{
-		checkBlockSize();
+		openBlock(0, 1);
 	}
 
 	~DbWAL() noexcept;
@@ -83,6 +177,8 @@ public:
 	[[nodiscard]] bool openLogFile(const std::string& filePath) noexcept;
 	[[nodiscard]] bool closeLogFile() noexcept;
 
+	// Reports the operations that have to be replayed to the receiver, in the log order.
+	// A receiver wrapped in WAL::RecordViews gets views of the records instead of copies, valid only during the call.
 	template <typename Receiver>
 	[[nodiscard]] bool verifyLog(Receiver&& unfinishedOperationsReceiver) noexcept;
 	[[nodiscard]] bool clearLog() noexcept;
@@ -90,462 +186,2383 @@ public:
 	// Registers the new operation and returns its unique ID. Empty optional = failure to register.
 	template <class OpType>
 	[[nodiscard]] std::optional<WAL::OpID> registerOperation(OpType&& op) noexcept;
+	// Registers all the operations under consecutive IDs and returns the first one. Waits for the flush once, for the whole batch.
+	template <class OpType>
+	[[nodiscard]] std::optional<WAL::OpID> registerOperations(std::span<const OpType> ops) noexcept;
+	// Same as registerOperation(), but doesn't wait for the operation to be flushed. Requires WAL::FlushMode::FlusherThread, which enforces the flush timeout.
+	template <class OpType>
+	[[nodiscard]] std::optional<FlushTicket> registerOperationAsync(OpType&& op) noexcept;
 	[[nodiscard]] bool updateOpStatus(WAL::OpID opId, WAL::OpStatus status) noexcept;
 
-private:
-	constexpr void startNewBlock() noexcept;
-	[[nodiscard]] constexpr bool finalizeAndflushCurrentBlock() noexcept;
-	[[nodiscard]] constexpr bool newBlockRequiredForData(size_t dataSize) noexcept;
-
-	[[nodiscard]] constexpr bool blockIsEmpty() const noexcept;
-
-	// Waits for the record with ID == opId to get flushed.
-	// If that doesn't happen within certain time, performs flush.
-	void waitForFlushAndHandleTimeout(WAL::OpID opId, bool firstWriter, uint64_t operationStartTimeStamp) noexcept;
+	// The statistics of this instance since it was created. The current flush timeout and the inputs of the adaptive one are tracked in either mode.
+	[[nodiscard]] WAL::Stats stats() const noexcept;
 
 private:
 	using EntrySizeType = uint16_t;
 	using Serializer = WAL::Serializer<Record>;
+	// The entry header is compact (see the entry structure below) for the records with the compact encoding
+	static constexpr bool CompactEntries = compactEncoding_v<Record>;
 
 	using BlockChecksumType = uint32_t;
 	static_assert(std::is_same_v<BlockChecksumType, decltype(wheathash32(nullptr, 0))>);
 
 	using BlockItemCountType = uint16_t;
-	static constexpr size_t BlockSize = 4096;
+	// The size of the block as written to the log
+	using BlockSectorCountType = uint16_t;
+	static constexpr size_t BlockSize = BlockSizeBytes;
+	static_assert(std::has_single_bit(BlockSize) && BlockSize >= 4096 && BlockSize <= 65536, "The supported WAL block sizes are 4, 8, 16, 32 and 64 KiB");
+	static constexpr size_t SectorSize = 512;
+	static_assert(BlockSize % SectorSize == 0);
+
+	// Block header: format version, checksum algorithm, size in sectors, number of entries.
+	// The version tells the entry header formats apart, so a log isn't read with the wrong one.
+	static constexpr uint8_t BlockFormatVersion = CompactEntries ? 2 : 1;
+	static constexpr size_t BlockSectorCountOffset = sizeof(BlockFormatVersion) + sizeof(WAL::BlockChecksum);
+	static constexpr size_t BlockItemCountOffset = BlockSectorCountOffset + sizeof(BlockSectorCountType);
+	static constexpr size_t BlockHeaderSize = BlockItemCountOffset + sizeof(BlockItemCountType);
+
+	// A completion marker in the block footer: the completed operation's ID relative to the block's first OpID, and its status
+	using CompletionDeltaType = int16_t;
+	static constexpr size_t CompletionMarkerSize = sizeof(CompletionDeltaType) + sizeof(WAL::OpStatus);
+	// Fills a marker slot that couldn't hold the delta, the marker is logged as a whole entry instead
+	static constexpr uint8_t VoidCompletionStatus = 0;
+	// The fixed part of the footer: the block's first OpID, the number of completion markers and the checksum
+	static constexpr size_t BlockFooterSize = sizeof(WAL::OpID) + sizeof(BlockItemCountType) + sizeof(BlockChecksumType);
+
+	// How many bytes of entries and completion markers fit into a block
+	static constexpr size_t BlockEntriesCapacity = BlockSize - BlockHeaderSize - BlockFooterSize;
+	// 2 is enough for filling one block while the other one is being written.
+	// More slots absorb bursts while the disk is busy, and all the blocks sealed by then are committed with a single write.
+	static constexpr size_t BlockRingSize = 8;
+	// A group commit writes all the sealed blocks at once, there can be no more of them than the ring slots other than the current block
+	static constexpr size_t MaxGroupCommitSize = (BlockRingSize - 1) * BlockSize;
+	// How many blocks verifyLog() reads at once (1 MiB)
+	static constexpr size_t VerificationChunkBlocks = 1024 * 1024 / BlockSize;
+	// "WSEG"
+	static constexpr uint32_t SegmentHeaderMagic = 0x4745'5357;
 
 	// These two definitions are for bug checking only
-	static constexpr size_t MinItemSize = sizeof(EntrySizeType) + sizeof(WAL::OpID) + 1 /* assume at least one byte of payload */;
+	static constexpr size_t MinItemSize = (CompactEntries ? 2 : sizeof(EntrySizeType) + sizeof(WAL::OpID)) + 1 /* assume at least one byte of payload */;
 	static constexpr size_t MaxItemCount = BlockSize / MinItemSize;
 
+	// The 16-bit counters and sizes are enough for 64 KiB blocks
+	static_assert(BlockEntriesCapacity <= std::numeric_limits<EntrySizeType>::max());
+	static_assert(MaxItemCount <= std::numeric_limits<BlockItemCountType>::max());
+	static_assert(BlockSize / SectorSize <= std::numeric_limits<BlockSectorCountType>::max());
+
+	// Block cursor layout: [closed flag : 1 bit][completion markers : 15 bits][entries : 16 bits][bytes of entries : 32 bits]
+	// The counters keep growing past the block capacity: failed reservations are simply retried in the next block.
+	// Only one failed reservation per writer can pile up in a block, so the counters can't overflow into each other.
+	static constexpr uint64_t CursorClosedFlag = uint64_t{ 1 } << 63;
+	static constexpr uint64_t CursorBytesMask = 0xFFFF'FFFF;
+	static constexpr unsigned CursorItemCountShift = 32;
+	static constexpr uint64_t CursorItemCountMask = 0xFFFF;
+	static constexpr unsigned CursorCompletionCountShift = 48;
+	static constexpr uint64_t CursorCompletionCountMask = 0x7FFF;
+	// Leaving plenty of room for the failed reservations
+	static_assert(MaxItemCount * 2 <= CursorItemCountMask && BlockEntriesCapacity / CompletionMarkerSize * 3 / 2 <= CursorCompletionCountMask);
+
+	// Set in the block's publish state once the block has been sealed and its item count is final
+	static constexpr uint64_t BlockSealedFlag = uint64_t{ 1 } << 62;
+
+	struct Block {
+		io::StaticBufferAdapter<BlockSize> buffer;
+		// The reservation cursor, see above. Closed until the block becomes current.
+		std::atomic<uint64_t> cursor = CursorClosedFlag;
+		// The number of entries and completion markers copied into the buffer + BlockSealedFlag
+		std::atomic<uint64_t> publishState = 0;
+		// Header and checksum are in place, the block can be written
+		std::atomic<bool> finalized = false;
+
+		// Set when the block becomes current
+		uint64_t seq = 0;
+		WAL::OpID firstOpId = 0;
+		// Set when the block is sealed
+		size_t itemCount = 0;
+		size_t entriesSize = 0;
+		size_t completionCount = 0;
+		// Set when the block is finalized: how much of the buffer goes to the log
+		size_t writeSize = BlockSize;
+
+		std::atomic<uint64_t> startTimeStamp = 0; // When the first entry or completion marker was added
+		std::atomic<uint64_t> lastArrivalTimeStamp = 0; // When one of the others was last added, only with the adaptive flush timeout
+		// How many times this ring slot has been written to the log. Block #N is durable once the counter of slot N % BlockRingSize exceeds N / BlockRingSize.
+		std::atomic<uint64_t> flushCount = 0;
+
+		[[nodiscard]] constexpr WAL::OpID lastOpId() const noexcept {
+			return firstOpId + static_cast<WAL::OpID>(itemCount) - 1;
+		}
+	};
+
+	// The space taken by the OpID in the entry. In the compact form, the completion marker entries leave room for the difference from any OpID.
+	template <class OpType>
+	static constexpr size_t EntryOpIdSize = !CompactEntries ? sizeof(WAL::OpID) : (requires { OpType::markerID; } ? compact::MaxVarintSize<WAL::OpID> : 1);
+
+	struct EntryHeader {
+		size_t entrySize; // The whole entry
+		size_t payloadSize; // The serialized operation
+		WAL::OpID opId;
+	};
+
+	// The block cursor, decoded
+	struct CursorState {
+		size_t itemCount;
+		size_t entriesSize;
+		size_t completionCount;
+		bool closed;
+	};
+
+	struct AppendedEntry {
+		WAL::OpID opId;
+		uint64_t blockSeq;
+		bool firstInBlock;
+		uint64_t timeStamp; // Only set for the first entry in the block
+	};
+
+	// A run of blocks in the log file: the whole log, or the data blocks of a segment
+	struct LogExtent {
+		uint64_t beginPos;
+		uint64_t endPos;
+		uint32_t checksumSalt = 0;
+		// The data in a preallocated segment ends at the first block that doesn't check out: it was never written, or is left over from the segment's previous use.
+		// Otherwise, only the last group commit of the log is allowed to be malformed.
+		bool endsAtInvalidBlock = false;
+	};
+
+	struct LogContents {
+		std::vector<LogExtent> extents; // In the log order
+		WAL::OpID checkpointOpId = 0; // The operations below this ID have completed, whether or not their markers are still in the log
+	};
+
+	struct SegmentHeader {
+		uint64_t seq = 0; // The segments are numbered from 1, in the order they are started, across the sessions
+		WAL::OpID firstOpId = 0;
+		WAL::OpID checkpointOpId = 0;
+	};
+
+	// A slot of the segment ring in the log file
+	struct Segment {
+		uint64_t seq = 0; // 0 = never used
+		// The slot can be reused once all the operations up to this one have completed
+		WAL::OpID lastOpId = 0;
+	};
+
+	// Something to run once the operation #opId has been flushed
+	struct FlushContinuation {
+		WAL::OpID opId;
+		std::function<void()> continuation;
+	};
+
 private:
-	checked_mutex _mtxBlock;
-	// Has to be atomic for the wait loop to spin on it.
-	std::atomic<WAL::OpID> _lastFlushedOpId = 0;
-	// Doesn't have to be atomic - only accessed under mutex
-	WAL::OpID _lastBlockOpId = 0;
+	[[nodiscard]] constexpr Block& blockBySequenceNumber(uint64_t blockSeq) noexcept;
+
+	// Reads the extent and calls entryHandler(entryIo, entryHeader, entryFilePos) for every entry in the valid blocks.
+	// entryIo is positioned at the serialized operation. completionHandler(opId) is called for every completion marker in the block footer, after the block's entries.
+	// The log is read VerificationChunkBlocks at a time, the checksums of a chunk are verified by the workers,
+	// and chunkHandler() is called once all the entries of the chunk have been handled.
+	// Returns where the valid data of the extent ends. Stops and returns nothing if any handler fails.
+	template <typename EntryHandler, typename CompletionHandler, typename ChunkHandler>
+	[[nodiscard]] std::optional<uint64_t> forEachLogEntry(WorkerPool& workers, const LogExtent& extent, EntryHandler&& entryHandler, CompletionHandler&& completionHandler, ChunkHandler&& chunkHandler) noexcept;
+	// Finds the extents to verify: the whole log, or the segments in the order they were written
+	[[nodiscard]] LogContents logContents() noexcept;
+
+	// The size of the entry for the operation: size, OpID, serialized operation
+	template <class OpType>
+	[[nodiscard]] static size_t entrySize(const OpType& op) noexcept;
+	// Composes the entry for the operation in place: size, space for the OpID, serialized operation. 'entry' is exactly entrySize(op) bytes long.
+	template <class OpType>
+	[[nodiscard]] static bool serializeEntry(const OpType& op, std::span<std::byte> entry) noexcept;
+	// Fills in the OpID of the entry composed by serializeEntry(). 'impliedOpId' is the one that goes with the entry's index in the block.
+	static void writeEntryOpId(std::byte* entry, WAL::OpID opId, WAL::OpID impliedOpId) noexcept;
+	// Reads the size and the OpID of the entry and leaves 'io' at the serialized operation
+	template <class IoAdapter>
+	[[nodiscard]] static std::optional<EntryHeader> readEntryHeader(StorageIO<IoAdapter>& io, WAL::OpID impliedOpId) noexcept;
+	// Serializes the operation, appends it to the current block and registers it as pending, but doesn't wait for the flush
+	template <class OpType>
+	[[nodiscard]] std::optional<AppendedEntry> appendOperation(OpType&& op) noexcept;
+	// Adds the completion marker to the footer of the current block, or logs it as a whole entry if the operation is too far behind the block for the compact form
+	[[nodiscard]] std::optional<AppendedEntry> appendCompletionMarker(WAL::OpID opId, WAL::OpStatus status) noexcept;
+	[[nodiscard]] std::optional<AppendedEntry> appendCompletionMarkerEntry(WAL::OpID opId, WAL::OpStatus status) noexcept;
+
+	// Makes the ring slot ready to accept the entries of block #blockSeq. 'initialCursor' holds the reservations made in advance, if any.
+	void openBlock(uint64_t blockSeq, WAL::OpID firstOpId, uint64_t initialCursor = 0) noexcept;
+	// Reserves 'entrySize' bytes in the current block for the entry, rotating the ring as needed, and has writeEntry(std::span<std::byte>) compose it in place.
+	// The entry is assigned a new OpID, unless it refers to an existing operation ('referencedOpId', a completion marker entry). Either one is written into the entry.
+	template <typename EntryWriter>
+	[[nodiscard]] std::optional<AppendedEntry> appendEntry(size_t entrySize, EntryWriter&& writeEntry, std::optional<WAL::OpID> referencedOpId = {}) noexcept;
+	// Appends the entries (stored back-to-back) under consecutive OpIDs, sealing as many blocks as needed, and returns the last one.
+	// The current block is filled with a single reservation, the following ones are reserved for the batch before they're opened to the other writers.
+	[[nodiscard]] std::optional<AppendedEntry> appendEntries(std::span<const std::byte> entries, std::span<const size_t> entrySizes) noexcept;
+	// Copies the entries (as many as there are sizes) into the block starting at entry #firstEntryIndex, filling in their OpIDs
+	void copyEntries(Block& block, size_t firstEntryIndex, size_t entryOffset, std::span<const std::byte> entries, std::span<const size_t> entrySizes) noexcept;
+	// Marks the entries (or completion markers) as copied. Finalizes the block if it's sealed and these were the last ones missing.
+	void publishEntry(Block& block, uint64_t count = 1) noexcept;
+	// Stores the time stamp of the first entry or marker of the block, unless there is one already
+	static void markBlockStart(Block& block, uint64_t timeStamp) noexcept;
+	// Stores the time stamp of an entry or marker added after the first one, for the adaptive flush timeout
+	void markBlockArrival(Block& block) const noexcept;
+	void finalizeBlock(Block& block) noexcept;
+
+	enum class SealReason : uint8_t { Full, Timeout, Close };
+
+	// Stops the reservations in block #blockSeq and seals it, unless it's empty or has been sealed already
+	[[nodiscard]] bool closeBlock(uint64_t blockSeq, SealReason reason = SealReason::Full) noexcept;
+	// Seals the current block, which has just been closed for reservations, and makes the next ring slot current.
+	// Waits for a ring slot to be written out (or writes it, as allowed by the flush mode) if all of them are occupied.
+	[[nodiscard]] bool sealBlock(std::unique_lock<checked_mutex>& lock, Block& block, const CursorState& contents, uint64_t nextBlockCursor = 0, SealReason reason = SealReason::Full) noexcept;
+	// Waits until the block #blockSeq is no longer current
+	void waitForBlockRotation(uint64_t blockSeq) noexcept;
+
+	// Writes all the sealed blocks to the log, in order, and releases their waiters.
+	[[nodiscard]] bool writeSealedBlocks() noexcept;
+	// Group commit: one vectored write and one flush for all the blocks (one write per segment in a segmented log), and the sync per commit if enabled
+	[[nodiscard]] bool writeBlocks(std::span<const io::ConstBuffer> blocks, uint64_t firstBlockSeq) noexcept;
+
+	// Segmented log only
+	[[nodiscard]] constexpr bool segmentedLog() const noexcept;
+	[[nodiscard]] constexpr size_t dataBlocksPerSegment() const noexcept;
+	[[nodiscard]] constexpr uint64_t segmentFilePos(size_t slot) const noexcept;
+	// Which segment the block #blockSeq of this session goes into
+	[[nodiscard]] constexpr uint64_t segmentSeqForBlock(uint64_t blockSeq) const noexcept;
+	[[nodiscard]] static constexpr uint32_t segmentChecksumSalt(uint64_t segmentSeq) noexcept;
+	[[nodiscard]] constexpr uint32_t blockChecksumSalt(uint64_t blockSeq) const noexcept;
+	// The size of the block starting with 'header', or 0 if the header isn't valid
+	[[nodiscard]] static size_t blockSizeFromHeader(const std::byte* header) noexcept;
+	[[nodiscard]] static BlockChecksumType blockChecksum(WAL::BlockChecksum algorithm, const std::byte* data, size_t size) noexcept;
+	// Reads the segment headers of the existing log, preallocates the ring and picks up the segment and operation numbering from there
+	[[nodiscard]] bool openSegments() noexcept;
+	[[nodiscard]] std::optional<SegmentHeader> readSegmentHeader(size_t slot) noexcept;
+	// Picks the slot for the segment that starts with 'firstBlock' and composes its header
+	[[nodiscard]] bool startSegment(const Block& firstBlock, io::StaticBufferAdapter<BlockSize>& headerBuffer) noexcept;
+
+	// Registers the operations as pending. Done before they are published, so that no operation can be written to the log before it's known to be pending.
+	void addPendingOperations(WAL::OpID firstOpId, size_t count) noexcept;
+	// WAL::OpID max if there are none
+	[[nodiscard]] WAL::OpID oldestPendingOperation() noexcept;
+
+	[[nodiscard]] bool currentBlockIsEmpty() const noexcept;
+	[[nodiscard]] bool hasSealedBlocks() const noexcept;
+	[[nodiscard]] bool ringIsFull() const noexcept;
+	[[nodiscard]] static constexpr CursorState cursorState(uint64_t cursor) noexcept;
+	// Whether this many entries and completion markers fit into the block (which is also limited by the op count threshold)
+	[[nodiscard]] constexpr bool contentsFit(size_t itemCount, size_t entriesSize, size_t completionCount) const noexcept;
+	[[nodiscard]] constexpr bool contentsFit(const CursorState& contents) const noexcept;
+	// Whether the reservation of 'size' bytes made after 'countBefore' entries and markers taking 'sizeBefore' bytes reaches the flush threshold.
+	// Only true for the one reservation that reaches it.
+	[[nodiscard]] constexpr bool flushThresholdReached(size_t countBefore, size_t sizeBefore, size_t size) const noexcept;
+	// Where the completion marker #index goes in a block of 'blockSize' bytes
+	[[nodiscard]] static constexpr size_t completionMarkerOffset(size_t blockSize, size_t index) noexcept;
+	[[nodiscard]] constexpr bool flusherThreadMode() const noexcept;
+	// How long the first writer of a block waits for more entries
+	[[nodiscard]] uint64_t flushTimeoutUs() const noexcept;
+	[[nodiscard]] static uint64_t timeStampUs() noexcept;
+	// 0 unless WAL::Options::latencyStats is on
+	[[nodiscard]] uint64_t latencyStatsTimeStamp() const noexcept;
+	// Records the commit latency and the flush wait time of a call that started at 'startTimeStamp' and started waiting at 'waitStartTimeStamp'
+	void recordLatency(uint64_t startTimeStamp, uint64_t waitStartTimeStamp) noexcept;
+
+	void startFlusherThread() noexcept;
+	void stopFlusherThread() noexcept;
+	void flusherThreadFunction() noexcept;
+	// Called by the writer that has put the first item into the current block
+	void notifyFlusherBlockStarted() noexcept;
+
+	// Durability::Periodic only
+	void startSyncThread() noexcept;
+	void stopSyncThread() noexcept;
+	// The adapter may outlive the WAL (and the ring it has registered), it's detached from the ring when the log is closed. Call under _mtxLogFile.
+	void unregisterBlockBuffers() noexcept;
+	void syncThreadFunction() noexcept;
+
+	// Waits for the block #blockSeq to get written.
+	// If that doesn't happen within certain time, seals and writes it.
+	void waitForFlushAndHandleTimeout(uint64_t blockSeq, bool firstWriter, uint64_t operationStartTimeStamp) noexcept;
+	// Wakes up the threads waiting for the block that has just been written
+	void notifyFlushed(Block& block) noexcept;
+
+	// Stores the continuation to be run once the operation #opId has been flushed.
+	// Returns false and leaves the continuation alone if that has already happened.
+	[[nodiscard]] bool addFlushContinuation(WAL::OpID opId, std::function<void()>& continuation) noexcept;
+	// Wakes up the completion thread if any of the continuations are due
+	void notifyFlushContinuations() noexcept;
+	[[nodiscard]] bool hasReadyFlushContinuations() const noexcept;
+
+	// Flusher thread mode only: runs the continuations of the flushed operations
+	void startCompletionThread() noexcept;
+	void stopCompletionThread() noexcept;
+	void completionThreadFunction() noexcept;
 
-	io::StaticBufferAdapter<BlockSize> _block;
-	std::atomic<size_t> _blockItemCount = 0;
+private:
+	const WAL::Options _options;
 
-	// Solely for tracking how many ops are pending. When none, the log can be trimmed
-	std::vector<WAL::OpID> _pendingOperations;
-	size_t _operationsProcessed = 0;
+	// Only taken for rotating the block ring
+	checked_mutex _mtxBlock;
+	// Serializes the log file access. May be taken while holding _mtxBlock, but not the other way around.
+	checked_mutex _mtxLogFile;
+	// The last operation that has been written to the log
+	std::atomic<WAL::OpID> _lastFlushedOpId = 0;
+	// Only used by the first writer of a block to wait for the flush with a timeout
+	std::mutex _mtxFlushTimer;
+	std::condition_variable _flushTimerCv;
+	// Fed by sealBlock() and writeSealedBlocks(). Only picks the timeout in FlushTimeoutMode::Adaptive.
+	WAL::AdaptiveFlushTimeout _adaptiveFlushTimeout;
+	WAL::StatsCounters _stats;
+
+	// Async registration only
+	std::thread _completionThread;
+	std::mutex _mtxFlushContinuations;
+	std::condition_variable _flushContinuationsCv;
+	std::vector<FlushContinuation> _flushContinuations;
+	bool _stopCompletionThread = false;
+
+	std::array<Block, BlockRingSize> _blocks;
+	// Sequence number of the block being filled. Blocks [_flushedBlockSeq; _currentBlockSeq) are sealed and waiting to be written.
+	// Only modified under _mtxBlock.
+	std::atomic<uint64_t> _currentBlockSeq = 0;
+	// Sequence number of the oldest block that hasn't been written yet. Only modified under _mtxLogFile.
+	std::atomic<uint64_t> _flushedBlockSeq = 0;
+	// Wakes up the writers that didn't fit into the current block once the next one is ready
+	std::condition_variable_any _blockRotatedCv;
+
+	// Flusher thread mode only
+	std::thread _flusherThread;
+	// Wakes up the flusher when there's work for it (protected by _mtxBlock)
+	std::condition_variable_any _flusherCv;
+	// Wakes up the writers waiting for a free slot in the ring
+	std::condition_variable_any _blockSpaceCv;
+	bool _stopFlusher = false;
+
+	// Whether each group commit is followed by sync()
+	bool _syncPerCommit = false;
+	// Durability::Periodic only
+	std::thread _syncThread;
+	std::mutex _mtxSyncThread;
+	std::condition_variable _syncThreadCv;
+	bool _stopSyncThread = false;
+
+	// The registered operations that haven't completed yet. Validates updateOpStatus() calls and gives the checkpoint of a segmented log.
+	std::mutex _mtxPendingOperations;
+	WAL::PendingOperations _pendingOperations;
+
+	// Segmented log only. Only accessed under _mtxLogFile, except for the numbering that's set when the log is opened.
+	std::vector<Segment> _segments;
+	size_t _currentSegment = 0;
+	// The first block and the first segment of this session
+	uint64_t _segmentBaseBlockSeq = 0;
+	uint64_t _firstSegmentSeq = 1;
+	// The checkpoint of the previous session, until verifyLog() has reported its pending operations
+	WAL::OpID _checkpointFloor = std::numeric_limits<WAL::OpID>::max();
 
 	StorageIO<StorageAdapter> _logFile;
-	WAL::OpID _lastOpId = 0; // Only accessed under mutex - doesn't have to be atomic
+	// Unsegmented log only: where the next group commit goes. verifyLog() moves it back to the end of the valid data, so that a group commit torn by a crash is overwritten.
+	// Only accessed under _mtxLogFile.
+	uint64_t _logEnd = 0;
+	// Whether the block ring is registered with the adapter. Only accessed under _mtxLogFile.
+	bool _blockBuffersRegistered = false;
 
 	const std::thread::id _ownerThreadId = std::this_thread::get_id();
 };
 
-template<RecordType Record, class StorageAdapter>
-DbWAL<Record, StorageAdapter>::~DbWAL() noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+DbWAL<Record, StorageAdapter, BlockSizeBytes>::~DbWAL() noexcept
 {
+	stopCompletionThread();
+	stopFlusherThread();
+	stopSyncThread();
+
+	{
+		// In case the log wasn't closed
+		std::lock_guard fileLock(_mtxLogFile);
+		unregisterBlockBuffers();
+	}
+
 	std::lock_guard lock(_mtxBlock);
-	assert_r(blockIsEmpty());
+	assert_r(currentBlockIsEmpty());
+	assert_r(!hasSealedBlocks());
+	assert_r(_flushContinuations.empty());
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::FlushTicket::wait() const noexcept
+{
+	// The flusher thread takes care of the timeout
+	_wal->waitForFlushAndHandleTimeout(_blockSeq, false, 0);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template <typename Callback>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::FlushTicket::onFlushed(Callback&& callback) const
+{
+	std::function<void()> continuation{ std::forward<Callback>(callback) };
+	if (!_wal->addFlushContinuation(_opId, continuation))
+		continuation();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+auto DbWAL<Record, StorageAdapter, BlockSizeBytes>::FlushTicket::operator co_await() const noexcept
+{
+	struct Awaiter {
+		FlushTicket ticket;
+
+		[[nodiscard]] bool await_ready() const noexcept {
+			return ticket.flushed();
+		}
+
+		// Returning false resumes the coroutine right away
+		[[nodiscard]] bool await_suspend(const std::coroutine_handle<> coroutine) const {
+			std::function<void()> continuation{ coroutine };
+			return ticket._wal->addFlushContinuation(ticket._opId, continuation);
+		}
+
+		[[nodiscard]] WAL::OpID await_resume() const noexcept {
+			return ticket._opId;
+		}
+	};
+
+	return Awaiter{ *this };
 }
 
-template<RecordType Record, class StorageAdapter>
-[[nodiscard]] bool DbWAL<Record, StorageAdapter>::openLogFile(const std::string& filePath) noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+[[nodiscard]] bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::openLogFile(const std::string& filePath) noexcept
 {
 	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
 	std::lock_guard lock(_mtxBlock);
 
-	startNewBlock();
-	return _logFile.open(filePath, io::OpenMode::Write);
+	assert_r(currentBlockIsEmpty());
+	{
+		std::lock_guard fileLock(_mtxLogFile);
+
+		const bool writeThroughRequested = _options.durability == WAL::Durability::WriteThrough;
+		const bool writeThroughSupported = _logFile.setWriteThrough(writeThroughRequested);
+		_syncPerCommit = _options.durability == WAL::Durability::SyncPerCommit || (writeThroughRequested && !writeThroughSupported);
+
+		// In a segmented log every block has a BlockSize-aligned slot, which must not straddle the device's atomic write units.
+		// The plain log packs the blocks at sector granularity whatever the block size, a block torn across the device blocks is caught by its checksum.
+		// The in-memory adapters have no path.
+		assert_and_return_message_r(!segmentedLog() || filePath.empty() || checkBlockSize(filePath, BlockSize), "The WAL block size is not a multiple of the storage device block size!", false);
+
+		if (!segmentedLog())
+		{
+			assert_and_return_r(_logFile.open(filePath, io::OpenMode::Write), false);
+			_logEnd = _logFile.size();
+		}
+		else
+		{
+			// The segments are overwritten in place, and the existing ones have to be read
+			assert_and_return_r(_logFile.open(filePath, io::OpenMode::ReadWrite), false);
+			assert_and_return_r(openSegments(), false);
+		}
+
+		// The ring blocks are written over and over again, the adapters that can set them up for I/O once (io_uring) do so. Optional.
+		std::array<io::ConstBuffer, BlockRingSize> blockBuffers;
+		for (size_t i = 0; i < BlockRingSize; ++i)
+			blockBuffers[i] = io::ConstBuffer{ .data = _blocks[i].buffer.data(), .size = BlockSize };
+		_blockBuffersRegistered = _logFile.registerBuffers(blockBuffers);
+	}
+
+	if (flusherThreadMode())
+	{
+		startFlusherThread();
+		startCompletionThread();
+	}
+	if (_options.durability == WAL::Durability::Periodic)
+		startSyncThread();
+
+	return true;
 }
 
-template<RecordType Record, class StorageAdapter>
-[[nodiscard]] bool DbWAL<Record, StorageAdapter>::closeLogFile() noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+[[nodiscard]] bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::closeLogFile() noexcept
 {
 	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
-	std::lock_guard lock(_mtxBlock);
 
-	if (!blockIsEmpty())
-		assert_and_return_r(finalizeAndflushCurrentBlock(), false);
+	// The continuations may still register operations, the flusher has to be there for them
+	stopCompletionThread();
+	// The flusher writes out whatever is left in the ring before exiting
+	stopFlusherThread();
+
+	assert_and_return_r(closeBlock(_currentBlockSeq, SealReason::Close), false);
+	assert_and_return_r(writeSealedBlocks(), false);
+
+	stopSyncThread();
+
+	std::lock_guard fileLock(_mtxLogFile);
+	if (_options.durability != WAL::Durability::None)
+		assert_and_return_r(_logFile.sync(), false);
 
+	unregisterBlockBuffers();
 	return _logFile.close();
 }
 
-template<RecordType Record, class StorageAdapter>
-[[nodiscard]] bool DbWAL<Record, StorageAdapter>::clearLog() noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+[[nodiscard]] bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::clearLog() noexcept
 {
 	std::lock_guard lock(_mtxBlock);
+	std::lock_guard fileLock(_mtxLogFile);
 
 	// Do not clear the current block! It's in progress and should not be touched here.
 
+	if (segmentedLog())
+	{
+		// No truncation: all the segments but the current one become free for reuse
+		for (size_t slot = 0; slot < _segments.size(); ++slot)
+		{
+			if (slot != _currentSegment)
+				_segments[slot].lastOpId = 0;
+		}
+		_checkpointFloor = std::numeric_limits<WAL::OpID>::max();
+		return true;
+	}
+
 	assert_and_return_r(_logFile.clear(), false);
+	_logEnd = 0;
 	return _logFile.flush();
 }
 
+
 /* Entry structure :
 
    -----------------------------------------------------------------------------------------------------------------
   |            Field                                |           Size              |        Offset from start        |
   |-------------------------------------------------|-----------------------------|---------------------------------|
-  | Complete entry SIZE (2 bytes max for 4K blocks) | sizeof(EntrySizeType) bytes |                         0 bytes |
+  | Complete entry SIZE (2 bytes up to 64K blocks)  | sizeof(EntrySizeType) bytes |                         0 bytes |
   | Operation ID                                    | 4 bytes                     |     sizeof(EntrySizeType) bytes |
   | Serialized operation DATA                       | var. length                 | sizeof(EntrySizeType) + 4 bytes |
    -----------------------------------------------------------------------------------------------------------------
 
+  With the compact encoding (compactEncoding_v<Record>, block format version 2):
+
+  - Complete entry SIZE, a varint
+  - Operation ID minus the block's first OpID minus the entry's index in the block, a zigzag varint:
+    0 for an operation, 5 bytes padded with redundant continuation bytes for a completion marker entry
+  - Serialized operation DATA in the compact encoding
+
 
    Block format:
 
-  - Number of entries (2 bytes for 4K block size)
+  - Block format version (1 byte): 1, or 2 for the compact entries
+  - Checksum algorithm, WAL::BlockChecksum (1 byte)
+  - Block size in 512-byte sectors (2 bytes)
+  - Number of entries (2 bytes up to 64K block size)
   - Entry 1
   - ...
   - Entry N
+  - Zero padding
+  - Completion marker M (3 bytes: the completed operation's ID minus the block's first OpID, 2 bytes, and the status)
+  - ...
+  - Completion marker 1
+  - ID of the first operation in the block (4 bytes), the base for the completion markers
+  - Number of completion markers (2 bytes)
+  - Checksum over the whole block (4 bytes), XOR-ed with the segment's salt in a segmented log
+
+  A block whose format version isn't known is treated as invalid.
+
+  The blocks follow each other without gaps, so the log is only readable from the start. A crash can tear the last group commit written,
+  which verifyLog() tells from corruption by there being no room for another group commit after the invalid block. The rest of the torn commit
+  is zeroed by verifyLog().
+
+  A completion marker whose delta doesn't fit is logged as an entry instead: size, the completed operation's ID, marker ID (1 byte), status (1 byte).
+
+
+   Segment header format (a whole block):
+
+  - Magic number (4 bytes)
+  - Segment size in blocks (4 bytes)
+  - Segment sequence number (8 bytes)
+  - ID of the first operation in the segment (4 bytes)
+  - Checkpoint: every operation below this ID had completed when the segment was started (4 bytes)
   - Checksum over the whole block (4 bytes)
 */
 
-template<RecordType Record, class StorageAdapter>
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
 template <typename Receiver>
-[[nodiscard]] bool DbWAL<Record, StorageAdapter>::verifyLog(Receiver&& unfinishedOperationsReceiver) noexcept
+[[nodiscard]] bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::verifyLog(Receiver&& unfinishedOperationsReceiver) noexcept
 {
 	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
 	std::lock_guard lock(_mtxBlock); // Should not be required, but just in case. Using at as a more of a global lock on the _logfile.
+	std::lock_guard fileLock(_mtxLogFile);
 
-	assert_and_return_r(_logFile.pos() == 0, false);
+	assert_and_return_r(segmentedLog() || _logFile.pos() == 0, false);
 
-	// This is the buffer for the whole WAL block
-	io::StaticBufferAdapter<BlockSize> blockBuffer;
-	blockBuffer.reserve(BlockSize);
-	StorageIO blockBufferIo{ blockBuffer };
+	const LogContents log = logContents();
+	// Where the valid data of the last extent ends
+	uint64_t dataEnd = 0;
+
+	// Whether or not the operation completed successfully or failed, it has been handled by the storage and no replay is required.
+	// The operations are logged in the ascending OpID order, and each one precedes its completion marker, so the first pending operation in the log is the base for the set.
+	WAL::OpIdSet completedOperations;
+	const auto operationCompleted = [&](const WAL::OpID operationId) {
+		return operationId < log.checkpointOpId || completedOperations.contains(operationId);
+	};
+
+	const auto collectCompletedOperation = [&](const WAL::OpID operationId) {
+		completedOperations.insert(operationId);
+		return true;
+	};
+
+	const auto collectCompletionMarker = [&](auto& entryIo, const WAL::OpID operationId) {
+		if (Serializer::isOperationCompletionMarker(entryIo))
+		{
+			completedOperations.insert(operationId);
+			return false;
+		}
+		else if (operationId < log.checkpointOpId)
+			return false;
+
+		if (!completedOperations.hasBase())
+			completedOperations.setBase(operationId);
+		return true;
+	};
 
-	assert_r(_logFile.size() % BlockSize == 0);
+	WorkerPool workers{ _options.verificationThreads };
+	const auto noCompletionHandling = [](WAL::OpID) { return true; };
+	const auto noChunkHandling = [] { return true; };
 
-	std::vector<WAL::OpID> completedOperations;
-	const auto isCompleted = [&completedOperations](const WAL::OpID id) {
-		return std::find(completedOperations.begin(), completedOperations.end(), id) != completedOperations.end();
+	// With more than one thread, the pending operations are queued up and decoded by the workers a chunk at a time.
+	// The templated operations are kept type-erased until they're handed to the receiver in the log order, that is, the OpID order.
+	std::vector<std::byte> queuedPayloads;
+	std::vector<size_t> queuedPayloadEnds;
+	std::vector<std::function<void()>> queuedReplays;
+
+	const auto replayOperation = [&](auto& entryIo, const size_t payloadSize) {
+		if (workers.threadCount() == 1)
+		{
+			// Contruct the operation and report that it has to be replayed.
+			// Reports operations that are logged but weren't completed against the storage.
+			const bool deserializedSuccessfully = Serializer::deserialize(entryIo, std::forward<Receiver>(unfinishedOperationsReceiver));
+			assert_and_return_message_r(deserializedSuccessfully, "Failed to deserialize an operation from log, but checksum has been verified!", false);
+			return true;
+		}
+
+		const size_t payloadOffset = queuedPayloads.size();
+		queuedPayloads.resize(payloadOffset + payloadSize);
+		assert_and_return_r(entryIo.read(queuedPayloads.data() + payloadOffset, payloadSize), false);
+		queuedPayloadEnds.push_back(payloadOffset + payloadSize);
+		return true;
 	};
 
-	// Two passes are required because of the templated operation types that cannot be [easily] stored at runtime.
-	//
-	// The first pass reads and stores all operation completion markers. Whether or not the operation completed successfully or failed, it has been handled by the storage and no replay is required.
-	// So the 1st pass only reads the IDs of completed operations and skips everything else.
-	//
-	// Then the seconds pass can skip reading all the operations that have completed successfully and process the ones that didn't.
+	const auto replayQueuedOperations = [&] {
+		queuedReplays.resize(queuedPayloadEnds.size());
+		const bool decodedSuccessfully = workers.run(queuedReplays.size(), [&](const size_t i) {
+			// Deserialized in place: the record views, if requested, point into the queued payloads, which are kept until the operations are replayed
+			const size_t payloadOffset = i == 0 ? 0 : queuedPayloadEnds[i - 1];
+			io::SpanAdapter payloadBuffer{ std::span{ queuedPayloads }.subspan(payloadOffset, queuedPayloadEnds[i] - payloadOffset) };
+			StorageIO payloadIo{ payloadBuffer };
+
+			const auto queueOperation = [&](auto&& op) {
+				// The operations hold const members, so they can be copied, but not moved. Only the pointer is moved around here.
+				queuedReplays[i] = [&unfinishedOperationsReceiver, queuedOp = std::make_shared<std::remove_cvref_t<decltype(op)>>(std::as_const(op))] {
+					unfinishedOperationsReceiver(std::move(*queuedOp));
+				};
+			};
+
+			if constexpr (WAL::receivesRecordViews_v<std::remove_cvref_t<Receiver>>)
+				return Serializer::deserialize(payloadIo, WAL::RecordViews{ queueOperation });
+			else
+				return Serializer::deserialize(payloadIo, queueOperation);
+		});
+		assert_and_return_message_r(decodedSuccessfully, "Failed to deserialize an operation from log, but checksum has been verified!", false);
+
+		for (auto& replay : queuedReplays)
+			replay();
+
+		queuedReplays.clear();
+		queuedPayloads.clear();
+		queuedPayloadEnds.clear();
+		return true;
+	};
 
-	// Remeber: malformed last block is not an error
-	for (size_t pass = 1; pass <= 2; ++pass)
+	if (_options.verificationMode == WAL::VerificationMode::TwoPass)
 	{
-		while (!_logFile.atEnd() && (_logFile.size() - _logFile.pos() >= BlockSize))
+		// Two passes are required because of the templated operation types that cannot be [easily] stored at runtime.
+		//
+		// The first pass reads and stores all operation completion markers, skipping everything else.
+		// Then the second pass can skip reading all the operations that have completed and process the ones that didn't.
+		for (const auto& extent : log.extents)
 		{
-			const bool isLastBlock = _logFile.size() - _logFile.pos() == BlockSize;
-			if (!_logFile.read(blockBuffer.data(), BlockSize))
-			{
-				if (isLastBlock)
-					continue; // Not an error
-				else
-					fatalAbort("Failed to read a WAL block that's not the last one!");
-			}
+			const auto extentDataEnd = forEachLogEntry(workers, extent, [&](auto& entryIo, const EntryHeader& entry, uint64_t /*entryFilePos*/) {
+				collectCompletionMarker(entryIo, entry.opId);
+				return true;
+			}, collectCompletedOperation, noChunkHandling);
+			assert_and_return_r(extentDataEnd, false);
+			dataEnd = *extentDataEnd;
+		}
 
-			blockBuffer.seek(0);
+		for (const auto& extent : log.extents)
+		{
+			assert_and_return_r(forEachLogEntry(workers, extent, [&](auto& entryIo, const EntryHeader& entry, uint64_t /*entryFilePos*/) {
+				if (operationCompleted(entry.opId) || Serializer::isOperationCompletionMarker(entryIo))
+					return true;
 
-			// Verify checksum before processing the block
-			const auto checksum = memory_cast<BlockChecksumType>(blockBuffer.data() + BlockSize - sizeof(BlockChecksumType));
+				return replayOperation(entryIo, entry.payloadSize);
+			}, noCompletionHandling, replayQueuedOperations), false);
+		}
+	}
+	else
+	{
+		// Single pass: only the location of every operation is stored, and the pending ones are read again in the end.
+		// Cheaper than reading the whole log twice, as long as most of the operations have completed.
+		struct LoggedOperation {
+			uint64_t entryFilePos;
+			WAL::OpID id;
+			EntrySizeType entrySize;
+		};
+
+		std::vector<LoggedOperation> loggedOperations;
+		for (const auto& extent : log.extents)
+		{
+			const auto extentDataEnd = forEachLogEntry(workers, extent, [&](auto& entryIo, const EntryHeader& entry, const uint64_t entryFilePos) {
+				if (collectCompletionMarker(entryIo, entry.opId))
+					loggedOperations.push_back(LoggedOperation{ .entryFilePos = entryFilePos, .id = entry.opId, .entrySize = static_cast<EntrySizeType>(entry.entrySize) });
+				return true;
+			}, collectCompletedOperation, noChunkHandling);
+			assert_and_return_r(extentDataEnd, false);
+			dataEnd = *extentDataEnd;
+		}
 
-			const auto actualChecksum = wheathash32(blockBuffer.data(), BlockSize - sizeof(BlockChecksumType));
-			if (checksum != actualChecksum)
-			{
-				if (isLastBlock)
-					continue; // Not an error
-				else
-					fatalAbort("Failed to read a WAL block that's not the last one!");
-			}
+		io::StaticBufferAdapter<BlockSize> entryBuffer;
+		entryBuffer.reserve(BlockSize);
+		StorageIO entryIo{ entryBuffer };
 
-			BlockItemCountType itemCountInBlock = 0;
-			assert_and_return_r(blockBufferIo.read(itemCountInBlock), false);
-			assert_and_return_r(itemCountInBlock > 0 && itemCountInBlock <= MaxItemCount, false);
+		for (const auto& operation : loggedOperations)
+		{
+			if (operationCompleted(operation.id))
+				continue;
+
+			assert_and_return_r(_logFile.seek(operation.entryFilePos), false);
+			assert_and_return_r(_logFile.read(entryBuffer.data(), operation.entrySize), false);
+			assert_and_return_r(entryBuffer.seek(0), false);
+			// Only the operations get here, so their IDs are the implied ones
+			const auto entry = readEntryHeader(entryIo, operation.id);
+			assert_and_return_r(entry && entry->opId == operation.id, false);
+			assert_and_return_r(replayOperation(entryIo, entry->payloadSize), false);
+			if (queuedPayloads.size() >= VerificationChunkBlocks * BlockSize)
+				assert_and_return_r(replayQueuedOperations(), false);
+		}
+		assert_and_return_r(replayQueuedOperations(), false);
+	}
 
-			for (size_t i = 0; i < itemCountInBlock; ++i)
-			{
-				const auto entryStartPos = blockBufferIo.pos();
-				EntrySizeType wholeEntrySize = 0;
-				assert_and_return_r(blockBufferIo.read(wholeEntrySize) && wholeEntrySize > 0, false);
-
-				WAL::OpID operationId = 0;
-				assert_and_return_r(blockBufferIo.read(operationId) && operationId != 0, false);
-
-				// First pass: skip everything. Second pass: skip operations that were marked as completed.
-				const bool skipEntry = pass == 1 || isCompleted(operationId);
-
-				if (pass == 1 && Serializer::isOperationCompletionMarker(blockBufferIo))
-					completedOperations.push_back(operationId);
-
-				if (skipEntry)
-					assert_and_return_r(blockBufferIo.seek(entryStartPos + wholeEntrySize), false);
-				else
-				{
-					// Contruct the operation and report that it has to be replayed.
-					// Reports operations that are logged but weren't completed against the storage.
-					const bool deserializedSuccessfully = Serializer::deserialize(blockBufferIo, std::forward<Receiver>(unfinishedOperationsReceiver));
-					assert_and_return_message_r(deserializedSuccessfully, "Failed to deserialize an operation from log, but checksum has been verified!", false);
-				}
-			}
+	if (segmentedLog())
+	{
+		// The pending operations of the previous session have been reported, its segments can be reused from now on
+		for (auto& segment : _segments)
+		{
+			if (segment.seq < _firstSegmentSeq)
+				segment.lastOpId = 0;
+		}
+		_checkpointFloor = std::numeric_limits<WAL::OpID>::max();
+	}
+	else
+	{
+		// Dropping the torn group commit, if any. What's left of it is zeroed: otherwise, its blocks past the end of a later, shorter commit
+		// would be taken for valid data next time.
+		if (const uint64_t logSize = _logFile.size(); logSize > dataEnd)
+		{
+			const std::vector<std::byte> zeros(static_cast<size_t>(logSize - dataEnd));
+			assert_and_return_r(_logFile.seek(dataEnd), false);
+			assert_and_return_r(_logFile.write(zeros.data(), zeros.size()), false);
+			assert_and_return_r(_logFile.flush(), false);
+			if (_options.durability != WAL::Durability::None)
+				assert_and_return_r(_logFile.sync(), false);
 		}
 
-		if (pass == 1)
-			assert_and_return_r(_logFile.seek(0), false);
+		_logEnd = dataEnd;
 	}
 
-	return true;
+	return _logFile.seekToEnd();
 }
 
-// Registers the new operation and returns its unique ID. Empty optional = failure to register.
-
-template<RecordType Record, class StorageAdapter>
-template<class OpType>
-[[nodiscard]] std::optional<WAL::OpID>
-DbWAL<Record, StorageAdapter>::registerOperation(OpType&& op) noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template <typename EntryHandler, typename CompletionHandler, typename ChunkHandler>
+std::optional<uint64_t> DbWAL<Record, StorageAdapter, BlockSizeBytes>::forEachLogEntry(WorkerPool& workers, const LogExtent& extent, EntryHandler&& entryHandler, CompletionHandler&& completionHandler, ChunkHandler&& chunkHandler) noexcept
 {
-	// Compose all the data in a buffer and then write in one go.
-	// Reference: https://github.com/VioletGiraffe/cpp-db/wiki/WAL
+	assert_debug_only(_mtxLogFile.locked_by_caller());
 
-	// This is the buffer for the single entry, it cannot exceed the block size
-	io::StaticBufferAdapter<BlockSize> entryBuffer;
+	const uint64_t extentEnd = extent.endPos;
+	std::vector<std::byte> chunk(static_cast<size_t>(std::min<uint64_t>(extentEnd - extent.beginPos, VerificationChunkBlocks * BlockSize)));
+	// Offset in the chunk and size of every block found in it
+	std::vector<std::pair<size_t, size_t>> chunkBlocks;
+	std::vector<uint8_t> blockChecksumValid;
 
-	// Reserving space for the total entry size and operation ID in the beginning
-	entryBuffer.reserve(sizeof(EntrySizeType) + sizeof(WAL::OpID));
-	entryBuffer.seekToEnd();
+	// This is the buffer for the whole WAL block
+	io::StaticBufferAdapter<BlockSize> blockBuffer;
+	blockBuffer.reserve(BlockSize);
+	StorageIO blockBufferIo{ blockBuffer };
 
-	StorageIO io{ entryBuffer };
+	// A preallocated segment ends at the first block that doesn't check out: it was never written, or is left over from the segment's previous use.
+	// Otherwise, only the last group commit is allowed to be malformed, having been torn by a crash. It's written in one go, so any of its blocks
+	// may be missing while the following ones have made it to the disk. Those were never reported as flushed and are dropped along with it.
+	const auto invalidBlockFound = [&](const uint64_t blockFilePos) -> std::optional<uint64_t> {
+		if (!extent.endsAtInvalidBlock && extentEnd - blockFilePos > MaxGroupCommitSize)
+			fatalAbort("Failed to read a WAL block that's not in the last group commit!");
 
-	// !!!!!!!!!!!!!!!!!! Warning: unsafe to use 'op' after forwarding it
-	assert_and_return_r(Serializer::serialize(std::forward<OpType>(op), io), {});
+		assert_and_return_r(chunkHandler(), {});
+		return blockFilePos;
+	};
 
-	// Fill in the size
-	const auto entrySize = entryBuffer.size();
-	assert_debug_only(entrySize <= std::numeric_limits<EntrySizeType>::max());
-	assert_debug_only(entrySize > MinItemSize);
+	uint64_t chunkFilePos = extent.beginPos;
+	while (chunkFilePos < extentEnd)
+	{
+		const size_t chunkSize = static_cast<size_t>(std::min<uint64_t>(extentEnd - chunkFilePos, chunk.size()));
+		assert_and_return_r(_logFile.seek(chunkFilePos), {});
+		assert_and_return_r(_logFile.read(chunk.data(), chunkSize), {});
+
+		// Each block starts with its size. A block cut off by the end of the chunk is read again as a part of the next chunk.
+		chunkBlocks.clear();
+		size_t chunkDataSize = 0;
+		bool blockSizeValid = true;
+		while (chunkSize - chunkDataSize >= BlockHeaderSize)
+		{
+			const size_t blockSize = blockSizeFromHeader(chunk.data() + chunkDataSize);
+			blockSizeValid = blockSize > 0;
+			if (!blockSizeValid || chunkSize - chunkDataSize < blockSize)
+				break;
 
-	assert_r(io.write(static_cast<EntrySizeType>(entrySize), 0 /* position to write at */));
+			chunkBlocks.emplace_back(chunkDataSize, blockSize);
+			chunkDataSize += blockSize;
+		}
 
-	bool firstWriter = false;
-	uint64_t timeStamp = 0;
-	WAL::OpID newOpId = 0;
+		// Verify checksums before processing the blocks
+		blockChecksumValid.resize(chunkBlocks.size());
+		const bool checksumsVerified = workers.run(chunkBlocks.size(), [&](const size_t i) {
+			const auto [blockOffset, blockSize] = chunkBlocks[i];
+			const std::byte* block = chunk.data() + blockOffset;
+			const auto checksum = memory_cast<BlockChecksumType>(block + blockSize - sizeof(BlockChecksumType));
+			const auto algorithm = memory_cast<WAL::BlockChecksum>(block + sizeof(BlockFormatVersion));
+			blockChecksumValid[i] = checksum == (blockChecksum(algorithm, block, blockSize - sizeof(BlockChecksumType)) ^ extent.checksumSalt);
+			return true;
+		});
+		assert_and_return_r(checksumsVerified, {});
+
+		for (size_t blockIndex = 0; blockIndex < chunkBlocks.size(); ++blockIndex)
+		{
+			const auto [blockOffset, blockSize] = chunkBlocks[blockIndex];
+			const uint64_t blockFilePos = chunkFilePos + blockOffset;
+			if (!blockChecksumValid[blockIndex])
+				return invalidBlockFound(blockFilePos);
 
-	{
-		// Time to lock the shared block buffer
-		std::lock_guard lock{_mtxBlock};
+			::memcpy(blockBuffer.data(), chunk.data() + blockOffset, blockSize);
 
-		newOpId = ++_lastOpId;
-		// Fill in the ID
-		assert_r(io.write(newOpId));
-		// Now buffer holds the complete entry
+			WAL::OpID blockFirstOpId = 0;
+			BlockItemCountType completionCountInBlock = 0;
+			assert_and_return_r(blockBufferIo.read(blockFirstOpId, blockSize - BlockFooterSize), {});
+			assert_and_return_r(blockBufferIo.read(completionCountInBlock) && completionCountInBlock <= BlockEntriesCapacity / CompletionMarkerSize, {});
 
-		assert_debug_only(newOpId > _lastBlockOpId);
-		assert_debug_only(_lastBlockOpId >= _lastFlushedOpId);
+			BlockItemCountType itemCountInBlock = 0;
+			assert_and_return_r(blockBufferIo.read(itemCountInBlock, BlockItemCountOffset), {});
+			assert_and_return_r((itemCountInBlock > 0 || completionCountInBlock > 0) && itemCountInBlock <= MaxItemCount, {});
 
-		TRACE("Thread %ld\tregisterOperation: \tcurrentOpId=%d, first=%d, blockSize=%ld,t=%lu\n", get_tid(), newOpId, (int)firstWriter, _blockItemCount.load(), timeElapsedMs());
+			for (size_t i = 0; i < itemCountInBlock; ++i)
+			{
+				const auto entryStartPos = blockBufferIo.pos();
+				const auto entry = readEntryHeader(blockBufferIo, blockFirstOpId + static_cast<WAL::OpID>(i));
+				assert_and_return_r(entry && entry->opId != 0, {});
 
-		if (newBlockRequiredForData(entrySize)) // Not enough space left
-		{
-			if (firstWriter) [[unlikely]]
-				fatalAbort("Not enough space in the block!"); // TODO: handle the case of data being larger than one block can fit
+				assert_and_return_r(entryHandler(blockBufferIo, *entry, blockFilePos + entryStartPos), {});
+				// The handler may or may not have read the entry
+				assert_and_return_r(blockBufferIo.seek(entryStartPos + entry->entrySize), {});
+			}
 
-			assert_and_return_r(finalizeAndflushCurrentBlock(), {});
+			// Every operation precedes its completion marker, even when both are in the same block
+			for (size_t i = 0; i < completionCountInBlock; ++i)
+			{
+				CompletionDeltaType delta = 0;
+				uint8_t status = VoidCompletionStatus;
+				assert_and_return_r(blockBufferIo.read(delta, completionMarkerOffset(blockSize, i)) && blockBufferIo.read(status), {});
+				if (status == VoidCompletionStatus)
+					continue;
+
+				const WAL::OpID operationId = blockFirstOpId + static_cast<WAL::OpID>(delta);
+				assert_and_return_r(completionHandler(operationId), {});
+			}
 		}
 
-		firstWriter = blockIsEmpty();
-		timeStamp = firstWriter ? timeElapsedMs() : 0;
+		// Not even one whole block in the chunk, or a block with an impossible size: the data ends here
+		if (chunkDataSize == 0 || !blockSizeValid)
+			return invalidBlockFound(chunkFilePos + chunkDataSize);
+
+		assert_and_return_r(chunkHandler(), {});
+		chunkFilePos += chunkDataSize;
+	}
 
-		_lastBlockOpId = newOpId;
+	return chunkFilePos;
+}
 
-		assert_and_return_r(_block.write(entryBuffer.data(), entrySize), {});
-		++_blockItemCount;
-		assert_debug_only(_blockItemCount <= MaxItemCount);
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::LogContents DbWAL<Record, StorageAdapter, BlockSizeBytes>::logContents() noexcept
+{
+	assert_debug_only(_mtxLogFile.locked_by_caller());
 
-		_pendingOperations.push_back(newOpId);
-		++_operationsProcessed;
+	LogContents contents;
+	if (!segmentedLog())
+	{
+		contents.extents.push_back(LogExtent{ .beginPos = 0, .endPos = _logFile.size() });
+		return contents;
 	}
 
-	/*//////////////////////////////////////////////////////////////////////////////////////////////////////
-				 Waiting for another thread to flush the block and handling the timeout
-	//////////////////////////////////////////////////////////////////////////////////////////////////////*/
+	const uint64_t segmentSize = uint64_t{ _options.segmentBlocks } * BlockSize;
+	std::vector<std::pair<SegmentHeader, size_t /* slot */>> segments;
+	for (size_t slot = 0, n = static_cast<size_t>(_logFile.size() / segmentSize); slot < n; ++slot)
+	{
+		if (const auto header = readSegmentHeader(slot))
+			segments.emplace_back(*header, slot);
+	}
 
-	waitForFlushAndHandleTimeout(newOpId, firstWriter, timeStamp);
+	std::sort(begin_to_end(segments), [](const auto& l, const auto& r) {
+		return l.first.seq < r.first.seq;
+	});
 
-	// Buffer flushed - return
-	return newOpId;
+	for (const auto& [header, slot] : segments)
+	{
+		contents.extents.push_back(LogExtent{
+			.beginPos = segmentFilePos(slot) + BlockSize,
+			.endPos = segmentFilePos(slot) + segmentSize,
+			.checksumSalt = segmentChecksumSalt(header.seq),
+			.endsAtInvalidBlock = true
+		});
+	}
+
+	if (!segments.empty())
+		contents.checkpointOpId = segments.back().first.checkpointOpId;
+
+	return contents;
 }
 
-template<RecordType Record, class StorageAdapter>
-bool DbWAL<Record, StorageAdapter>::updateOpStatus(const WAL::OpID opId, const WAL::OpStatus status) noexcept
+
+
+// Registers the new operation and returns its unique ID. Empty optional = failure to register.
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+[[nodiscard]] std::optional<WAL::OpID>
+DbWAL<Record, StorageAdapter, BlockSizeBytes>::registerOperation(OpType&& op) noexcept
 {
-	io::StaticBufferAdapter<BlockSize> entryBuffer;
+	const uint64_t startTimeStamp = latencyStatsTimeStamp();
+	const auto appended = appendOperation(std::forward<OpType>(op));
+	assert_and_return_r(appended, {});
 
-	// Reserving space for the entry size field
-	entryBuffer.reserve(sizeof(EntrySizeType));
+	/*//////////////////////////////////////////////////////////////////////////////////////////////////////
+				 Waiting for another thread to flush the block and handling the timeout
+	//////////////////////////////////////////////////////////////////////////////////////////////////////*/
 
-	StorageIO bufferIo{ entryBuffer };
-	assert_and_return_r(bufferIo.seek(sizeof(EntrySizeType)), false);
-	assert_and_return_r(bufferIo.write(opId), false);
+	const uint64_t waitStartTimeStamp = latencyStatsTimeStamp();
+	waitForFlushAndHandleTimeout(appended->blockSeq, appended->firstInBlock, appended->timeStamp);
+	recordLatency(startTimeStamp, waitStartTimeStamp);
 
-	const WAL::OperationCompletedMarker completionMarker{ .status = status };
-	assert_and_return_r(Serializer::serialize(completionMarker, bufferIo), false);
-	const auto entrySize = entryBuffer.size();
-	assert_debug_only(entrySize <= std::numeric_limits<EntrySizeType>::max());
-	assert_debug_only(entrySize >= MinItemSize);
-	// Fill in the size
-	assert_and_return_r(bufferIo.write(static_cast<EntrySizeType>(entrySize), /* pos */ 0), false);
+	// Buffer flushed - return
+	return appended->opId;
+}
 
-	bool firstWriter = false;
-	uint64_t timeStamp = 0;
-	WAL::OpID newOpId = 0;
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+[[nodiscard]] std::optional<WAL::OpID>
+DbWAL<Record, StorageAdapter, BlockSizeBytes>::registerOperations(const std::span<const OpType> ops) noexcept
+{
+	assert_and_return_r(!ops.empty(), {});
+	const uint64_t startTimeStamp = latencyStatsTimeStamp();
+
+	// Serializing the whole batch before touching the block, each entry straight into its place in the batch
+	std::vector<size_t> entrySizes;
+	entrySizes.reserve(ops.size());
+	size_t totalSize = 0;
+	for (const auto& op : ops)
+	{
+		entrySizes.push_back(entrySize(op));
+		totalSize += entrySizes.back();
+	}
 
-	// Time to lock the shared block
+	std::vector<std::byte> entries(totalSize);
+	for (size_t i = 0, offset = 0; i < ops.size(); offset += entrySizes[i++])
 	{
-		std::lock_guard lock{_mtxBlock};
+		assert_and_return_message_r(entrySizes[i] <= BlockEntriesCapacity, "Not enough space in the block!", {});
+		assert_and_return_r(serializeEntry(ops[i], std::span{ entries }.subspan(offset, entrySizes[i])), {});
+	}
 
-		// Check the validity of the request before making any changes to the WAL state!
-		const auto pendingOperationIterator = std::find(begin_to_end(_pendingOperations), opId);
-		assert_and_return_message_r(pendingOperationIterator != _pendingOperations.end(), "OpId=" + std::to_string(opId) + " hasn't been registered!", false);
+	const auto appended = appendEntries(entries, entrySizes);
+	assert_and_return_r(appended, {});
+	const WAL::OpID firstOpId = appended->opId - static_cast<WAL::OpID>(ops.size() - 1);
+	WAL::StatsCounters::add(_stats.local().operationCount, ops.size());
 
-		newOpId = ++_lastOpId;
-		assert_debug_only(newOpId > _lastBlockOpId);
-		assert_debug_only(_lastBlockOpId >= _lastFlushedOpId);
+	if (!flusherThreadMode() && hasSealedBlocks())
+		assert_and_return_r(writeSealedBlocks(), {});
 
-		TRACE("Thread %ld\tregisterOperation: \tcurrentOpId=%d, first=%d, blockSize=%ld, t=%lu\n", get_tid(), newOpId, (int)firstWriter, _blockItemCount.load(), timeElapsedMs());
+	// The blocks are written in order, so the whole batch is durable once its last block is
+	const uint64_t waitStartTimeStamp = latencyStatsTimeStamp();
+	waitForFlushAndHandleTimeout(appended->blockSeq, appended->firstInBlock, appended->timeStamp);
+	recordLatency(startTimeStamp, waitStartTimeStamp);
+	return firstOpId;
+}
 
-		if (newBlockRequiredForData(entrySize)) // Not enough space left
-		{
-			if (firstWriter) [[unlikely]]
-				fatalAbort("Not enough space in the block!");
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+[[nodiscard]] std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::FlushTicket>
+DbWAL<Record, StorageAdapter, BlockSizeBytes>::registerOperationAsync(OpType&& op) noexcept
+{
+	// In the inline mode, the first writer of the block is responsible for the timeout, and it's not going to wait
+	assert_and_return_message_r(flusherThreadMode(), "Asynchronous registration requires the flusher thread mode", {});
 
-			assert_and_return_r(finalizeAndflushCurrentBlock(), false);
-		}
+	const auto appended = appendOperation(std::forward<OpType>(op));
+	assert_and_return_r(appended, {});
 
-		firstWriter = blockIsEmpty();
-		timeStamp = firstWriter ? timeElapsedMs() : 0;
+	return FlushTicket{ *this, appended->opId, appended->blockSeq };
+}
 
-		StorageIO blockIo{ _block };
-		assert_and_return_r(blockIo.write(entryBuffer.data(), entrySize), false);
-		++_blockItemCount;
-		assert_debug_only(_blockItemCount <= MaxItemCount);
-		_lastBlockOpId = newOpId;
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+size_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::entrySize(const OpType& op) noexcept
+{
+	const size_t payloadSize = Serializer::serializedSize(op);
+	if constexpr (CompactEntries)
+	{
+		// The size includes its own varint
+		const size_t size = EntryOpIdSize<OpType> + payloadSize;
+		return compact::varintSize(size + compact::varintSize(size)) + size;
+	}
+	else
+		return sizeof(EntrySizeType) + sizeof(WAL::OpID) + payloadSize;
+}
 
-		_pendingOperations.erase(pendingOperationIterator);
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::serializeEntry(const OpType& op, const std::span<std::byte> entry) noexcept
+{
+	assert_debug_only(entry.size() <= std::numeric_limits<EntrySizeType>::max());
+	assert_debug_only(entry.size() > MinItemSize);
 
-		// TODO: this requires _mtxBlock to be recursive
-		//if (_pendingOperations.empty() && _operationsProcessed > 1'000) // TODO: increase this limit for production
-		//{
-		//	// It's unlikely that there will be no pending operations when this branch is examined - this will almost never be invoked
+	io::SpanAdapter entryRegion{ entry };
+	StorageIO io{ entryRegion };
 
-		//	// No more pending operations left - safe to clear the log
-		//	// TODO: do it asynchronously
-		//	assert_and_return_r(clearLog(), false);
-		//	_operationsProcessed = 0;
-		//}
+	// The size goes first, followed by the space for the operation ID, which is only known once the entry has been placed
+	if constexpr (CompactEntries)
+	{
+		assert_and_return_r(compact::writeVarint(io, entry.size()), false);
+		// The difference from the implied OpID is 0 for the operations. The placeholder also marks how much space there is for it.
+		std::array<uint8_t, EntryOpIdSize<OpType>> opIdPlaceholder;
+		compact::encodeVarintPadded(0, opIdPlaceholder.data(), opIdPlaceholder.size());
+		assert_and_return_r(io.write(opIdPlaceholder.data(), opIdPlaceholder.size()), false);
 	}
+	else
+	{
+		assert_and_return_r(io.write(static_cast<EntrySizeType>(entry.size())), false);
+		assert_and_return_r(io.seek(sizeof(EntrySizeType) + sizeof(WAL::OpID)), false);
+	}
+	assert_and_return_r(Serializer::serialize(op, io), false);
 
-	//  Waiting for another thread to flush the block and handling the timeout
-
-	waitForFlushAndHandleTimeout(newOpId, firstWriter, timeStamp);
+	// The size has been computed by Serializer::serializedSize(), which has to agree with serialize()
+	assert_and_return_message_r(io.pos() == entry.size(), "The entry size doesn't match the serialized operation!", false);
 	return true;
 }
 
-template<RecordType Record, class StorageAdapter>
-inline constexpr void DbWAL<Record, StorageAdapter>::startNewBlock() noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::writeEntryOpId(std::byte* const entry, const WAL::OpID opId, const WAL::OpID impliedOpId) noexcept
 {
-	assert_debug_only(_mtxBlock.locked_by_caller());
-	_blockItemCount = 0;
-	_block.clear();
-	_block.reserve(sizeof(BlockItemCountType));
-	_block.seekToEnd();
+	if constexpr (CompactEntries)
+	{
+		// serializeEntry() has written 0 already
+		if (opId == impliedOpId)
+			return;
+
+		auto* const bytes = reinterpret_cast<uint8_t*>(entry);
+		uint64_t value = 0;
+		const size_t sizeLength = compact::decodeVarint(bytes, compact::MaxVarintSize<EntrySizeType>, value);
+		// As many bytes as the placeholder takes
+		const size_t opIdSize = compact::decodeVarint(bytes + sizeLength, compact::MaxVarintSize<WAL::OpID>, value);
 
-	TRACE("Thread %ld\tstartNewBlock: \tblockSize=%ld,t=%lu\n", get_tid(), _blockItemCount.load(), timeElapsedMs());
+		const auto delta = compact::zigzagEncode(static_cast<int32_t>(opId - impliedOpId));
+		if (sizeLength == 0 || opIdSize < compact::varintSize(delta)) [[unlikely]]
+			fatalAbort("WAL: no room for the OpID in the entry!");
+
+		compact::encodeVarintPadded(delta, bytes + sizeLength, opIdSize);
+	}
+	else
+		::memcpy(entry + sizeof(EntrySizeType), &opId, sizeof(WAL::OpID));
 }
 
-template<RecordType Record, class StorageAdapter>
-constexpr bool DbWAL<Record, StorageAdapter>::finalizeAndflushCurrentBlock() noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template <class IoAdapter>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::EntryHeader> DbWAL<Record, StorageAdapter, BlockSizeBytes>::readEntryHeader(StorageIO<IoAdapter>& io, const WAL::OpID impliedOpId) noexcept
 {
-	assert_debug_only(_mtxBlock.locked_by_caller());
-	assert_r(_block.size() > 0);
+	const uint64_t entryStartPos = io.pos();
 
-	_block.seek(0);
-	assert_and_return_r(_blockItemCount <= std::numeric_limits<BlockItemCountType>::max() && _blockItemCount > 0, false);
-	assert_debug_only(_blockItemCount <= MaxItemCount);
+	EntryHeader header{};
+	if constexpr (CompactEntries)
+	{
+		EntrySizeType size = 0;
+		int32_t opIdDelta = 0;
+		if (!compact::readVarint(io, size) || !compact::readVarint(io, opIdDelta))
+			return {};
 
-	StorageIO blockWriter{ _block };
-	assert_and_return_r(blockWriter.write(static_cast<BlockItemCountType>(_blockItemCount.load())), false);
-	const auto actualBlockSize = _block.size();
-	// Extend the size to full 4K
-	_block.reserve(_block.MaxCapacity);
-	assert_debug_only(_block.size() == _block.MaxCapacity);
-	::memset(_block.data() + actualBlockSize, 0, _block.MaxCapacity - actualBlockSize);
+		header.entrySize = size;
+		header.opId = impliedOpId + static_cast<WAL::OpID>(opIdDelta);
+	}
+	else
+	{
+		EntrySizeType size = 0;
+		if (!io.read(size) || !io.read(header.opId))
+			return {};
 
-	const auto hash = wheathash32(_block.data(), _block.MaxCapacity - sizeof(BlockChecksumType));
-	static_assert(std::is_same_v<decltype(hash), const BlockChecksumType>);
-	_block.seek(_block.MaxCapacity - sizeof(BlockChecksumType));
-	assert_and_return_r(blockWriter.write(hash), false);
+		header.entrySize = size;
+	}
 
-	assert_and_return_r(_logFile.seekToEnd(), false); // TODO: what for?
-	assert_and_return_r(_logFile.write(_block.data(), _block.MaxCapacity), false);
-	assert_and_return_r(_logFile.flush(), false);
+	const auto headerSize = static_cast<size_t>(io.pos() - entryStartPos);
+	if (header.entrySize <= headerSize)
+		return {};
 
-	TRACE("Thread %ld\tflushing: \t\tlastBlockOpId=%d, t=%lu\n", get_tid(), _lastBlockOpId, timeElapsedMs());
+	header.payloadSize = header.entrySize - headerSize;
+	return header;
+}
 
-	_lastFlushedOpId = _lastBlockOpId;
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template<class OpType>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::AppendedEntry>
+DbWAL<Record, StorageAdapter, BlockSizeBytes>::appendOperation(OpType&& op) noexcept
+{
+	// The size is known up front, so the entry is serialized straight into the space reserved for it in the block.
+	// Reference: https://github.com/VioletGiraffe/cpp-db/wiki/WAL
+	const size_t size = entrySize(op);
+	assert_and_return_message_r(size <= BlockEntriesCapacity, "Not enough space in the block!", {});
 
-	++totalBlockCount;
-	totalSizeWritten += actualBlockSize;
-	if (maxFill < actualBlockSize)
-		maxFill = actualBlockSize;
+	// The ID is only known once the space in the block has been reserved, it's filled in after serializing the entry
+	const auto appended = appendEntry(size, [&op](const std::span<std::byte> entry) { return serializeEntry(op, entry); });
+	assert_and_return_r(appended, {});
+	WAL::StatsCounters::add(_stats.local().operationCount, 1);
 
-	startNewBlock();
+	// Any blocks sealed by this thread are written without blocking the other writers
+	if (!flusherThreadMode() && hasSealedBlocks())
+		assert_and_return_r(writeSealedBlocks(), {});
 
-	return true;
+	return appended;
 }
 
-template<RecordType Record, class StorageAdapter>
-inline constexpr bool DbWAL<Record, StorageAdapter>::newBlockRequiredForData(size_t dataSize) noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::updateOpStatus(const WAL::OpID opId, const WAL::OpStatus status) noexcept
 {
-	assert_debug_only(_mtxBlock.locked_by_caller());
-	const auto remainingCapacity = _block.remainingCapacity() - sizeof(BlockChecksumType) - sizeof(BlockItemCountType);
-	return dataSize + MinItemSize + 20 > remainingCapacity;
+	const uint64_t startTimeStamp = _options.completionMarkers == WAL::CompletionMarkers::Durable ? latencyStatsTimeStamp() : 0;
+	{
+		std::lock_guard lock{ _mtxPendingOperations };
+
+		// Check the validity of the request before making any changes to the WAL state!
+		assert_and_return_message_r(_pendingOperations.remove(opId), "OpId=" + std::to_string(opId) + " hasn't been registered!", false);
+	}
+
+	const auto appended = appendCompletionMarker(opId, status);
+	assert_and_return_r(appended, false);
+	WAL::StatsCounters::add(_stats.local().completionMarkerCount, 1);
+
+	if (!flusherThreadMode() && hasSealedBlocks())
+		assert_and_return_r(writeSealedBlocks(), false);
+
+	if (_options.completionMarkers == WAL::CompletionMarkers::Lazy)
+		return true;
+
+	//  Waiting for another thread to flush the block and handling the timeout
+
+	const uint64_t waitStartTimeStamp = latencyStatsTimeStamp();
+	waitForFlushAndHandleTimeout(appended->blockSeq, appended->firstInBlock, appended->timeStamp);
+	recordLatency(startTimeStamp, waitStartTimeStamp);
+	return true;
 }
 
-template<RecordType Record, class StorageAdapter>
-inline constexpr bool DbWAL<Record, StorageAdapter>::blockIsEmpty() const noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+WAL::Stats DbWAL<Record, StorageAdapter, BlockSizeBytes>::stats() const noexcept
 {
-	assert_debug_only(_mtxBlock.locked_by_caller());
-	return _blockItemCount == 0;
+	auto stats = _stats.snapshot();
+	stats.flushTimeout = _adaptiveFlushTimeout.stats();
+	stats.flushTimeout.timeoutUs = flushTimeoutUs();
+	return stats;
 }
 
-template<RecordType Record, class StorageAdapter>
-void DbWAL<Record, StorageAdapter>::waitForFlushAndHandleTimeout(WAL::OpID currentOpId, const bool firstWriter, const uint64_t operationStartTimeStamp) noexcept
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::AppendedEntry> DbWAL<Record, StorageAdapter, BlockSizeBytes>::appendCompletionMarker(const WAL::OpID opId, const WAL::OpStatus status) noexcept
 {
-	/*//////////////////////////////////////////////////////////////////////////////////////////////////////
-					 Waiting for another thread to flush the block and handling the timeout
-	//////////////////////////////////////////////////////////////////////////////////////////////////////*/
-
-#ifdef ENABLE_TRACING
-	const auto tid = get_tid();
-#endif
-	TRACE("Thread %ld\twaiting: \t\tcurrentOpId=%d, first=%d, lastFlushedOpId=%d\n", tid, currentOpId, (int)firstWriter, _lastFlushedOpId.load());
+	static constexpr uint64_t reservation = uint64_t{ 1 } << CursorCompletionCountShift;
 
-	while (_lastFlushedOpId < currentOpId)
+	for (;;)
 	{
-		static constexpr uint64_t timeOut = 50; // ms
-		const uint64_t elapsed = timeElapsedMs() - operationStartTimeStamp;
-		if (firstWriter && elapsed >= timeOut)
+		// Same as for the entries, see appendEntry()
+		const uint64_t blockSeq = _currentBlockSeq;
+		Block& block = blockBySequenceNumber(blockSeq);
+
+		const CursorState before = cursorState(block.cursor.fetch_add(reservation, std::memory_order_acq_rel));
+		if (!before.closed && contentsFit(before.itemCount, before.entriesSize, before.completionCount + 1)) [[likely]]
 		{
-			std::lock_guard lck(_mtxBlock);
-			// Re-check the last flushed OP ID under lock in case another thread started flushing at the same time
-			if (_lastFlushedOpId < currentOpId)
-			{
-				TRACE("Thread %ld\ttimeout: \t\tcurrentOpId=%d, first=%d, lastFlushedOpId=%d, lastStoredOpId=%d\n", tid, currentOpId, (int)firstWriter, _lastFlushedOpId.load(), _lastBlockOpId);
-				if (!finalizeAndflushCurrentBlock()) [[unlikely]]
-					fatalAbort("WAL: flush failed!");
+			const bool firstInBlock = before.itemCount == 0 && before.completionCount == 0;
+			const AppendedEntry appended{
+				.opId = opId,
+				.blockSeq = block.seq,
+				.firstInBlock = firstInBlock,
+				.timeStamp = firstInBlock ? timeStampUs() : 0
+			};
+
+			// The marker can only be written once the block is known, so a delta that's out of range still takes the slot, but leaves it void
+			const int64_t delta = int64_t{ opId } - int64_t{ block.firstOpId };
+			const bool deltaFits = delta >= std::numeric_limits<CompletionDeltaType>::min() && delta <= std::numeric_limits<CompletionDeltaType>::max();
+			const auto compactDelta = deltaFits ? static_cast<CompletionDeltaType>(delta) : CompletionDeltaType{ 0 };
+			const auto compactStatus = deltaFits ? static_cast<uint8_t>(status) : VoidCompletionStatus;
+
+			auto* markerLocation = block.buffer.data() + completionMarkerOffset(BlockSize, before.completionCount);
+			::memcpy(markerLocation, &compactDelta, sizeof(compactDelta));
+			::memcpy(markerLocation + sizeof(compactDelta), &compactStatus, sizeof(compactStatus));
+
+			if (firstInBlock)
+				markBlockStart(block, appended.timeStamp);
+			else
+				markBlockArrival(block);
+
+			TRACE("Thread %ld\tappendCompletionMarker: \topId=%d, first=%d, blockSeq=%lu, t=%lu\n", get_tid(), opId, (int)firstInBlock, appended.blockSeq, timeElapsedMs());
+
+			publishEntry(block);
+
+			if (!deltaFits) [[unlikely]]
+				return appendCompletionMarkerEntry(opId, status);
+
+			if (flushThresholdReached(before.itemCount + before.completionCount, before.entriesSize + before.completionCount * CompletionMarkerSize, CompletionMarkerSize))
+				assert_and_return_r(closeBlock(appended.blockSeq), {});
+			else if (firstInBlock && flusherThreadMode())
+				notifyFlusherBlockStarted();
+
+			return appended;
+		}
+
+		// The first reservation that doesn't fit seals the block
+		if (!before.closed && contentsFit(before))
+		{
+			std::unique_lock lock{ _mtxBlock };
+			assert_and_return_r(sealBlock(lock, block, before), {});
+		}
+		else
+			waitForBlockRotation(blockSeq);
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::AppendedEntry> DbWAL<Record, StorageAdapter, BlockSizeBytes>::appendCompletionMarkerEntry(const WAL::OpID opId, const WAL::OpStatus status) noexcept
+{
+	const WAL::OperationCompletedMarker completionMarker{ .status = status };
+
+	// The marker entry refers to the completed operation's ID, it doesn't need one of its own to be written in
+	return appendEntry(entrySize(completionMarker), [&](const std::span<std::byte> entry) {
+		return serializeEntry(completionMarker, entry);
+	}, opId);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::Block& DbWAL<Record, StorageAdapter, BlockSizeBytes>::blockBySequenceNumber(const uint64_t blockSeq) noexcept
+{
+	return _blocks[blockSeq % BlockRingSize];
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::openBlock(const uint64_t blockSeq, const WAL::OpID firstOpId, const uint64_t initialCursor) noexcept
+{
+	Block& block = blockBySequenceNumber(blockSeq);
+	// The slot must not be accepting reservations
+	[[maybe_unused]] const CursorState cursor = cursorState(block.cursor);
+	assert_debug_only(cursor.closed || !contentsFit(cursor));
+
+	block.seq = blockSeq;
+	block.firstOpId = firstOpId;
+	block.itemCount = 0;
+	block.entriesSize = 0;
+	block.completionCount = 0;
+	block.publishState = 0;
+	block.finalized = false;
+	block.startTimeStamp = 0;
+	block.lastArrivalTimeStamp = 0;
+
+	// The entries are copied straight to their places, so the buffer spans the whole block from the start
+	block.buffer.clear();
+	block.buffer.reserve(BlockSize);
+
+	// Opening the cursor publishes all of the above to the writers
+	block.cursor.store(initialCursor, std::memory_order_release);
+
+	TRACE("Thread %ld\topenBlock: \tblockSeq=%lu, firstOpId=%d, t=%lu\n", get_tid(), blockSeq, firstOpId, timeElapsedMs());
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+template <typename EntryWriter>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::AppendedEntry> DbWAL<Record, StorageAdapter, BlockSizeBytes>::appendEntry(const size_t entrySize, EntryWriter&& writeEntry, const std::optional<WAL::OpID> referencedOpId) noexcept
+{
+	assert_debug_only(entrySize >= MinItemSize && entrySize <= BlockEntriesCapacity);
+	const uint64_t reservation = (uint64_t{ 1 } << CursorItemCountShift) | entrySize;
+
+	for (;;)
+	{
+		// The block might get sealed, or even written and reused for another block, right after reading the sequence number.
+		// This is harmless: the reservation fails in a closed block, and a successful one is made in whatever block is open in this slot.
+		const uint64_t blockSeq = _currentBlockSeq;
+		Block& block = blockBySequenceNumber(blockSeq);
+
+		const CursorState before = cursorState(block.cursor.fetch_add(reservation, std::memory_order_acq_rel));
+		const size_t entryIndex = before.itemCount;
+		const size_t entryOffset = before.entriesSize;
+
+		if (!before.closed && contentsFit(entryIndex + 1, entryOffset + entrySize, before.completionCount)) [[likely]]
+		{
+			// The block can't be written, let alone reused, until this entry is published, so its fields are stable
+			const AppendedEntry appended{
+				.opId = block.firstOpId + static_cast<WAL::OpID>(entryIndex),
+				.blockSeq = block.seq,
+				.firstInBlock = entryIndex == 0,
+				.timeStamp = entryIndex == 0 ? timeStampUs() : 0
+			};
+			assert_debug_only(entryIndex < MaxItemCount);
+
+			auto* entryLocation = block.buffer.data() + BlockHeaderSize + entryOffset;
+			// The space is reserved already, and the size has been checked, so this can only fail if the size was wrong
+			if (!writeEntry(std::span{ reinterpret_cast<std::byte*>(entryLocation), entrySize })) [[unlikely]]
+				fatalAbort("WAL: failed to compose the entry in the block!");
+			writeEntryOpId(reinterpret_cast<std::byte*>(entryLocation), referencedOpId.value_or(appended.opId), appended.opId);
+
+			if (appended.firstInBlock)
+				markBlockStart(block, appended.timeStamp);
+			else
+				markBlockArrival(block);
+
+			TRACE("Thread %ld\tappendEntry: \tcurrentOpId=%d, first=%d, blockSeq=%lu, offset=%lu, t=%lu\n", get_tid(), appended.opId, (int)appended.firstInBlock, appended.blockSeq, entryOffset, timeElapsedMs());
+
+			if (!referencedOpId)
+				addPendingOperations(appended.opId, 1);
+			publishEntry(block);
+
+			if (flushThresholdReached(entryIndex + before.completionCount, entryOffset + before.completionCount * CompletionMarkerSize, entrySize))
+				assert_and_return_r(closeBlock(appended.blockSeq), {});
+			else if (appended.firstInBlock && flusherThreadMode())
+				notifyFlusherBlockStarted();
+
+			return appended;
+		}
+
+		// Is this the first reservation that doesn't fit (there can only be one)? Then its writer seals the block.
+		if (!before.closed && contentsFit(before))
+		{
+			if (entryIndex == 0 && before.completionCount == 0) [[unlikely]]
+				fatalAbort("Not enough space in the block!"); // TODO: handle the case of data being larger than one block can fit
+
+			std::unique_lock lock{ _mtxBlock };
+			assert_and_return_r(sealBlock(lock, block, before), {});
+		}
+		else
+			waitForBlockRotation(blockSeq);
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::AppendedEntry> DbWAL<Record, StorageAdapter, BlockSizeBytes>::appendEntries(std::span<const std::byte> entries, std::span<const size_t> entrySizes) noexcept
+{
+	for (const size_t entrySize : entrySizes)
+		assert_and_return_message_r(entrySize >= MinItemSize && entrySize <= BlockEntriesCapacity, "Not enough space in the block!", {});
+
+	// How many of the entries fit into a block after its current contents, and how many bytes they take
+	const auto fittingEntries = [this, entrySizes](const CursorState& contents, const size_t firstEntry) {
+		size_t count = 0, size = 0;
+		while (firstEntry + count < entrySizes.size() && contentsFit(contents.itemCount + count + 1, contents.entriesSize + size + entrySizes[firstEntry + count], contents.completionCount))
+			size += entrySizes[firstEntry + count++];
+		return std::pair{ count, size };
+	};
+
+	const auto reservation = [](const size_t count, const size_t size) {
+		return (uint64_t{ count } << CursorItemCountShift) | size;
+	};
+
+	// Whether the last entry crosses the flush threshold of the block that remains open
+	bool flushThresholdCrossed = false;
+	const auto checkFlushThreshold = [&](const CursorState& contents, const size_t firstEntry, const size_t count) {
+		size_t sizeBefore = contents.entriesSize + contents.completionCount * CompletionMarkerSize;
+		for (size_t i = 0; i < count; sizeBefore += entrySizes[firstEntry + i++])
+			flushThresholdCrossed = flushThresholdCrossed || flushThresholdReached(contents.itemCount + contents.completionCount + i, sizeBefore, entrySizes[firstEntry + i]);
+	};
+
+	const auto startBlock = [](Block& block) {
+		const uint64_t timeStamp = timeStampUs();
+		markBlockStart(block, timeStamp);
+		return timeStamp;
+	};
+	static constexpr CursorState emptyBlock{ .itemCount = 0, .entriesSize = 0, .completionCount = 0, .closed = false };
+
+	/*//////////////////////////////////////////////////////////////////////////////////////////////////////
+					 Filling the rest of the current block with a single reservation
+	//////////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+	for (;;)
+	{
+		const uint64_t blockSeq = _currentBlockSeq;
+		Block& block = blockBySequenceNumber(blockSeq);
+
+		uint64_t cursor = block.cursor.load(std::memory_order_acquire);
+		const CursorState before = cursorState(cursor);
+		const size_t entryIndex = before.itemCount;
+		const size_t entryOffset = before.entriesSize;
+		// Closed, or a writer that didn't fit is going to seal it
+		if (before.closed || !contentsFit(before))
+		{
+			waitForBlockRotation(blockSeq);
+			continue;
+		}
+
+		const auto [count, size] = fittingEntries(before, 0);
+		const bool wholeBatchFits = count == entrySizes.size();
+		// If the batch doesn't fit, the block is closed right away, and this thread seals it and carries on into the next blocks
+		const uint64_t newCursor = (cursor + reservation(count, size)) | (wholeBatchFits ? 0 : CursorClosedFlag);
+		if (!block.cursor.compare_exchange_strong(cursor, newCursor, std::memory_order_acq_rel))
+			continue;
+
+		// The block can't be written, let alone reused, until these entries are published, so its fields are stable until then.
+		// If the batch doesn't fit, this thread is the one to seal the block, which keeps it around until then.
+		const AppendedEntry appended{
+			.opId = block.firstOpId + static_cast<WAL::OpID>(entryIndex + count - 1),
+			.blockSeq = block.seq,
+			.firstInBlock = entryIndex == 0,
+			.timeStamp = entryIndex == 0 && count > 0 ? startBlock(block) : 0
+		};
+
+		if (count > 0)
+		{
+			if (!appended.firstInBlock)
+				markBlockArrival(block);
+			copyEntries(block, entryIndex, entryOffset, entries, entrySizes.first(count));
+			addPendingOperations(block.firstOpId + static_cast<WAL::OpID>(entryIndex), count);
+			publishEntry(block, count);
+			entries = entries.subspan(size);
+		}
+
+		if (wholeBatchFits)
+		{
+			checkFlushThreshold(before, 0, count);
+
+			if (flushThresholdCrossed)
+				assert_and_return_r(closeBlock(appended.blockSeq), {});
+			else if (appended.firstInBlock && flusherThreadMode())
+				notifyFlusherBlockStarted();
+
+			return appended;
+		}
+
+		/*//////////////////////////////////////////////////////////////////////////////////////////////////////
+				 Sealing the block and reserving the next ones for the rest of the batch before opening them
+		//////////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+		std::unique_lock lock{ _mtxBlock };
+
+		Block* currentBlock = &block;
+		uint64_t timeStamp = 0;
+		CursorState contents{ .itemCount = entryIndex + count, .entriesSize = entryOffset + size, .completionCount = before.completionCount, .closed = true };
+		size_t nextEntry = count;
+		for (;;)
+		{
+			const auto [nextCount, nextSize] = fittingEntries(emptyBlock, nextEntry);
+			assert_debug_only(nextCount > 0);
+			const bool lastBlock = nextEntry + nextCount == entrySizes.size();
+
+			assert_and_return_r(sealBlock(lock, *currentBlock, contents, reservation(nextCount, nextSize) | (lastBlock ? 0 : CursorClosedFlag)), {});
+
+			currentBlock = &blockBySequenceNumber(_currentBlockSeq);
+			timeStamp = startBlock(*currentBlock);
+
+			copyEntries(*currentBlock, 0, 0, entries, entrySizes.subspan(nextEntry, nextCount));
+			addPendingOperations(currentBlock->firstOpId, nextCount);
+			publishEntry(*currentBlock, nextCount);
+			entries = entries.subspan(nextSize);
+
+			if (lastBlock)
+			{
+				checkFlushThreshold(emptyBlock, nextEntry, nextCount);
+				break;
 			}
 
-			break;
+			nextEntry += nextCount;
+			contents = CursorState{ .itemCount = nextCount, .entriesSize = nextSize, .completionCount = 0, .closed = true };
+		}
+
+		// Still holding the lock, so the block can't have been rotated out and reused
+		const AppendedEntry lastAppended{
+			.opId = currentBlock->firstOpId + static_cast<WAL::OpID>(entrySizes.size() - nextEntry - 1),
+			.blockSeq = currentBlock->seq,
+			.firstInBlock = true,
+			.timeStamp = timeStamp
+		};
+		lock.unlock();
+
+		if (flushThresholdCrossed)
+			assert_and_return_r(closeBlock(lastAppended.blockSeq), {});
+
+		return lastAppended;
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::copyEntries(Block& block, const size_t firstEntryIndex, const size_t entryOffset, std::span<const std::byte> entries, std::span<const size_t> entrySizes) noexcept
+{
+	auto* entryLocation = block.buffer.data() + BlockHeaderSize + entryOffset;
+	for (size_t i = 0; i < entrySizes.size(); ++i)
+	{
+		const size_t entrySize = entrySizes[i];
+		const WAL::OpID opId = block.firstOpId + static_cast<WAL::OpID>(firstEntryIndex + i);
+
+		::memcpy(entryLocation, entries.data(), entrySize);
+		writeEntryOpId(reinterpret_cast<std::byte*>(entryLocation), opId, opId);
+
+		entries = entries.subspan(entrySize);
+		entryLocation += entrySize;
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::publishEntry(Block& block, const uint64_t count) noexcept
+{
+	const uint64_t state = block.publishState.fetch_add(count, std::memory_order_acq_rel) + count;
+	// The counts are only valid once the sealed flag is set
+	if ((state & BlockSealedFlag) != 0 && (state & ~BlockSealedFlag) == block.itemCount + block.completionCount)
+		finalizeBlock(block);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::markBlockStart(Block& block, const uint64_t timeStamp) noexcept
+{
+	// A writer may come first to the block and still store its time stamp after the next one
+	uint64_t expected = 0;
+	block.startTimeStamp.compare_exchange_strong(expected, timeStamp, std::memory_order_relaxed);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::markBlockArrival(Block& block) const noexcept
+{
+	// Skipping the clock read when nobody needs it
+	if (_options.flushTimeoutMode == WAL::FlushTimeoutMode::Adaptive)
+		block.lastArrivalTimeStamp.store(timeStampUs(), std::memory_order_relaxed);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::finalizeBlock(Block& block) noexcept
+{
+	auto& buffer = block.buffer;
+	if ((block.itemCount == 0 && block.completionCount == 0) || block.itemCount > std::numeric_limits<BlockItemCountType>::max()) [[unlikely]]
+		fatalAbort("WAL: invalid block item count!");
+	assert_debug_only(block.itemCount <= MaxItemCount);
+	assert_debug_only(buffer.size() == buffer.MaxCapacity);
+
+	// Only the sectors in use are written, except in a segmented log, where the block has a slot of its own
+	const auto completionMarkersSize = block.completionCount * CompletionMarkerSize;
+	const auto actualBlockSize = BlockHeaderSize + block.entriesSize + completionMarkersSize + BlockFooterSize;
+	const auto writeSize = segmentedLog() ? BlockSize : (actualBlockSize + SectorSize - 1) / SectorSize * SectorSize;
+
+	// The markers were stacked from the end of the buffer, they go to the end of the block as written
+	if (writeSize < BlockSize && completionMarkersSize > 0)
+		::memmove(buffer.data() + completionMarkerOffset(writeSize, block.completionCount - 1), buffer.data() + completionMarkerOffset(BlockSize, block.completionCount - 1), completionMarkersSize);
+
+	// Zero the unused space between the entries and the completion markers
+	::memset(buffer.data() + BlockHeaderSize + block.entriesSize, 0, writeSize - actualBlockSize);
+
+	StorageIO blockWriter{ buffer };
+	buffer.seek(0);
+	assert_r(blockWriter.write(BlockFormatVersion));
+	assert_r(blockWriter.write(_options.blockChecksum));
+	assert_r(blockWriter.write(static_cast<BlockSectorCountType>(writeSize / SectorSize)));
+	assert_r(blockWriter.write(static_cast<BlockItemCountType>(block.itemCount)));
+
+	buffer.seek(writeSize - BlockFooterSize);
+	assert_r(blockWriter.write(block.firstOpId));
+	assert_r(blockWriter.write(static_cast<BlockItemCountType>(block.completionCount)));
+
+	const auto hash = blockChecksum(_options.blockChecksum, buffer.data(), writeSize - sizeof(BlockChecksumType)) ^ blockChecksumSalt(block.seq);
+	buffer.seek(writeSize - sizeof(BlockChecksumType));
+	assert_r(blockWriter.write(hash));
+	block.writeSize = writeSize;
+
+	_stats.local().blockWritten(actualBlockSize, writeSize, BlockSize);
+
+	block.finalized.store(true, std::memory_order_release);
+	block.finalized.notify_all();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::closeBlock(const uint64_t blockSeq, const SealReason reason) noexcept
+{
+	std::unique_lock lock{ _mtxBlock };
+	if (_currentBlockSeq != blockSeq)
+		return true; // Has been sealed already
+
+	Block& block = blockBySequenceNumber(blockSeq);
+	uint64_t cursor = block.cursor.load(std::memory_order_acquire);
+	do
+	{
+		// Nothing to seal, or closed already, or there's a writer that didn't fit and is going to seal the block
+		const CursorState contents = cursorState(cursor);
+		if (contents.closed || (contents.itemCount == 0 && contents.completionCount == 0) || !contentsFit(contents))
+			return true;
+	} while (!block.cursor.compare_exchange_weak(cursor, cursor | CursorClosedFlag, std::memory_order_acq_rel));
+
+	return sealBlock(lock, block, cursorState(cursor), 0, reason);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::sealBlock(std::unique_lock<checked_mutex>& lock, Block& block, const CursorState& contents, const uint64_t nextBlockCursor, const SealReason reason) noexcept
+{
+	assert_debug_only(_mtxBlock.locked_by_caller());
+	assert_debug_only(block.seq == _currentBlockSeq);
+	assert_debug_only((contents.itemCount > 0 || contents.completionCount > 0) && contents.itemCount <= MaxItemCount);
+	const size_t itemCount = contents.itemCount;
+
+	TRACE("Thread %ld\tsealing: \t\tblockSeq=%lu, items=%lu, markers=%lu, t=%lu\n", get_tid(), block.seq, itemCount, contents.completionCount, timeElapsedMs());
+
+	const uint64_t sealTimeStamp = timeStampUs();
+	block.itemCount = itemCount;
+	block.entriesSize = contents.entriesSize;
+	block.completionCount = contents.completionCount;
+	const uint64_t startTimeStamp = block.startTimeStamp.load(std::memory_order_relaxed), lastArrivalTimeStamp = block.lastArrivalTimeStamp.load(std::memory_order_relaxed);
+	_adaptiveFlushTimeout.blockSealed(itemCount + contents.completionCount, contents.entriesSize + contents.completionCount * CompletionMarkerSize, sealTimeStamp, reason == SealReason::Timeout,
+		startTimeStamp != 0 && lastArrivalTimeStamp > startTimeStamp ? lastArrivalTimeStamp - startTimeStamp : 0);
+
+	auto& stats = _stats.local();
+	WAL::StatsCounters::add(reason == SealReason::Full ? stats.fullBlockCount : (reason == SealReason::Timeout ? stats.timeoutBlockCount : stats.closeBlockCount), 1);
+	// Whoever brings the published count to the final value finalizes the block: either this thread or the last writer still copying its entry
+	const uint64_t state = block.publishState.fetch_add(BlockSealedFlag, std::memory_order_acq_rel) + BlockSealedFlag;
+	if ((state & ~BlockSealedFlag) == itemCount + contents.completionCount)
+		finalizeBlock(block);
+
+	// All the slots are occupied by blocks waiting for the disk
+	while (ringIsFull())
+	{
+		if (!flusherThreadMode() || std::this_thread::get_id() == _flusherThread.get_id())
+			assert_and_return_r(writeSealedBlocks(), false);
+		else
+		{
+			_flusherCv.notify_one();
+			_blockSpaceCv.wait(lock);
+		}
+	}
+
+	const uint64_t nextBlockSeq = block.seq + 1;
+	openBlock(nextBlockSeq, block.firstOpId + static_cast<WAL::OpID>(itemCount), nextBlockCursor);
+	_currentBlockSeq = nextBlockSeq;
+	// Not counting the time the lock was taken before, nor the waits for a ring slot, during which it's released
+	stats.blockLockHoldTimeUs.record(timeStampUs() - sealTimeStamp);
+
+	if (flusherThreadMode())
+		_flusherCv.notify_one();
+	_blockRotatedCv.notify_all();
+
+	return true;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::waitForBlockRotation(const uint64_t blockSeq) noexcept
+{
+	std::unique_lock lock{ _mtxBlock };
+	_blockRotatedCv.wait(lock, [&] { return _currentBlockSeq != blockSeq; });
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::writeSealedBlocks() noexcept
+{
+	std::lock_guard fileLock(_mtxLogFile);
+
+	// More blocks may get sealed while a group is being written, they make up the next group
+	while (hasSealedBlocks())
+	{
+		const uint64_t firstBlockSeq = _flushedBlockSeq;
+		const uint64_t endBlockSeq = _currentBlockSeq;
+		assert_debug_only(endBlockSeq - firstBlockSeq < BlockRingSize);
+
+		std::array<io::ConstBuffer, BlockRingSize> blockBuffers;
+		const size_t nBlocks = static_cast<size_t>(endBlockSeq - firstBlockSeq);
+		for (size_t i = 0; i < nBlocks; ++i)
+		{
+			Block& block = blockBySequenceNumber(firstBlockSeq + i);
+			// Some writers may still be copying their entries into the block
+			block.finalized.wait(false, std::memory_order_acquire);
+			blockBuffers[i] = io::ConstBuffer{ .data = block.buffer.data(), .size = block.writeSize };
+		}
+
+		const uint64_t writeStartTimeStamp = timeStampUs();
+		assert_and_return_r(writeBlocks(std::span{ blockBuffers }.first(nBlocks), firstBlockSeq), false);
+		const uint64_t writeTimeUs = timeStampUs() - writeStartTimeStamp;
+		_adaptiveFlushTimeout.flushed(writeTimeUs);
+
+		TRACE("Thread %ld\tflushing: \t\tblockSeq=%lu, nBlocks=%lu, t=%lu\n", get_tid(), firstBlockSeq, nBlocks, timeElapsedMs());
+
+		auto& stats = _stats.local();
+		WAL::StatsCounters::add(stats.groupCommitCount, 1);
+		WAL::StatsCounters::updateMax(stats.maxBlocksPerGroupCommit, nBlocks);
+		stats.groupCommitTimeUs.record(writeTimeUs);
+
+		for (uint64_t blockSeq = firstBlockSeq; blockSeq < endBlockSeq; ++blockSeq)
+		{
+			Block& block = blockBySequenceNumber(blockSeq);
+			_lastFlushedOpId = block.lastOpId();
+			// The slot can be reused from this point on
+			_flushedBlockSeq = blockSeq + 1;
+			notifyFlushed(block);
+		}
+	}
+
+	return true;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::writeBlocks(std::span<const io::ConstBuffer> blocks, uint64_t firstBlockSeq) noexcept
+{
+	assert_debug_only(_mtxLogFile.locked_by_caller());
+
+	// With a sync per commit, the last write goes along with the sync: the adapters that can submit both at once (io_uring) do
+	const auto write = [this](const std::span<const io::ConstBuffer> buffers, const bool last) {
+		return last && _syncPerCommit ? _logFile.writeVectoredAndSync(buffers) : _logFile.writeVectored(buffers);
+	};
+
+	if (!segmentedLog())
+	{
+		assert_and_return_r(_logFile.seek(_logEnd), false);
+		assert_and_return_r(write(blocks, true), false);
+		for (const auto& block : blocks)
+			_logEnd += block.size;
+		blocks = {};
+	}
+
+	// Segmented log: the blocks are split at the segment boundaries. A new segment is written together with its header.
+	while (!blocks.empty())
+	{
+		const size_t indexInSegment = static_cast<size_t>((firstBlockSeq - _segmentBaseBlockSeq) % dataBlocksPerSegment());
+		const size_t count = std::min(blocks.size(), dataBlocksPerSegment() - indexInSegment);
+
+		std::array<io::ConstBuffer, BlockRingSize + 1> buffers;
+		size_t nBuffers = 0;
+
+		io::StaticBufferAdapter<BlockSize> headerBuffer;
+		if (indexInSegment == 0)
+		{
+			assert_and_return_r(startSegment(blockBySequenceNumber(firstBlockSeq), headerBuffer), false);
+			buffers[nBuffers++] = io::ConstBuffer{ .data = headerBuffer.data(), .size = BlockSize };
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			buffers[nBuffers++] = blocks[i];
+
+		const uint64_t writePos = segmentFilePos(_currentSegment) + (indexInSegment == 0 ? 0 : (1 + indexInSegment) * BlockSize);
+		assert_and_return_r(_logFile.seek(writePos), false);
+		assert_and_return_r(write(std::span{ buffers }.first(nBuffers), count == blocks.size()), false);
+
+		_segments[_currentSegment].lastOpId = blockBySequenceNumber(firstBlockSeq + count - 1).lastOpId();
+
+		blocks = blocks.subspan(count);
+		firstBlockSeq += count;
+	}
+
+	return _logFile.flush();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::segmentedLog() const noexcept
+{
+	return _options.segmentBlocks != 0;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr size_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::dataBlocksPerSegment() const noexcept
+{
+	return _options.segmentBlocks - 1;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr uint64_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::segmentFilePos(const size_t slot) const noexcept
+{
+	return uint64_t{ slot } * _options.segmentBlocks * BlockSize;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr uint64_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::segmentSeqForBlock(const uint64_t blockSeq) const noexcept
+{
+	// Every block is written exactly once, in order, and each segment takes the same number of them
+	return _firstSegmentSeq + (blockSeq - _segmentBaseBlockSeq) / dataBlocksPerSegment();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr uint32_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::segmentChecksumSalt(const uint64_t segmentSeq) noexcept
+{
+	// Consecutive sequence numbers have to give very different salts
+	return static_cast<uint32_t>((segmentSeq * 0x9E37'79B9'7F4A'7C15ull) >> 32);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr uint32_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::blockChecksumSalt(const uint64_t blockSeq) const noexcept
+{
+	return segmentedLog() ? segmentChecksumSalt(segmentSeqForBlock(blockSeq)) : 0;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+size_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::blockSizeFromHeader(const std::byte* header) noexcept
+{
+	if (memory_cast<uint8_t>(header) != BlockFormatVersion)
+		return 0;
+
+	const auto algorithm = memory_cast<WAL::BlockChecksum>(header + sizeof(BlockFormatVersion));
+	if (algorithm != WAL::BlockChecksum::Crc32c && algorithm != WAL::BlockChecksum::WheatHash)
+		return 0;
+
+	const size_t blockSize = size_t{ memory_cast<BlockSectorCountType>(header + BlockSectorCountOffset) } * SectorSize;
+	return blockSize <= BlockSize ? blockSize : 0;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::BlockChecksumType DbWAL<Record, StorageAdapter, BlockSizeBytes>::blockChecksum(const WAL::BlockChecksum algorithm, const std::byte* data, const size_t size) noexcept
+{
+	static_assert(std::is_same_v<BlockChecksumType, decltype(crc32c(nullptr, 0))>);
+	return algorithm == WAL::BlockChecksum::Crc32c ? crc32c(data, size) : wheathash32(data, size);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::openSegments() noexcept
+{
+	assert_debug_only(_mtxLogFile.locked_by_caller());
+	assert_and_return_message_r(_options.segmentBlocks >= 2, "A segment needs the header and at least one data block!", false);
+	assert_and_return_r(_options.segmentCount > 0, false);
+
+	const uint64_t segmentSize = uint64_t{ _options.segmentBlocks } * BlockSize;
+	const auto existingSegmentCount = static_cast<size_t>(_logFile.size() / segmentSize);
+	_segments.assign(std::max<size_t>(existingSegmentCount, _options.segmentCount), Segment{});
+	_currentSegment = 0;
+
+	std::optional<SegmentHeader> newestHeader;
+	size_t newestSlot = 0;
+	for (size_t slot = 0; slot < existingSegmentCount; ++slot)
+	{
+		const auto header = readSegmentHeader(slot);
+		if (!header)
+			continue;
+
+		// Left over from the previous session. Its pending operations are only taken care of once verifyLog() has reported them.
+		_segments[slot] = Segment{ .seq = header->seq, .lastOpId = std::numeric_limits<WAL::OpID>::max() };
+		if (!newestHeader || header->seq > newestHeader->seq)
+		{
+			newestHeader = header;
+			newestSlot = slot;
+		}
+	}
+
+	assert_and_return_r(_logFile.preallocate(_segments.size() * segmentSize), false);
+	assert_and_return_r(_logFile.seek(0), false);
+
+	// The segment numbering of this session starts from the current block
+	_segmentBaseBlockSeq = _currentBlockSeq;
+	if (!newestHeader)
+	{
+		_firstSegmentSeq = 1;
+		_checkpointFloor = std::numeric_limits<WAL::OpID>::max();
+		return true;
+	}
+
+	_firstSegmentSeq = newestHeader->seq + 1;
+	_checkpointFloor = newestHeader->checkpointOpId;
+
+	// The new IDs must be above any ID in the log, and the newest segment holds the newest operations.
+	// The segment may only hold the completion markers, the IDs then continue from its first block.
+	uint64_t nextOpId = newestHeader->firstOpId;
+	const LogExtent newestSegment{
+		.beginPos = segmentFilePos(newestSlot) + BlockSize,
+		.endPos = segmentFilePos(newestSlot) + segmentSize,
+		.checksumSalt = segmentChecksumSalt(newestHeader->seq),
+		.endsAtInvalidBlock = true
+	};
+
+	WorkerPool workers{ 1 };
+	const auto segmentDataEnd = forEachLogEntry(workers, newestSegment, [&](auto& /*entryIo*/, const EntryHeader& entry, uint64_t /*entryFilePos*/) {
+		nextOpId = std::max(nextOpId, uint64_t{ entry.opId } + 1);
+		return true;
+	}, [](WAL::OpID) { return true; }, [] { return true; });
+	assert_and_return_r(segmentDataEnd, false);
+	assert_and_return_message_r(nextOpId <= std::numeric_limits<WAL::OpID>::max(), "The WAL has run out of operation IDs!", false);
+
+	const auto firstOpId = static_cast<WAL::OpID>(nextOpId);
+	Block& block = blockBySequenceNumber(_currentBlockSeq);
+	if (firstOpId > block.firstOpId)
+	{
+		// The block is empty, and no one is writing yet
+		block.cursor = CursorClosedFlag;
+		openBlock(_currentBlockSeq, firstOpId);
+	}
+
+	return true;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+std::optional<typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::SegmentHeader> DbWAL<Record, StorageAdapter, BlockSizeBytes>::readSegmentHeader(const size_t slot) noexcept
+{
+	assert_debug_only(_mtxLogFile.locked_by_caller());
+
+	io::StaticBufferAdapter<BlockSize> headerBuffer;
+	headerBuffer.reserve(BlockSize);
+	assert_and_return_r(_logFile.seek(segmentFilePos(slot)), {});
+	assert_and_return_r(_logFile.read(headerBuffer.data(), BlockSize), {});
+
+	// Not an error: the slot has never been used, or the header write has been torn
+	const auto checksum = memory_cast<BlockChecksumType>(headerBuffer.data() + BlockSize - sizeof(BlockChecksumType));
+	if (checksum != wheathash32(headerBuffer.data(), BlockSize - sizeof(BlockChecksumType)))
+		return {};
+
+	StorageIO headerIo{ headerBuffer };
+	uint32_t magic = 0, segmentBlocks = 0;
+	SegmentHeader header;
+	assert_and_return_r(headerIo.read(magic) && headerIo.read(segmentBlocks), {});
+	assert_and_return_r(headerIo.read(header.seq) && headerIo.read(header.firstOpId) && headerIo.read(header.checkpointOpId), {});
+
+	assert_and_return_message_r(magic == SegmentHeaderMagic && header.seq != 0, "Invalid WAL segment header!", {});
+	assert_and_return_message_r(segmentBlocks == _options.segmentBlocks, "The WAL has been created with a different segment size!", {});
+	return header;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::startSegment(const Block& firstBlock, io::StaticBufferAdapter<BlockSize>& headerBuffer) noexcept
+{
+	assert_debug_only(_mtxLogFile.locked_by_caller());
+
+	// The operations that are still being registered, and so aren't pending yet, can't be in the blocks that have been written
+	const WAL::OpID checkpointOpId = std::min({ _checkpointFloor, oldestPendingOperation(), firstBlock.firstOpId });
+
+	// Overwriting the oldest segment whose operations have all completed, or growing the ring if there is none
+	size_t slot = _segments.size();
+	for (size_t i = 0; i < _segments.size(); ++i)
+	{
+		if (_segments[i].lastOpId < checkpointOpId && (slot == _segments.size() || _segments[i].seq < _segments[slot].seq))
+			slot = i;
+	}
+
+	if (slot == _segments.size())
+	{
+		_segments.emplace_back();
+		assert_and_return_r(_logFile.preallocate(_segments.size() * uint64_t{ _options.segmentBlocks } * BlockSize), false);
+	}
+
+	const SegmentHeader header{ .seq = segmentSeqForBlock(firstBlock.seq), .firstOpId = firstBlock.firstOpId, .checkpointOpId = checkpointOpId };
+	_segments[slot] = Segment{ .seq = header.seq, .lastOpId = 0 };
+	_currentSegment = slot;
+
+	headerBuffer.clear();
+	StorageIO headerIo{ headerBuffer };
+	assert_and_return_r(headerIo.write(SegmentHeaderMagic) && headerIo.write(_options.segmentBlocks), false);
+	assert_and_return_r(headerIo.write(header.seq) && headerIo.write(header.firstOpId) && headerIo.write(header.checkpointOpId), false);
+
+	const auto headerSize = headerBuffer.size();
+	headerBuffer.reserve(BlockSize);
+	::memset(headerBuffer.data() + headerSize, 0, BlockSize - headerSize);
+
+	const auto checksum = wheathash32(headerBuffer.data(), BlockSize - sizeof(BlockChecksumType));
+	assert_and_return_r(headerIo.write(checksum, BlockSize - sizeof(BlockChecksumType)), false);
+	return true;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::addPendingOperations(const WAL::OpID firstOpId, const size_t count) noexcept
+{
+	std::lock_guard lock{ _mtxPendingOperations };
+	for (size_t i = 0; i < count; ++i)
+		_pendingOperations.insert(firstOpId + static_cast<WAL::OpID>(i));
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+WAL::OpID DbWAL<Record, StorageAdapter, BlockSizeBytes>::oldestPendingOperation() noexcept
+{
+	std::lock_guard lock{ _mtxPendingOperations };
+	return _pendingOperations.oldest().value_or(std::numeric_limits<WAL::OpID>::max());
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::currentBlockIsEmpty() const noexcept
+{
+	const CursorState contents = cursorState(_blocks[_currentBlockSeq % BlockRingSize].cursor);
+	return contents.itemCount == 0 && contents.completionCount == 0;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::hasSealedBlocks() const noexcept
+{
+	return _flushedBlockSeq < _currentBlockSeq;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::ringIsFull() const noexcept
+{
+	assert_debug_only(_mtxBlock.locked_by_caller());
+	// The current block occupies one slot, the rest are taken by the sealed ones
+	return _currentBlockSeq - _flushedBlockSeq >= BlockRingSize - 1;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr typename DbWAL<Record, StorageAdapter, BlockSizeBytes>::CursorState DbWAL<Record, StorageAdapter, BlockSizeBytes>::cursorState(const uint64_t cursor) noexcept
+{
+	return CursorState{
+		.itemCount = static_cast<size_t>((cursor >> CursorItemCountShift) & CursorItemCountMask),
+		.entriesSize = static_cast<size_t>(cursor & CursorBytesMask),
+		.completionCount = static_cast<size_t>((cursor >> CursorCompletionCountShift) & CursorCompletionCountMask),
+		.closed = (cursor & CursorClosedFlag) != 0
+	};
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::contentsFit(const size_t itemCount, const size_t entriesSize, const size_t completionCount) const noexcept
+{
+	// The completion markers count towards the op threshold, same as the operations
+	return entriesSize + completionCount * CompletionMarkerSize <= BlockEntriesCapacity
+		&& (_options.flushThresholdOps == 0 || itemCount + completionCount <= _options.flushThresholdOps);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::contentsFit(const CursorState& contents) const noexcept
+{
+	return contentsFit(contents.itemCount, contents.entriesSize, contents.completionCount);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::flushThresholdReached(const size_t countBefore, const size_t sizeBefore, const size_t size) const noexcept
+{
+	const size_t blockSizeBefore = BlockHeaderSize + sizeBefore;
+	return (_options.flushThresholdOps > 0 && countBefore + 1 == _options.flushThresholdOps)
+		|| (_options.flushThresholdBytes > 0 && (countBefore == 0 || blockSizeBefore < _options.flushThresholdBytes) && blockSizeBefore + size >= _options.flushThresholdBytes);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr size_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::completionMarkerOffset(const size_t blockSize, const size_t index) noexcept
+{
+	// The markers are stacked from the fixed part of the footer towards the entries
+	return blockSize - BlockFooterSize - (index + 1) * CompletionMarkerSize;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline constexpr bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::flusherThreadMode() const noexcept
+{
+	return _options.flushMode == WAL::FlushMode::FlusherThread;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline uint64_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::flushTimeoutUs() const noexcept
+{
+	return _options.flushTimeoutMode == WAL::FlushTimeoutMode::Adaptive ? _adaptiveFlushTimeout.timeoutUs() : uint64_t{ _options.flushTimeoutMs } * 1000;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline uint64_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::timeStampUs() noexcept
+{
+	// Never 0, which stands for no time stamp
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) + 1;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+inline uint64_t DbWAL<Record, StorageAdapter, BlockSizeBytes>::latencyStatsTimeStamp() const noexcept
+{
+	return _options.latencyStats ? timeStampUs() : 0;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::recordLatency(const uint64_t startTimeStamp, const uint64_t waitStartTimeStamp) noexcept
+{
+	if (startTimeStamp == 0)
+		return;
+
+	const uint64_t endTimeStamp = timeStampUs();
+	auto& stats = _stats.local();
+	stats.commitLatencyUs.record(endTimeStamp - startTimeStamp);
+	stats.flushWaitTimeUs.record(endTimeStamp - waitStartTimeStamp);
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::waitForFlushAndHandleTimeout(const uint64_t blockSeq, const bool firstWriter, const uint64_t operationStartTimeStamp) noexcept
+{
+	// The flusher thread handles the timeout itself, nobody else is allowed to write to the log
+	const bool handleTimeout = firstWriter && !flusherThreadMode();
+
+	// The ring slot is reused for other blocks, but the flush counter only grows, so the condition remains satisfied once met
+	Block& block = blockBySequenceNumber(blockSeq);
+	const uint64_t targetFlushCount = blockSeq / BlockRingSize + 1;
+	const auto blockFlushed = [&] {
+		return block.flushCount >= targetFlushCount;
+	};
+	const auto parkUntilFlushed = [&] {
+		for (auto flushCount = block.flushCount.load(); flushCount < targetFlushCount; flushCount = block.flushCount.load())
+			block.flushCount.wait(flushCount);
+	};
+
+	/*//////////////////////////////////////////////////////////////////////////////////////////////////////
+					 Waiting for another thread to flush the block and handling the timeout
+	//////////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#ifdef ENABLE_TRACING
+	const auto tid = get_tid();
+#endif
+	TRACE("Thread %ld\twaiting: \t\tblockSeq=%lu, first=%d, lastFlushedOpId=%d\n", tid, blockSeq, (int)firstWriter, _lastFlushedOpId.load());
+
+	if (_options.flushWaitMode == WAL::FlushWaitMode::Spin)
+	{
+		while (!blockFlushed())
+		{
+			const uint64_t elapsed = timeStampUs() - operationStartTimeStamp;
+			if (handleTimeout && elapsed >= flushTimeoutUs())
+				break;
+
+			// Keep spinning until either another thread finishes the job or timeout occurs
+			std::this_thread::yield();
 		}
+	}
+	else if (!handleTimeout)
+	{
+		// Sleep until our own block has been written. Writing the other blocks doesn't touch this counter.
+		parkUntilFlushed();
+	}
+	else
+	{
+		const uint64_t elapsed = timeStampUs() - operationStartTimeStamp;
+		const uint64_t timeout = flushTimeoutUs();
+		const auto remaining = std::chrono::microseconds{ elapsed < timeout ? static_cast<int64_t>(timeout - elapsed) : 0 };
 
-		// Keep spinning until either another thread finishes the job or timeout occurs
-		std::this_thread::yield();
+		std::unique_lock lock{ _mtxFlushTimer };
+		_flushTimerCv.wait_for(lock, remaining, blockFlushed);
 	}
 
-	TRACE("Thread %ld\tdone: \t\t\tcurrentOpId=%d, first=%d, lastFlushedOpId=%d, t=%lu\n", tid, currentOpId, (int)firstWriter, _lastFlushedOpId.load(), timeElapsedMs());
+	if (handleTimeout && !blockFlushed())
+	{
+		TRACE("Thread %ld\ttimeout: \t\tblockSeq=%lu, first=%d, lastFlushedOpId=%d\n", tid, blockSeq, (int)firstWriter, _lastFlushedOpId.load());
+
+		// No-op if another thread has sealed the block at the same time
+		if (!closeBlock(blockSeq, SealReason::Timeout)) [[unlikely]]
+			fatalAbort("WAL: failed to seal the block!");
+
+		// Either writes the block or waits for the thread that's already writing it
+		if (!writeSealedBlocks()) [[unlikely]]
+			fatalAbort("WAL: flush failed!");
+
+		// If a writer that didn't fit into the block is about to seal it, that writer also writes it out
+		parkUntilFlushed();
+	}
+
+	TRACE("Thread %ld\tdone: \t\t\tblockSeq=%lu, first=%d, lastFlushedOpId=%d, t=%lu\n", tid, blockSeq, (int)firstWriter, _lastFlushedOpId.load(), timeElapsedMs());
 	// Done waiting - return
 }
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::notifyFlushed(Block& block) noexcept
+{
+	++block.flushCount;
+	block.flushCount.notify_all();
+
+	// Taking the mutex guarantees the timeout handler is either already waiting or hasn't checked the predicate yet, so the notification cannot be lost
+	{
+		std::lock_guard lock{ _mtxFlushTimer };
+	}
+	_flushTimerCv.notify_all();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::addFlushContinuation(const WAL::OpID opId, std::function<void()>& continuation) noexcept
+{
+	// _lastFlushedOpId is updated before notifyFlushContinuations() takes the mutex, so the completion thread can't miss the continuation
+	std::lock_guard lock{ _mtxFlushContinuations };
+	if (_lastFlushedOpId >= opId)
+		return false;
+
+	_flushContinuations.push_back(FlushContinuation{ .opId = opId, .continuation = std::move(continuation) });
+	return true;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::notifyFlushContinuations() noexcept
+{
+	{
+		std::lock_guard lock{ _mtxFlushContinuations };
+		if (!hasReadyFlushContinuations())
+			return;
+	}
+	_flushContinuationsCv.notify_one();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+bool DbWAL<Record, StorageAdapter, BlockSizeBytes>::hasReadyFlushContinuations() const noexcept
+{
+	const WAL::OpID lastFlushedOpId = _lastFlushedOpId;
+	return std::any_of(begin_to_end(_flushContinuations), [lastFlushedOpId](const FlushContinuation& item) {
+		return item.opId <= lastFlushedOpId;
+	});
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::startCompletionThread() noexcept
+{
+	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
+	assert_r(!_completionThread.joinable());
+
+	_stopCompletionThread = false;
+	_completionThread = std::thread{ &DbWAL::completionThreadFunction, this };
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::stopCompletionThread() noexcept
+{
+	if (!_completionThread.joinable())
+		return;
+
+	{
+		std::lock_guard lock{ _mtxFlushContinuations };
+		_stopCompletionThread = true;
+	}
+	_flushContinuationsCv.notify_one();
+	_completionThread.join();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::completionThreadFunction() noexcept
+{
+	std::unique_lock lock{ _mtxFlushContinuations };
+	for (;;)
+	{
+		// Only stop once every continuation has been run
+		_flushContinuationsCv.wait(lock, [this] {
+			return hasReadyFlushContinuations() || (_stopCompletionThread && _flushContinuations.empty());
+		});
+
+		if (_flushContinuations.empty())
+			break;
+
+		const WAL::OpID lastFlushedOpId = _lastFlushedOpId;
+		const auto readyBegin = std::partition(begin_to_end(_flushContinuations), [lastFlushedOpId](const FlushContinuation& item) {
+			return item.opId > lastFlushedOpId;
+		});
+
+		std::vector<FlushContinuation> ready{ std::make_move_iterator(readyBegin), std::make_move_iterator(_flushContinuations.end()) };
+		_flushContinuations.erase(readyBegin, _flushContinuations.end());
+		std::sort(begin_to_end(ready), [](const FlushContinuation& l, const FlushContinuation& r) {
+			return l.opId < r.opId;
+		});
+
+		// The continuations may register more operations and even wait for them
+		lock.unlock();
+		for (auto& item : ready)
+			item.continuation();
+		lock.lock();
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::startFlusherThread() noexcept
+{
+	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
+	assert_r(!_flusherThread.joinable());
+
+	_stopFlusher = false;
+	_flusherThread = std::thread{ &DbWAL::flusherThreadFunction, this };
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::stopFlusherThread() noexcept
+{
+	if (!_flusherThread.joinable())
+		return;
+
+	{
+		std::lock_guard lock{ _mtxBlock };
+		_stopFlusher = true;
+	}
+	_flusherCv.notify_one();
+	_flusherThread.join();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::flusherThreadFunction() noexcept
+{
+	for (;;)
+	{
+		std::unique_lock lock{ _mtxBlock };
+		// Sleep until there's something to write
+		_flusherCv.wait(lock, [this] { return hasSealedBlocks() || !currentBlockIsEmpty() || _stopFlusher; });
+
+		if (!hasSealedBlocks())
+		{
+			if (currentBlockIsEmpty())
+				break; // Stop requested and nothing left to write
+
+			// Let the current block fill up until it's due, unless it gets sealed by a writer or the log is being closed.
+			// The first writer may not have stored the time stamp yet, in which case the block has only just been started.
+			const uint64_t blockSeq = _currentBlockSeq;
+			const uint64_t startTimeStamp = blockBySequenceNumber(blockSeq).startTimeStamp;
+			const uint64_t elapsed = startTimeStamp != 0 ? timeStampUs() - startTimeStamp : 0;
+			const uint64_t timeout = flushTimeoutUs();
+			const auto remaining = std::chrono::microseconds{ elapsed < timeout ? static_cast<int64_t>(timeout - elapsed) : 0 };
+			_flusherCv.wait_for(lock, remaining, [&] {
+				return _currentBlockSeq != blockSeq || _stopFlusher;
+			});
+
+			const bool timedOut = !_stopFlusher;
+			lock.unlock();
+			if (!closeBlock(blockSeq, timedOut ? SealReason::Timeout : SealReason::Close)) [[unlikely]]
+				fatalAbort("WAL: failed to seal the block!");
+		}
+		else
+			lock.unlock();
+
+		// The writers keep filling the next block while the sealed ones are being written
+		if (!writeSealedBlocks()) [[unlikely]]
+			fatalAbort("WAL: flush failed!");
+
+		notifyFlushContinuations();
+
+		// Taking the lock guarantees that a writer that has found the ring full is already waiting for the notification
+		{
+			std::lock_guard guard{ _mtxBlock };
+		}
+		_blockSpaceCv.notify_all();
+	}
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::notifyFlusherBlockStarted() noexcept
+{
+	// The flusher needs to know when the block stops being empty to start tracking its timeout.
+	// The block is filled without the lock, taking it guarantees that the flusher has either seen the item or is already waiting for the notification.
+	{
+		std::lock_guard lock{ _mtxBlock };
+	}
+	_flusherCv.notify_one();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::startSyncThread() noexcept
+{
+	assert_debug_only(std::this_thread::get_id() == _ownerThreadId);
+	assert_r(!_syncThread.joinable());
+
+	_stopSyncThread = false;
+	_syncThread = std::thread{ &DbWAL::syncThreadFunction, this };
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::stopSyncThread() noexcept
+{
+	if (!_syncThread.joinable())
+		return;
+
+	{
+		std::lock_guard lock{ _mtxSyncThread };
+		_stopSyncThread = true;
+	}
+	_syncThreadCv.notify_one();
+	_syncThread.join();
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::unregisterBlockBuffers() noexcept
+{
+	if (!_blockBuffersRegistered)
+		return;
+
+	// An empty set of buffers unregisters the previous one
+	[[maybe_unused]] const bool unregistered = _logFile.registerBuffers({});
+	_blockBuffersRegistered = false;
+}
+
+template<RecordType Record, class StorageAdapter, size_t BlockSizeBytes>
+void DbWAL<Record, StorageAdapter, BlockSizeBytes>::syncThreadFunction() noexcept
+{
+	std::unique_lock lock{ _mtxSyncThread };
+	while (!_syncThreadCv.wait_for(lock, std::chrono::milliseconds{ _options.syncIntervalMs }, [this] { return _stopSyncThread; }))
+	{
+		std::lock_guard fileLock{ _mtxLogFile };
+		if (!_logFile.sync()) [[unlikely]]
+			fatalAbort("WAL: sync failed!");
+	}
+}
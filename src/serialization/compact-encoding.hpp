@@ -0,0 +1,222 @@
+#pragma once
+
+#include "../storage/storage_io_interface.hpp"
+
+#include "assert/advanced_assert.h"
+#include "utility/extra_type_traits.hpp"
+
+#include <array>
+#include <bit>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The compact encoding of the values, for the record types that opt in (see compactEncoding_v):
+// - the lengths of strings and arrays are LEB128 varints instead of uint32_t;
+// - the integers wider than a byte are LEB128 varints, the signed ones zigzag-encoded first (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...);
+// - everything else trivially serializable is stored as is.
+// LEB128: 7 bits per byte, least significant first, the high bit is set in every byte but the last one.
+namespace compact {
+
+// The most bytes a value of the type T can take as a varint
+template <typename T>
+inline constexpr size_t MaxVarintSize = (sizeof(T) * 8 + 6) / 7;
+
+[[nodiscard]] constexpr size_t varintSize(const uint64_t value) noexcept
+{
+	return static_cast<size_t>(std::bit_width(value | 1) + 6) / 7;
+}
+
+// Writes the value to 'out', which must have room for varintSize(value) bytes. Returns the number of bytes written.
+constexpr size_t encodeVarint(uint64_t value, uint8_t* out) noexcept
+{
+	size_t size = 0;
+	for (; value >= 0x80; value >>= 7)
+		out[size++] = static_cast<uint8_t>(value | 0x80);
+
+	out[size++] = static_cast<uint8_t>(value);
+	return size;
+}
+
+// Writes the value padded with redundant continuation bytes to exactly 'size' bytes, which must be no less than varintSize(value).
+// This way a value can be filled in later in the space reserved for it.
+constexpr void encodeVarintPadded(uint64_t value, uint8_t* out, const size_t size) noexcept
+{
+	for (size_t i = 0; i + 1 < size; ++i, value >>= 7)
+		out[i] = static_cast<uint8_t>(value | 0x80);
+
+	out[size - 1] = static_cast<uint8_t>(value);
+}
+
+// Decodes a varint from at most 'available' bytes. Returns the number of bytes consumed, or 0 if the varint is cut off or doesn't fit 64 bits.
+[[nodiscard]] constexpr size_t decodeVarint(const uint8_t* in, const size_t available, uint64_t& value) noexcept
+{
+	value = 0;
+	for (size_t i = 0; i < available && i < MaxVarintSize<uint64_t>; ++i)
+	{
+		value |= uint64_t{ in[i] & 0x7Fu } << (7 * i);
+		if ((in[i] & 0x80) == 0)
+			return i + 1;
+	}
+
+	return 0;
+}
+
+template <typename T>
+[[nodiscard]] constexpr std::make_unsigned_t<T> zigzagEncode(const T value) noexcept
+{
+	using U = std::make_unsigned_t<T>;
+	if constexpr (std::is_signed_v<T>)
+		return static_cast<U>(static_cast<U>(static_cast<U>(value) << 1) ^ static_cast<U>(value < 0 ? ~U{ 0 } : U{ 0 }));
+	else
+		return value;
+}
+
+template <typename T>
+[[nodiscard]] constexpr T zigzagDecode(const std::make_unsigned_t<T> value) noexcept
+{
+	using U = std::make_unsigned_t<T>;
+	if constexpr (std::is_signed_v<T>)
+		return static_cast<T>(static_cast<U>(value >> 1) ^ static_cast<U>((value & 1) != 0 ? ~U{ 0 } : U{ 0 }));
+	else
+		return value;
+}
+
+// The integers that are stored as varints. A single byte can't get any shorter.
+template <typename T>
+inline constexpr bool isVarint_v = std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) > 1;
+
+template <typename T>
+[[nodiscard]] size_t valueSize(const T& value) noexcept
+{
+	if constexpr (isVarint_v<T>)
+		return varintSize(zigzagEncode(value));
+	else if constexpr (is_trivially_serializable_v<T>)
+		return sizeof(T);
+	else if constexpr (std::is_same_v<T, std::string>)
+		return varintSize(value.size()) + value.size();
+	else
+	{
+		using Item = typename T::value_type;
+		static_assert(std::is_same_v<T, std::vector<Item>>, "Unsupported value type");
+
+		size_t size = varintSize(value.size());
+		if constexpr (is_trivially_serializable_v<Item> && !isVarint_v<Item>)
+			size += value.size() * sizeof(Item);
+		else
+		{
+			for (const auto& item : value)
+				size += compact::valueSize(item);
+		}
+
+		return size;
+	}
+}
+
+template <class StorageAdapter>
+[[nodiscard]] bool writeVarint(StorageIO<StorageAdapter>& io, const uint64_t value) noexcept
+{
+	std::array<uint8_t, MaxVarintSize<uint64_t>> buffer;
+	return io.write(buffer.data(), encodeVarint(value, buffer.data()));
+}
+
+template <class StorageAdapter>
+[[nodiscard]] bool readVarint(StorageIO<StorageAdapter>& io, uint64_t& value) noexcept
+{
+	value = 0;
+	for (size_t i = 0; i < MaxVarintSize<uint64_t>; ++i)
+	{
+		uint8_t byte = 0;
+		if (!io.read(byte))
+			return false;
+
+		value |= uint64_t{ byte & 0x7Fu } << (7 * i);
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+
+	assert_unconditional_r("The varint doesn't fit 64 bits!");
+	return false;
+}
+
+// Reads a varint that has to fit the type T
+template <typename T, class StorageAdapter>
+[[nodiscard]] bool readVarint(StorageIO<StorageAdapter>& io, T& value) noexcept
+{
+	uint64_t encoded = 0;
+	if (!readVarint(io, encoded))
+		return false;
+
+	using U = std::make_unsigned_t<T>;
+	assert_and_return_message_r(encoded <= std::numeric_limits<U>::max(), "The varint doesn't fit the value type!", false);
+	value = zigzagDecode<T>(static_cast<U>(encoded));
+	return true;
+}
+
+template <typename T, class StorageAdapter>
+[[nodiscard]] bool write(StorageIO<StorageAdapter>& io, const T& value) noexcept
+{
+	if constexpr (isVarint_v<T>)
+		return writeVarint(io, zigzagEncode(value));
+	else if constexpr (is_trivially_serializable_v<T>)
+		return io.write(value);
+	else if constexpr (std::is_same_v<T, std::string>)
+		return writeVarint(io, value.size()) && io.write(value.data(), value.size());
+	else
+	{
+		using Item = typename T::value_type;
+		if (!writeVarint(io, value.size()))
+			return false;
+
+		if constexpr (is_trivially_serializable_v<Item> && !isVarint_v<Item>)
+			return io.write(value.data(), value.size() * sizeof(Item));
+		else
+		{
+			for (const auto& item : value)
+			{
+				if (!compact::write(io, item))
+					return false;
+			}
+
+			return true;
+		}
+	}
+}
+
+template <typename T, class StorageAdapter>
+[[nodiscard]] bool read(StorageIO<StorageAdapter>& io, T& value) noexcept
+{
+	if constexpr (isVarint_v<T>)
+		return readVarint(io, value);
+	else if constexpr (is_trivially_serializable_v<T>)
+		return io.read(value);
+	else
+	{
+		using Item = typename T::value_type;
+
+		uint32_t size = 0;
+		if (!readVarint(io, size))
+			return false;
+
+		value.resize(size);
+		if constexpr (std::is_same_v<T, std::string>)
+			return io.read(value.data(), size);
+		else if constexpr (is_trivially_serializable_v<Item> && !isVarint_v<Item>)
+			return io.read(value.data(), uint64_t{ size } * sizeof(Item));
+		else
+		{
+			for (auto& item : value)
+			{
+				if (!compact::read(io, item))
+					return false;
+			}
+
+			return true;
+		}
+	}
+}
+
+} // namespace compact
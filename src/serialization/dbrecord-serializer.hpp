@@ -2,11 +2,15 @@
 
 #include "../storage/storage_io_interface.hpp"
 #include "../dbrecord.hpp"
+#include "compact-encoding.hpp"
 
 #include "assert/advanced_assert.h"
 #include "utility/constexpr_algorithms.hpp"
 #include "utility/template_magic.hpp"
 
+#include <array>
+#include <memory>
+#include <stdint.h>
 #include <string.h> // memcpy
 
 template <typename T>
@@ -19,85 +23,159 @@ struct DbRecordSerializer<DbRecord<Args...>>
 {
 	using Record = DbRecord<Args...>;
 
+	// The number of bytes serialize() writes for the record
+	[[nodiscard]] static size_t serializedSize(const Record& record) noexcept
+	{
+		if constexpr (compactEncoding_v<Record>)
+		{
+			size_t size = 0;
+			static_for<0, Record::fieldCount()>([&]<auto i>() {
+				size += compact::valueSize(record.template fieldAtIndex<i>().value);
+			});
+			return size;
+		}
+		else
+			return record.totalSize();
+	}
+
 	template <typename StorageImplementation>
 	[[nodiscard]] static bool serialize(const Record& record, StorageIO<StorageImplementation>& io) noexcept
 	{
-		// Statically sized fields are grouped before others and can be read or written in a single block.
-		static constexpr size_t staticFieldsSize = record.staticFieldsSize();
-		std::array<uint8_t, staticFieldsSize> buffer;
+		// In the compact encoding the static fields don't have static size, every field is encoded on its own
+		if constexpr (compactEncoding_v<Record>)
+			return serializeCompact(record, io);
+		else
+		{
+			// The whole record is laid out in memory and written at once: a write per field, let alone per array item, costs a call into stdio for FopenAdapter.
+			// The records that fit are laid out on the stack.
+			const size_t totalSize = record.totalSize();
+			if (totalSize <= LayoutBufferSize)
+			{
+				std::array<std::byte, LayoutBufferSize> buffer;
+				layOut(record, buffer.data(), totalSize);
+				assert_and_return_r(io.write(buffer.data(), totalSize), false);
+				return true;
+			}
 
-		size_t bufferOffset = 0;
-		static_for<0, record.staticFieldsCount()>([&]<auto I>() {
-			using FieldType = typename Record::template FieldTypeByIndex_t<I>;
+			const auto buffer = std::make_unique_for_overwrite<std::byte[]>(totalSize);
+			layOut(record, buffer.get(), totalSize);
+			assert_and_return_r(io.write(buffer.get(), totalSize), false);
+			return true;
+		}
+	}
 
-			const auto& field = record.template fieldAtIndex<I>();
-			static_assert(std::is_same_v<std::remove_cv_t<FieldType>, remove_cv_and_reference_t<decltype(field)>>);
-			static_assert(is_trivially_serializable_v<typename FieldType::ValueType>);
-			static_assert(FieldType::sizeKnownAtCompileTime());
+	template <typename StorageImplementation>
+	[[nodiscard]] static bool deserialize(Record& record, StorageIO<StorageImplementation>& io) noexcept
+	{
+		if constexpr (compactEncoding_v<Record>)
+			return deserializeCompact(record, io);
+		else
+		{
+			// Statically sized fields are grouped before others and can be read or written in a single block.
+			static constexpr size_t staticFieldsSize = record.staticFieldsSize();
+			std::array<uint8_t, staticFieldsSize> buffer;
 
-			::memcpy(buffer.data() + bufferOffset, std::addressof(field.value), FieldType::staticSize());
-			bufferOffset += FieldType::staticSize();
-		});
+			assert_and_return_r(io.read(buffer.data(), staticFieldsSize), false);
 
-		assert_r(bufferOffset == buffer.size());
-		assert_and_return_r(io.write(buffer.data(), staticFieldsSize), false);
+			size_t bufferOffset = 0;
+			bool success = true;
+			static_for<0, Record::fieldCount()>([&]<auto i>() {
+				using FieldType = typename Record::template FieldTypeByIndex_t<i>;
 
-		bool success = true;
-		static_for<record.staticFieldsCount(), record.fieldCount()>([&]<auto i>() {
-			if (!success)
-				return;
+				auto& field = record.template fieldAtIndex<i>();
+				static_assert(std::is_same_v<std::remove_cv_t<FieldType>, remove_cv_and_reference_t<decltype(field)>>);
+
+				if constexpr (FieldType::sizeKnownAtCompileTime())
+				{
+					static_assert(is_trivially_serializable_v<typename FieldType::ValueType>);
+					::memcpy(std::addressof(field.value), buffer.data() + bufferOffset, FieldType::staticSize());
+					bufferOffset += FieldType::staticSize();
+				}
+				else
+				{
+					if (!success)
+						return;
+
+					if (!io.readField(field))
+					{
+						assert_unconditional_r("Failed to read data!");
+						success = false;
+					}
+				}
+				});
 
-			using FieldType = typename Record::template FieldTypeByIndex_t<i>;
+			return success;
+		}
+	}
+
+private:
+	static constexpr size_t LayoutBufferSize = 4096;
 
-			const auto& field = record.template fieldAtIndex<i>();
-			static_assert(std::is_same_v<std::remove_cv_t<FieldType>, remove_cv_and_reference_t<decltype(field)>>);
-			static_assert(!FieldType::sizeKnownAtCompileTime());
+	// Writes the record to 'out' the way StorageIO would write its fields one by one
+	static void layOut(const Record& record, std::byte* out, [[maybe_unused]] const size_t totalSize) noexcept
+	{
+		[[maybe_unused]] const std::byte* const begin = out;
+		static_for<0, Record::fieldCount()>([&]<auto i>() {
+			layOutValue(record.template fieldAtIndex<i>().value, out);
+		});
+
+		assert_debug_only(static_cast<size_t>(out - begin) == totalSize);
+	}
+
+	template <typename T>
+	static void layOutValue(const T& value, std::byte*& out) noexcept
+	{
+		if constexpr (is_trivially_serializable_v<T>)
+		{
+			::memcpy(out, std::addressof(value), sizeof(T));
+			out += sizeof(T);
+		}
+		else
+		{
+			// A string or an array: the item count, followed by the items
+			layOutValue(static_cast<uint32_t>(value.size()), out);
+
+			using Item = typename T::value_type;
+			if constexpr (is_trivially_serializable_v<Item> && !std::is_same_v<Item, bool>)
+			{
+				if (!value.empty())
+					::memcpy(out, value.data(), value.size() * sizeof(Item));
+				out += value.size() * sizeof(Item);
+			}
+			else
+			{
+				for (const auto& item : value)
+					layOutValue(item, out);
+			}
+		}
+	}
 
-			if (!io.writeField(field))
+	template <typename StorageImplementation>
+	[[nodiscard]] static bool serializeCompact(const Record& record, StorageIO<StorageImplementation>& io) noexcept
+	{
+		bool success = true;
+		static_for<0, Record::fieldCount()>([&]<auto i>() {
+			if (success && !compact::write(io, record.template fieldAtIndex<i>().value))
 			{
 				assert_unconditional_r("Failed to write data!");
 				success = false;
 			}
-			});
+		});
 
 		return success;
 	}
 
 	template <typename StorageImplementation>
-	[[nodiscard]] static bool deserialize(Record& record, StorageIO<StorageImplementation>& io) noexcept
+	[[nodiscard]] static bool deserializeCompact(Record& record, StorageIO<StorageImplementation>& io) noexcept
 	{
-		// Statically sized fields are grouped before others and can be read or written in a single block.
-		static constexpr size_t staticFieldsSize = record.staticFieldsSize();
-		std::array<uint8_t, staticFieldsSize> buffer;
-
-		assert_and_return_r(io.read(buffer.data(), staticFieldsSize), false);
-
-		size_t bufferOffset = 0;
 		bool success = true;
 		static_for<0, Record::fieldCount()>([&]<auto i>() {
-			using FieldType = typename Record::template FieldTypeByIndex_t<i>;
-
-			auto& field = record.template fieldAtIndex<i>();
-			static_assert(std::is_same_v<std::remove_cv_t<FieldType>, remove_cv_and_reference_t<decltype(field)>>);
-
-			if constexpr (FieldType::sizeKnownAtCompileTime())
-			{
-				static_assert(is_trivially_serializable_v<typename FieldType::ValueType>);
-				::memcpy(std::addressof(field.value), buffer.data() + bufferOffset, FieldType::staticSize());
-				bufferOffset += FieldType::staticSize();
-			}
-			else
+			if (success && !compact::read(io, record.template fieldAtIndex<i>().value))
 			{
-				if (!success)
-					return;
-
-				if (!io.readField(field))
-				{
-					assert_unconditional_r("Failed to read data!");
-					success = false;
-				}
+				assert_unconditional_r("Failed to read data!");
+				success = false;
 			}
-			});
+		});
 
 		return success;
 	}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "../storage/storage_io_interface.hpp"
+#include "../dbrecord.hpp"
+
+#include "assert/advanced_assert.h"
+#include "parameter_pack/parameter_pack_helpers.hpp"
+#include "utility/constexpr_algorithms.hpp"
+#include "utility/extra_type_traits.hpp"
+#include "utility/template_magic.hpp"
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <string.h> // memcpy
+
+// The items of a serialized array field, in place. They are copied out on access: the serialized data isn't necessarily aligned for T.
+template <typename T>
+class ArrayView
+{
+	static_assert(is_trivially_serializable_v<T>);
+
+public:
+	constexpr ArrayView() noexcept = default;
+	constexpr explicit ArrayView(std::span<const std::byte> bytes) noexcept :
+		_bytes{ bytes }
+	{}
+
+	[[nodiscard]] constexpr size_t size() const noexcept
+	{
+		return _bytes.size() / sizeof(T);
+	}
+
+	[[nodiscard]] constexpr bool empty() const noexcept
+	{
+		return _bytes.empty();
+	}
+
+	[[nodiscard]] T operator[](const size_t index) const noexcept
+	{
+		T item;
+		::memcpy(std::addressof(item), _bytes.data() + index * sizeof(T), sizeof(T));
+		return item;
+	}
+
+	[[nodiscard]] constexpr std::span<const std::byte> bytes() const noexcept
+	{
+		return _bytes;
+	}
+
+	[[nodiscard]] std::vector<T> toVector() const
+	{
+		std::vector<T> items(size());
+		::memcpy(items.data(), _bytes.data(), _bytes.size());
+		return items;
+	}
+
+	[[nodiscard]] bool operator==(const std::vector<T>& other) const noexcept
+	{
+		if (other.size() != size())
+			return false;
+
+		for (size_t i = 0; i < other.size(); ++i)
+		{
+			if (!((*this)[i] == other[i]))
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	std::span<const std::byte> _bytes;
+};
+
+template <typename T>
+struct RecordView {
+	FAIL_COMPILATION_WITH_MSG("This shouldn't be instantiated - check the template parameter list for errors!");
+};
+
+// A record serialized by DbRecordSerializer, read in place from the memory of an in-memory adapter without copying or allocating anything.
+// The static fields are copied out on access, strings are exposed as std::string_view and arrays as ArrayView.
+// The view points into the adapter's memory, it's only valid for as long as the serialized data stays there.
+// It has the traits of the record, so the operations can hold a view in place of the record.
+template <FieldType... Fields>
+class RecordView<DbRecord<Fields...>>
+{
+public:
+	using Record = DbRecord<Fields...>;
+
+// Traits
+	static constexpr bool isRecord = true;
+
+	template <size_t index>
+	using FieldTypeByIndex_t = typename Record::template FieldTypeByIndex_t<index>;
+
+	template <auto id>
+	using FieldById_t = typename Record::template FieldById_t<id>;
+
+	using FieldTypesPack = typename Record::FieldTypesPack;
+	using KeyField = typename Record::KeyField;
+
+	template <typename F>
+	static constexpr bool has_field_v = Record::template has_field_v<F>;
+
+public:
+	// Reads the view of the record at the current position of 'io' and moves past it
+	template <typename StorageImplementation>
+	[[nodiscard]] bool read(StorageIO<StorageImplementation>& io) noexcept
+	{
+		static_assert(!compactEncoding_v<Record>, "The views are only available for the records in the default encoding");
+
+		_staticFields = io.readInPlace(Record::staticFieldsSize());
+		assert_and_return_r(_staticFields, false);
+
+		bool success = true;
+		static_for<Record::staticFieldsCount(), Record::fieldCount()>([&]<auto i>() {
+			using FieldType = FieldTypeByIndex_t<i>;
+			if (!success)
+				return;
+
+			// The same layout as StorageIO::write(): the item count, followed by the items
+			uint32_t count = 0;
+			const std::byte* data = io.read(count) ? io.readInPlace(uint64_t{ count } * itemSize<FieldType>()) : nullptr;
+			if (data == nullptr)
+			{
+				assert_unconditional_r("Failed to read data!");
+				success = false;
+				return;
+			}
+
+			_dynamicFields[i - Record::staticFieldsCount()] = std::span{ data, count * itemSize<FieldType>() };
+		});
+
+		return success;
+	}
+
+	// The value of a static field, std::string_view for a string, ArrayView for an array
+	template <typename Field>
+	[[nodiscard]] auto fieldValue() const noexcept
+	{
+		constexpr size_t index = pack::index_for_type_v<Field, Fields...>;
+		if constexpr (Field::sizeKnownAtCompileTime())
+		{
+			typename Field::ValueType value;
+			::memcpy(std::addressof(value), _staticFields + staticFieldOffset<index>(), Field::staticSize());
+			return value;
+		}
+		else
+		{
+			const std::span<const std::byte> data = _dynamicFields[index - Record::staticFieldsCount()];
+			if constexpr (Field::isArray())
+				return ArrayView<typename Field::ValueType::value_type>{ data };
+			else
+				return std::string_view{ reinterpret_cast<const char*>(data.data()), data.size() };
+		}
+	}
+
+	// A copy of the record
+	[[nodiscard]] Record toRecord() const
+	{
+		Record record;
+		static_for<0, Record::fieldCount()>([&]<auto i>() {
+			using FieldType = FieldTypeByIndex_t<i>;
+
+			auto& value = record.template fieldAtIndex<i>().value;
+			if constexpr (FieldType::sizeKnownAtCompileTime())
+				value = fieldValue<FieldType>();
+			else if constexpr (FieldType::isArray())
+				value = fieldValue<FieldType>().toVector();
+			else
+				value = std::string{ fieldValue<FieldType>() };
+		});
+
+		return record;
+	}
+
+private:
+	template <class Field>
+	[[nodiscard]] static consteval size_t itemSize() noexcept
+	{
+		if constexpr (Field::isArray())
+		{
+			using Item = typename Field::ValueType::value_type;
+			static_assert(is_trivially_serializable_v<Item>, "The views are only available for the arrays of trivially serializable items");
+			return sizeof(Item);
+		}
+		else
+		{
+			static_assert(std::is_same_v<typename Field::ValueType, std::string>, "The views are only available for strings and arrays");
+			return sizeof(char);
+		}
+	}
+
+	template <size_t index>
+	[[nodiscard]] static consteval size_t staticFieldOffset() noexcept
+	{
+		size_t offset = 0;
+		static_for<0, index>([&offset]<auto I>() {
+			offset += FieldTypeByIndex_t<I>::staticSize();
+		});
+
+		return offset;
+	}
+
+private:
+	const std::byte* _staticFields = nullptr;
+	// The items of the dynamic fields, without the count
+	std::array<std::span<const std::byte>, Record::fieldCount() - Record::staticFieldsCount()> _dynamicFields{};
+};
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <stddef.h>
+
 namespace io {
 	enum class OpenMode { Read, Write, ReadWrite };
+
+	// One of the buffers of a vectored (gather) write
+	struct ConstBuffer {
+		const void* data;
+		size_t size;
+	};
 } // namespace io
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "io_base_definitions.hpp"
+
 #include <hash/fnv_1a.h>
 
+#include <span>
+
 namespace io {
 
 template <class IOAdapter>
@@ -22,6 +26,15 @@ public:
 		return IOAdapter::write(targetBuffer, dataSize);
 	}
 
+	[[nodiscard]] bool writeVectored(std::span<const ConstBuffer> buffers) noexcept
+		requires requires(IOAdapter& adapter) { adapter.writeVectored(buffers); }
+	{
+		for (const auto& buffer : buffers)
+			_hasher.updateHash(buffer.data, buffer.size);
+
+		return IOAdapter::writeVectored(buffers);
+	}
+
 	[[nodiscard]] auto calculatedHash() const noexcept
 	{
 		return _hasher.calculatedHash();
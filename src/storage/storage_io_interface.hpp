@@ -7,7 +7,10 @@
 #include "utility/extra_type_traits.hpp"
 #include "utility/template_magic.hpp"
 
+#include <algorithm>
+#include <array>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -49,8 +52,26 @@ struct StorageIO final
 
 	[[nodiscard]] constexpr bool read(void* dataPtr, uint64_t size) noexcept;
 	[[nodiscard]] constexpr bool write(const void* dataPtr, uint64_t size) noexcept;
+	// Skips over the next 'size' bytes and returns where they are in the adapter's memory, without copying them. Only for the in-memory adapters.
+	// Returns nullptr if there isn't as much data left.
+	[[nodiscard]] constexpr const std::byte* readInPlace(uint64_t size) noexcept;
+	// Writes the buffers back-to-back. Takes a single vectored write if the adapter supports it, otherwise writes them one by one.
+	[[nodiscard]] constexpr bool writeVectored(std::span<const io::ConstBuffer> buffers) noexcept;
+	// writeVectored() followed by sync(). The adapters that can (io::IoUringAdapter) submit the writes and the sync together.
+	[[nodiscard]] constexpr bool writeVectoredAndSync(std::span<const io::ConstBuffer> buffers) noexcept;
+	// Tells the adapter which buffers are going to be written repeatedly, so it can set them up for I/O once (io_uring registered buffers).
+	// The buffers have to stay valid until they're replaced, unregistered (by passing an empty span) or the adapter is destroyed. Returns false if the adapter doesn't support it, which doesn't affect the writes.
+	[[nodiscard]] constexpr bool registerBuffers(std::span<const io::ConstBuffer> buffers) noexcept;
 
 	constexpr bool flush() noexcept;
+	// Makes everything written so far durable (fdatasync() or equivalent). A no-op for in-memory adapters.
+	[[nodiscard]] constexpr bool sync() noexcept;
+	// Asks the adapter to make each write durable before returning. Takes effect on the next open().
+	// Returns false if the adapter doesn't support it.
+	[[nodiscard]] constexpr bool setWriteThrough(bool enable) noexcept;
+	// Makes sure the file is at least 'size' bytes long and the space is allocated, so that writing within it doesn't change the file metadata.
+	// The new space reads as zeros. The position is left alone.
+	[[nodiscard]] constexpr bool preallocate(uint64_t size) noexcept;
 	[[nodiscard]] constexpr bool seek(uint64_t location) noexcept;
 	[[nodiscard]] constexpr bool seekToEnd() noexcept;
 	[[nodiscard]] constexpr uint64_t pos() const noexcept;
@@ -60,6 +81,9 @@ struct StorageIO final
 
 	[[nodiscard]] constexpr bool clear() noexcept;
 
+	// The most bytes read(std::vector<T>&) reads with a single call
+	static constexpr size_t MaxArrayReadChunkSize = 1024 * 1024;
+
 private:
 	template <typename T>
 	constexpr bool checkedWrite(T&& value)
@@ -166,14 +190,35 @@ constexpr bool StorageIO<IOAdapter>::read(std::vector<T>& v, const std::optional
 	uint32_t nItems = 0;
 	assert_and_return_r(checkedRead(nItems), false);
 
-	v.resize(nItems);
-	for (size_t i = 0; i < nItems; ++i)
+	if constexpr (is_trivially_serializable_v<T> && !std::is_same_v<T, bool>)
 	{
-		if (this->read(v[i]) == false)
-			return false;
+		// Read straight into the vector, a chunk at a time for the huge arrays, so that a corrupt item count can't make it allocate gigabytes up front
+		static constexpr size_t ChunkItems = std::max<size_t>(MaxArrayReadChunkSize / sizeof(T), 1);
+		v.clear();
+		for (size_t itemsRead = 0; itemsRead < nItems;)
+		{
+			const size_t chunkItems = std::min<size_t>(nItems - itemsRead, ChunkItems);
+			v.resize(itemsRead + chunkItems);
+			if (!_io.read(v.data() + itemsRead, chunkItems * sizeof(T)))
+				return false;
+
+			itemsRead += chunkItems;
+		}
+
+		return true;
+	}
+	else
+	{
+		// Nested vectors and strings are read by the overloads above, each item's data in bulk
+		v.resize(nItems);
+		for (size_t i = 0; i < nItems; ++i)
+		{
+			if (this->read(v[i]) == false)
+				return false;
+		}
+
+		return true;
 	}
-
-	return true;
 }
 
 template<typename IOAdapter>
@@ -186,13 +231,19 @@ constexpr bool StorageIO<IOAdapter>::write(const std::vector<T>& v, const std::o
 	const uint32_t nItems = static_cast<uint32_t>(v.size());
 	assert_and_return_r(checkedWrite(nItems), false);
 
-	for (size_t i = 0; i < nItems; ++i)
+	// The items are laid out in the vector exactly as they're stored, except for the bit-packed std::vector<bool>
+	if constexpr (is_trivially_serializable_v<T> && !std::is_same_v<T, bool>)
+		return nItems == 0 || _io.write(v.data(), uint64_t{ nItems } * sizeof(T));
+	else
 	{
-		if (this->write(v[i]) == false)
-			return false;
-	}
+		for (size_t i = 0; i < nItems; ++i)
+		{
+			if (this->write(v[i]) == false)
+				return false;
+		}
 
-	return true;
+		return true;
+	}
 }
 
 template<typename IOAdapter>
@@ -207,6 +258,36 @@ inline constexpr bool StorageIO<IOAdapter>::write(const void* const dataPtr, uin
 	return _io.write(dataPtr, size);
 }
 
+template<typename IOAdapter>
+inline constexpr const std::byte* StorageIO<IOAdapter>::readInPlace(const uint64_t size) noexcept
+{
+	static_assert(requires { _io.data(); }, "The adapter isn't backed by memory");
+
+	const uint64_t position = _io.pos();
+	if (size > _io.size() || position > _io.size() - size)
+		return nullptr;
+
+	assert_and_return_r(_io.seek(position + size), nullptr);
+	return static_cast<const std::byte*>(static_cast<const void*>(_io.data())) + position;
+}
+
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::writeVectored(std::span<const io::ConstBuffer> buffers) noexcept
+{
+	if constexpr (requires { _io.writeVectored(buffers); })
+		return _io.writeVectored(buffers);
+	else
+	{
+		for (const auto& buffer : buffers)
+		{
+			if (!_io.write(buffer.data, buffer.size))
+				return false;
+		}
+
+		return true;
+	}
+}
+
 template<typename IOAdapter>
 inline constexpr bool StorageIO<IOAdapter>::seek(uint64_t location) noexcept
 {
@@ -225,6 +306,66 @@ inline constexpr bool StorageIO<IOAdapter>::flush() noexcept
 	return _io.flush();
 }
 
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::sync() noexcept
+{
+	return _io.sync();
+}
+
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::writeVectoredAndSync(std::span<const io::ConstBuffer> buffers) noexcept
+{
+	if constexpr (requires { _io.writeVectoredAndSync(buffers); })
+		return _io.writeVectoredAndSync(buffers);
+	else
+		return writeVectored(buffers) && flush() && sync();
+}
+
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::registerBuffers(std::span<const io::ConstBuffer> buffers) noexcept
+{
+	if constexpr (requires { _io.registerBuffers(buffers); })
+		return _io.registerBuffers(buffers);
+	else
+		return false;
+}
+
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::setWriteThrough(const bool enable) noexcept
+{
+	if constexpr (requires { _io.setWriteThrough(enable); })
+		return _io.setWriteThrough(enable);
+	else
+		return false;
+}
+
+template<typename IOAdapter>
+inline constexpr bool StorageIO<IOAdapter>::preallocate(const uint64_t size) noexcept
+{
+	if constexpr (requires { _io.preallocate(size); })
+		return _io.preallocate(size);
+	else
+	{
+		const uint64_t currentSize = _io.size();
+		if (currentSize >= size)
+			return true;
+
+		// Extending the file with zeros
+		const uint64_t currentPos = _io.pos();
+		assert_and_return_r(_io.seek(currentSize), false);
+
+		static constexpr std::array<std::byte, 4096> zeros{};
+		for (uint64_t remaining = size - currentSize; remaining > 0;)
+		{
+			const auto chunkSize = static_cast<size_t>(std::min<uint64_t>(remaining, zeros.size()));
+			assert_and_return_r(_io.write(zeros.data(), chunkSize), false);
+			remaining -= chunkSize;
+		}
+
+		return _io.seek(currentPos);
+	}
+}
+
 template<typename IOAdapter>
 inline constexpr uint64_t StorageIO<IOAdapter>::pos() const noexcept
 {
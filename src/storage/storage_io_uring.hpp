@@ -0,0 +1,600 @@
+#pragma once
+
+#include "io_base_definitions.hpp"
+#include "storage_std.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define CPPDB_IO_URING
+#endif
+
+#ifdef CPPDB_IO_URING
+
+#include "assert/advanced_assert.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#endif
+
+namespace io {
+
+#ifdef CPPDB_IO_URING
+
+namespace io_uring_detail {
+
+// A minimal io_uring on top of the kernel interface (no liburing), for a single submitting thread:
+// queue up to 'Entries' requests, then submit them and wait for all of them in one go.
+class Ring
+{
+public:
+	static constexpr uint32_t Entries = 64;
+
+	Ring() noexcept = default;
+	~Ring() noexcept
+	{
+		destroy();
+	}
+
+	Ring(const Ring&) = delete;
+	Ring& operator=(const Ring&) = delete;
+
+	// Returns false if io_uring is not available: the kernel is older than 5.6, or the system calls are blocked
+	[[nodiscard]] bool init() noexcept
+	{
+		assert_and_return_r(!active(), true);
+
+		io_uring_params params{};
+		const auto fd = ::syscall(__NR_io_uring_setup, Entries, &params);
+		if (fd < 0)
+			return false;
+
+		_fd = static_cast<int>(fd);
+		// IORING_OP_READ and IORING_OP_WRITE came along with this feature in 5.6
+		if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+		{
+			destroy();
+			return false;
+		}
+
+		_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping)
+			_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+		_sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+		_cqRing = singleMapping ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+		_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		_sqes = static_cast<io_uring_sqe*>(map(_sqesSize, IORING_OFF_SQES));
+		if (!_sqRing || !_cqRing || !_sqes)
+		{
+			destroy();
+			return false;
+		}
+
+		auto* sq = static_cast<std::byte*>(_sqRing);
+		_sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+		_sqMask = *reinterpret_cast<const uint32_t*>(sq + params.sq_off.ring_mask);
+		_sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+		auto* cq = static_cast<std::byte*>(_cqRing);
+		_cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+		_cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+		_cqMask = *reinterpret_cast<const uint32_t*>(cq + params.cq_off.ring_mask);
+		_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		_queuedTail = _submittedTail = std::atomic_ref{ *_sqTail }.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	void destroy() noexcept
+	{
+		if (_sqes)
+			::munmap(_sqes, _sqesSize);
+		if (_cqRing && _cqRing != _sqRing)
+			::munmap(_cqRing, _cqRingSize);
+		if (_sqRing)
+			::munmap(_sqRing, _sqRingSize);
+		if (_fd >= 0)
+			::close(_fd);
+
+		_sqes = nullptr;
+		_sqRing = _cqRing = nullptr;
+		_fd = -1;
+	}
+
+	[[nodiscard]] bool active() const noexcept
+	{
+		return _fd >= 0;
+	}
+
+	[[nodiscard]] int fd() const noexcept
+	{
+		return _fd;
+	}
+
+	// A cleared submission queue entry. No more than 'Entries' of them may be queued before submitAndWait().
+	// The user_data is the entry's index in the batch.
+	[[nodiscard]] io_uring_sqe& queue() noexcept
+	{
+		assert_debug_only(_queuedTail - _submittedTail < Entries);
+
+		const uint32_t index = _queuedTail & _sqMask;
+		io_uring_sqe& sqe = _sqes[index];
+		sqe = io_uring_sqe{};
+		sqe.user_data = _queuedTail - _submittedTail;
+		_sqArray[index] = index;
+		++_queuedTail;
+		return sqe;
+	}
+
+	// Submits the queued entries and waits for all of them to complete. results[i] receives the result of the entry #i of the batch.
+	// If this fails, the ring is in an unknown state and has to be destroyed.
+	[[nodiscard]] bool submitAndWait(const std::span<int32_t> results) noexcept
+	{
+		const uint32_t count = _queuedTail - _submittedTail;
+		assert_and_return_r(count <= results.size(), false);
+
+		std::atomic_ref{ *_sqTail }.store(_queuedTail, std::memory_order_release);
+		_submittedTail = _queuedTail;
+
+		uint32_t toSubmit = count, completed = 0;
+		while (completed < count)
+		{
+			const auto result = ::syscall(__NR_io_uring_enter, _fd, toSubmit, count - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (result < 0)
+			{
+				// EAGAIN and EBUSY: out of resources until some of the requests in flight complete
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+					return false;
+			}
+			else
+				toSubmit -= static_cast<uint32_t>(result);
+
+			// Only this thread moves the head
+			uint32_t head = std::atomic_ref{ *_cqHead }.load(std::memory_order_relaxed);
+			const uint32_t tail = std::atomic_ref{ *_cqTail }.load(std::memory_order_acquire);
+			for (; head != tail; ++head, ++completed)
+			{
+				const io_uring_cqe& cqe = _cqes[head & _cqMask];
+				assert_and_return_r(cqe.user_data < count, false);
+				results[static_cast<size_t>(cqe.user_data)] = cqe.res;
+			}
+			std::atomic_ref{ *_cqHead }.store(head, std::memory_order_release);
+		}
+
+		return true;
+	}
+
+private:
+	[[nodiscard]] void* map(const size_t size, const uint64_t offset) const noexcept
+	{
+		void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, static_cast<off_t>(offset));
+		return address != MAP_FAILED ? address : nullptr;
+	}
+
+private:
+	int _fd = -1;
+
+	void* _sqRing = nullptr;
+	void* _cqRing = nullptr;
+	size_t _sqRingSize = 0;
+	size_t _cqRingSize = 0;
+	io_uring_sqe* _sqes = nullptr;
+	size_t _sqesSize = 0;
+
+	uint32_t* _sqTail = nullptr;
+	uint32_t* _sqArray = nullptr;
+	uint32_t _sqMask = 0;
+	uint32_t _queuedTail = 0;
+	uint32_t _submittedTail = 0;
+
+	uint32_t* _cqHead = nullptr;
+	uint32_t* _cqTail = nullptr;
+	io_uring_cqe* _cqes = nullptr;
+	uint32_t _cqMask = 0;
+};
+
+} // namespace io_uring_detail
+
+// Unbuffered file I/O through io_uring. Meant for the large block writes of the WAL: small reads and writes each take a round trip to the kernel.
+// - writeVectored() queues a write per buffer and submits them all with a single system call.
+// - writeVectoredAndSync() links an fdatasync to the writes, so a group commit is one system call instead of two.
+// - The buffers passed to registerBuffers() (the WAL block ring) are pinned by the kernel once, and written with IORING_OP_WRITE_FIXED.
+// The calls still wait for the I/O to complete, as StorageIO expects. If io_uring is not available at run time,
+// the adapter falls back to pread() / pwrite() / fdatasync().
+// As with the other adapters, only one thread may use an instance at a time.
+class IoUringAdapter
+{
+public:
+	IoUringAdapter() noexcept = default;
+	~IoUringAdapter() noexcept
+	{
+		if (_fd >= 0)
+			::close(_fd);
+	}
+
+	IoUringAdapter(const IoUringAdapter&) = delete;
+	IoUringAdapter& operator=(const IoUringAdapter&) = delete;
+
+	[[nodiscard]] bool open(std::string_view fileName, const OpenMode mode, const bool truncate = false) noexcept
+	{
+		assert_and_return_r(_fd < 0, false);
+
+		int flags = O_CLOEXEC;
+		switch (mode) {
+		case OpenMode::Read:
+			flags |= O_RDONLY;
+			break;
+		case OpenMode::Write:
+			flags |= O_WRONLY | O_CREAT | O_TRUNC;
+			break;
+		case OpenMode::ReadWrite:
+			flags |= O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+			break;
+		default:
+			assert_and_return_unconditional_r("Unknown open mode " + std::to_string(static_cast<int>(mode)), false);
+		}
+
+		if (_writeThrough && mode != OpenMode::Read)
+			flags |= O_DSYNC;
+
+		_filePath = fileName;
+		_fd = ::open(_filePath.c_str(), flags, 0644);
+		if (_fd < 0)
+			return false;
+
+		_mode = mode;
+		_pos = 0;
+
+		// The ring outlives the file, along with the registered buffers
+		if (!_ring.active() && !_ringUnavailable)
+			_ringUnavailable = !_ring.init();
+
+		return true;
+	}
+
+	[[nodiscard]] bool close() noexcept
+	{
+		assert_and_return_r(_fd >= 0, false);
+		const int fd = _fd;
+		_fd = -1;
+		_filePath.clear();
+		return ::close(fd) == 0;
+	}
+
+	[[nodiscard]] bool read(void* targetBuffer, const size_t dataSize) noexcept
+	{
+		auto* target = static_cast<std::byte*>(targetBuffer);
+		for (size_t done = 0; done < dataSize;)
+		{
+			int32_t result = 0;
+			if (_ring.active())
+			{
+				io_uring_sqe& sqe = _ring.queue();
+				sqe.opcode = IORING_OP_READ;
+				sqe.fd = _fd;
+				sqe.off = _pos + done;
+				sqe.addr = reinterpret_cast<uintptr_t>(target + done);
+				sqe.len = chunkSize(dataSize - done);
+				if (!submit(std::span{ &result, 1 }))
+					continue; // Retried synchronously
+			}
+			else
+			{
+				const auto bytesRead = ::pread(_fd, target + done, dataSize - done, static_cast<off_t>(_pos + done));
+				result = bytesRead >= 0 ? static_cast<int32_t>(bytesRead) : -errno;
+			}
+
+			if (result == -EINTR || result == -EAGAIN)
+				continue;
+			else if (result <= 0)
+				return false; // An error, or the end of the file
+
+			done += static_cast<size_t>(result);
+		}
+
+		_pos += dataSize;
+		return true;
+	}
+
+	[[nodiscard]] bool write(const void* const sourceBuffer, const size_t dataSize) noexcept
+	{
+		const ConstBuffer buffer{ .data = sourceBuffer, .size = dataSize };
+		return writeBuffers(std::span{ &buffer, 1 }, false);
+	}
+
+	// Writes all the buffers at the current position with a single submission
+	[[nodiscard]] bool writeVectored(std::span<const ConstBuffer> buffers) noexcept
+	{
+		return writeBuffers(buffers, false);
+	}
+
+	// Same as writeVectored() followed by sync(), with the fdatasync linked to the writes and submitted along with them
+	[[nodiscard]] bool writeVectoredAndSync(std::span<const ConstBuffer> buffers) noexcept
+	{
+		return writeBuffers(buffers, true);
+	}
+
+	// Registers the buffers that will be written over and over again with the kernel, which saves mapping them on every write.
+	// Replaces the previously registered buffers, an empty span only unregisters them. The buffers have to stay valid until they're replaced, unregistered or the adapter is destroyed.
+	// Returns false if registering isn't possible (no io_uring, or over the locked memory limit), the buffers are then written the regular way.
+	[[nodiscard]] bool registerBuffers(std::span<const ConstBuffer> buffers) noexcept
+	{
+		if (!_ring.active())
+			return false;
+
+		if (!_registeredBuffers.empty())
+		{
+			::syscall(__NR_io_uring_register, _ring.fd(), IORING_UNREGISTER_BUFFERS, nullptr, 0);
+			_registeredBuffers.clear();
+		}
+
+		if (buffers.empty())
+			return true;
+
+		std::vector<iovec> iov;
+		iov.reserve(buffers.size());
+		for (const auto& buffer : buffers)
+			iov.push_back(iovec{ .iov_base = const_cast<void*>(buffer.data), .iov_len = buffer.size });
+
+		if (::syscall(__NR_io_uring_register, _ring.fd(), IORING_REGISTER_BUFFERS, iov.data(), static_cast<unsigned>(iov.size())) != 0)
+			return false;
+
+		_registeredBuffers.assign(buffers.begin(), buffers.end());
+		return true;
+	}
+
+	// Whether the I/O goes through io_uring, or through the regular system calls because io_uring is not available
+	[[nodiscard]] bool ioUringActive() const noexcept
+	{
+		return _ring.active();
+	}
+
+	[[nodiscard]] size_t registeredBufferCount() const noexcept
+	{
+		return _registeredBuffers.size();
+	}
+
+	// Sets the absolute position from the beginning of the file
+	[[nodiscard]] bool seek(const uint64_t position) noexcept
+	{
+		_pos = position;
+		return true;
+	}
+
+	[[nodiscard]] bool seekToEnd() noexcept
+	{
+		struct stat fileInfo;
+		if (::fstat(_fd, &fileInfo) != 0)
+			return false;
+
+		_pos = static_cast<uint64_t>(fileInfo.st_size);
+		return true;
+	}
+
+	[[nodiscard]] uint64_t pos() const noexcept
+	{
+		return _pos;
+	}
+
+	[[nodiscard]] uint64_t size() noexcept
+	{
+		struct stat fileInfo;
+		assert_and_return_r(::fstat(_fd, &fileInfo) == 0, 0);
+		return static_cast<uint64_t>(fileInfo.st_size);
+	}
+
+	[[nodiscard]] bool atEnd() noexcept
+	{
+		return pos() == size();
+	}
+
+	// Unbuffered, nothing to flush
+	bool flush() noexcept
+	{
+		return true;
+	}
+
+	[[nodiscard]] bool sync() noexcept
+	{
+		return writeBuffers({}, true);
+	}
+
+	// Every write returns only once the data is durable (O_DSYNC). Takes effect on the next open().
+	bool setWriteThrough(const bool enable) noexcept
+	{
+		_writeThrough = enable;
+		return true;
+	}
+
+	// Allocates the space for the file of 'size' bytes in advance, so that writing into it doesn't extend the file
+	[[nodiscard]] bool preallocate(const uint64_t size) noexcept
+	{
+		return posix_detail::preallocate(_fd, size);
+	}
+
+	[[nodiscard]] bool clear() noexcept
+	{
+		assert_and_return_r(_fd >= 0 && _mode != OpenMode::Read, false);
+		_pos = 0;
+		return ::ftruncate(_fd, 0) == 0;
+	}
+
+private:
+	// Queues a write per buffer at the consecutive positions, optionally followed by fdatasync, and submits them in batches of the ring size.
+	// The requests of a batch are linked, so a failed or short write cancels the rest of them. Whatever hasn't been written is then completed synchronously.
+	[[nodiscard]] bool writeBuffers(std::span<const ConstBuffer> buffers, const bool sync) noexcept
+	{
+		if (!_ring.active())
+			return writeSynchronously(buffers, _pos) && (!sync || syncSynchronously());
+
+		for (;;)
+		{
+			const size_t batchSize = std::min<size_t>(buffers.size(), io_uring_detail::Ring::Entries - 1);
+			const bool syncInBatch = sync && batchSize == buffers.size();
+			if (batchSize == 0 && !syncInBatch)
+				return true;
+
+			uint64_t offset = _pos;
+			for (size_t i = 0; i < batchSize; ++i)
+			{
+				const ConstBuffer& buffer = buffers[i];
+				assert_and_return_r(buffer.size <= MaxRequestSize, false);
+
+				io_uring_sqe& sqe = _ring.queue();
+				const auto registeredIndex = registeredBufferIndex(buffer);
+				sqe.opcode = registeredIndex >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+				sqe.fd = _fd;
+				sqe.off = offset;
+				sqe.addr = reinterpret_cast<uintptr_t>(buffer.data);
+				sqe.len = static_cast<uint32_t>(buffer.size);
+				if (registeredIndex >= 0)
+					sqe.buf_index = static_cast<uint16_t>(registeredIndex);
+				if (i + 1 < batchSize || syncInBatch)
+					sqe.flags = IOSQE_IO_LINK;
+
+				offset += buffer.size;
+			}
+
+			if (syncInBatch)
+			{
+				io_uring_sqe& sqe = _ring.queue();
+				sqe.opcode = IORING_OP_FSYNC;
+				sqe.fd = _fd;
+				sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+			}
+
+			std::array<int32_t, io_uring_detail::Ring::Entries> results;
+			results.fill(-ECANCELED);
+			if (!submit(results))
+				return writeSynchronously(buffers, _pos) && (!sync || syncSynchronously());
+
+			for (size_t i = 0; i < batchSize; ++i)
+			{
+				const ConstBuffer& buffer = buffers[i];
+				if (results[i] < 0 && results[i] != -ECANCELED && results[i] != -EINTR && results[i] != -EAGAIN)
+					return false;
+
+				const auto written = static_cast<size_t>(std::max(results[i], 0));
+				if (written < buffer.size)
+				{
+					const ConstBuffer rest{ .data = static_cast<const std::byte*>(buffer.data) + written, .size = buffer.size - written };
+					if (!writeSynchronously(std::span{ &rest, 1 }, _pos + written))
+						return false;
+				}
+
+				_pos += buffer.size;
+			}
+
+			if (syncInBatch)
+			{
+				// Cancelled if any of the writes has fallen short
+				const int32_t syncResult = results[batchSize];
+				return syncResult == 0 || ((syncResult == -ECANCELED || syncResult == -EINTR) && syncSynchronously());
+			}
+
+			buffers = buffers.subspan(batchSize);
+		}
+	}
+
+	// Writes at 'position' without moving the current position
+	[[nodiscard]] bool writeSynchronously(std::span<const ConstBuffer> buffers, uint64_t position) noexcept
+	{
+		for (const ConstBuffer& buffer : buffers)
+		{
+			const auto* data = static_cast<const std::byte*>(buffer.data);
+			for (size_t done = 0; done < buffer.size;)
+			{
+				const auto written = ::pwrite(_fd, data + done, buffer.size - done, static_cast<off_t>(position + done));
+				if (written <= 0)
+				{
+					if (written < 0 && errno == EINTR)
+						continue;
+					return false;
+				}
+
+				done += static_cast<size_t>(written);
+			}
+
+			position += buffer.size;
+		}
+
+		return true;
+	}
+
+	[[nodiscard]] bool syncSynchronously() const noexcept
+	{
+		return ::fdatasync(_fd) == 0;
+	}
+
+	// Gives up on io_uring for good if the ring fails, the I/O is then done synchronously
+	[[nodiscard]] bool submit(const std::span<int32_t> results) noexcept
+	{
+		if (_ring.submitAndWait(results)) [[likely]]
+			return true;
+
+		_ring.destroy();
+		_ringUnavailable = true;
+		_registeredBuffers.clear();
+		return false;
+	}
+
+	// The index of the registered buffer that contains 'buffer', or -1. There are only a handful of them.
+	[[nodiscard]] int registeredBufferIndex(const ConstBuffer& buffer) const noexcept
+	{
+		const auto* begin = static_cast<const std::byte*>(buffer.data);
+		for (size_t i = 0; i < _registeredBuffers.size(); ++i)
+		{
+			const auto* registeredBegin = static_cast<const std::byte*>(_registeredBuffers[i].data);
+			if (begin >= registeredBegin && begin + buffer.size <= registeredBegin + _registeredBuffers[i].size)
+				return static_cast<int>(i);
+		}
+
+		return -1;
+	}
+
+	// A single read or write request is limited to 2 GiB - 4 KiB, same as read() and write()
+	[[nodiscard]] static uint32_t chunkSize(const size_t size) noexcept
+	{
+		return static_cast<uint32_t>(std::min<size_t>(size, MaxRequestSize));
+	}
+
+private:
+	static constexpr size_t MaxRequestSize = 0x7FFFF000;
+
+	io_uring_detail::Ring _ring;
+	std::vector<ConstBuffer> _registeredBuffers;
+
+	std::string _filePath;
+	int _fd = -1;
+	uint64_t _pos = 0;
+	OpenMode _mode = OpenMode::Read;
+	bool _writeThrough = false;
+	bool _ringUnavailable = false;
+};
+
+#else
+
+// No io_uring on this platform, the regular stdio-based I/O takes its place
+using IoUringAdapter = FopenAdapter;
+
+#endif
+
+} // namespace io
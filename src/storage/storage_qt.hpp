@@ -7,6 +7,12 @@
 #include <QBuffer>
 #include <QFile>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace io {
 
 class QFileAdapter
@@ -82,6 +88,28 @@ public:
 		return _file.flush();
 	}
 
+	[[nodiscard]] bool sync() noexcept
+	{
+		if (!_file.flush())
+			return false;
+
+#ifdef _WIN32
+		return ::_commit(_file.handle()) == 0;
+#elif defined __APPLE__
+		return ::fsync(_file.handle()) == 0;
+#else
+		return ::fdatasync(_file.handle()) == 0;
+#endif
+	}
+
+	// QFile::resize() fills the new space with zeros
+	[[nodiscard]] bool preallocate(const uint64_t size) noexcept
+	{
+		if (static_cast<uint64_t>(_file.size()) >= size)
+			return true;
+		return _file.resize(static_cast<qint64>(size));
+	}
+
 	[[nodiscard]] bool clear() noexcept
 	{
 		return _file.resize(0);
@@ -165,6 +193,11 @@ public:
 		return true;
 	}
 
+	constexpr bool sync() noexcept
+	{
+		return true;
+	}
+
 	[[nodiscard]] bool clear() noexcept
 	{
 		_dataBuffer.resize(0);
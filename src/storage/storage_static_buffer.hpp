@@ -6,6 +6,8 @@
 #include "utility/static_data_buffer.hpp"
 
 #include <mutex>
+#include <span>
+#include <string.h>
 #include <vector>
 
 namespace io {
@@ -84,6 +86,11 @@ public:
 		return true;
 	}
 
+	constexpr bool sync() noexcept
+	{
+		return true;
+	}
+
 	constexpr bool clear() noexcept
 	{
 		_buffer.reserve(0);
@@ -106,6 +113,96 @@ private:
 	bool _isOpen = false;
 };
 
+// Reads and writes a memory region owned by someone else, e. g. a slice of a larger buffer. The size is fixed, writing past the end fails.
+class SpanAdapter
+{
+public:
+	constexpr explicit SpanAdapter(const std::span<std::byte> region) noexcept :
+		_region{ region }
+	{}
+
+	constexpr bool open(std::string_view /*fileName*/, const OpenMode /*mode*/) noexcept
+	{
+		assert_and_return_r(!_isOpen, false);
+		_isOpen = true;
+		return true;
+	}
+
+	constexpr bool close() noexcept
+	{
+		if (_isOpen)
+		{
+			_pos = 0;
+			_isOpen = false;
+		}
+		return true;
+	}
+
+	inline bool read(void* targetBuffer, const size_t dataSize) noexcept
+	{
+		assert_and_return_r(dataSize <= _region.size() - _pos, false);
+		::memcpy(targetBuffer, _region.data() + _pos, dataSize);
+		_pos += dataSize;
+		return true;
+	}
+
+	inline bool write(const void* sourceBuffer, const size_t dataSize) noexcept
+	{
+		assert_and_return_r(dataSize <= _region.size() - _pos, false);
+		::memcpy(_region.data() + _pos, sourceBuffer, dataSize);
+		_pos += dataSize;
+		return true;
+	}
+
+	// Sets the absolute position from the beginning of the region
+	constexpr bool seek(const size_t position) & noexcept
+	{
+		assert_and_return_r(position <= _region.size(), false);
+		_pos = position;
+		return true;
+	}
+
+	constexpr bool seekToEnd() & noexcept
+	{
+		return seek(_region.size());
+	}
+
+	[[nodiscard]] constexpr uint64_t pos() const noexcept
+	{
+		return _pos;
+	}
+
+	[[nodiscard]] constexpr uint64_t size() const noexcept
+	{
+		return _region.size();
+	}
+
+	[[nodiscard]] constexpr bool atEnd() const noexcept
+	{
+		return _pos == _region.size();
+	}
+
+	constexpr bool flush() noexcept
+	{
+		return true;
+	}
+
+	constexpr bool sync() noexcept
+	{
+		return true;
+	}
+
+	[[nodiscard]] constexpr std::byte* data() const noexcept
+	{
+		return _region.data();
+	}
+
+private:
+	const std::span<std::byte> _region;
+	size_t _pos = 0;
+	bool _isOpen = false;
+};
+
 class VectorAdapter
 {
 public:
@@ -157,6 +254,27 @@ public:
 		return true;
 	}
 
+	inline bool writeVectored(std::span<const ConstBuffer> buffers) noexcept
+	{
+		std::lock_guard lock(_mtx);
+
+		size_t totalSize = 0;
+		for (const auto& buffer : buffers)
+			totalSize += buffer.size;
+
+		// Grow once for all the buffers
+		if (const auto newSize = _pos + totalSize; newSize > _data.capacity())
+			_data.reserve(newSize + newSize / 4 + 1);
+
+		for (const auto& buffer : buffers)
+		{
+			if (!write(buffer.data, buffer.size))
+				return false;
+		}
+
+		return true;
+	}
+
 	// Sets the absolute position from the beginning of the file
 	inline bool seek(const size_t position) & noexcept
 	{
@@ -195,11 +313,33 @@ public:
 		return pos() == size();
 	}
 
+	// Invalidated by the writes that grow the data
+	[[nodiscard]] inline const std::byte* data() const noexcept
+	{
+		std::lock_guard lock(_mtx);
+
+		return _data.data();
+	}
+
 	inline constexpr bool flush() noexcept
 	{
 		return true;
 	}
 
+	inline constexpr bool sync() noexcept
+	{
+		return true;
+	}
+
+	inline bool preallocate(const size_t newSize) noexcept
+	{
+		std::lock_guard lock(_mtx);
+
+		if (newSize > _data.size())
+			_data.resize(newSize); // Zero-initialized
+		return true;
+	}
+
 private:
 	mutable std::recursive_mutex _mtx;
 	std::vector<std::byte> _data;
@@ -1,13 +1,57 @@
 #pragma once
 
+#include "io_base_definitions.hpp"
+
 #include "assert/advanced_assert.h"
 
+#include <algorithm>
+#include <array>
+#include <span>
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <string_view>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 namespace io {
 
+#ifndef _WIN32
+namespace posix_detail {
+
+// Allocates the space for the file of 'size' bytes in advance (fallocate() where available), so that writing into it doesn't extend the file
+[[nodiscard]] inline bool preallocate(const int fd, const uint64_t size) noexcept
+{
+#ifdef __linux__
+	// Mode 0 extends the file size as well, so the new space reads as zeros
+	int result = 0;
+	do {
+		result = ::fallocate(fd, 0, 0, static_cast<off_t>(size));
+	} while (result != 0 && errno == EINTR);
+
+	if (result == 0)
+		return true;
+	else if (errno != EOPNOTSUPP)
+		return false;
+	// The file system can't allocate in advance, extending the file is the best that can be done
+#endif
+	struct stat fileInfo;
+	if (::fstat(fd, &fileInfo) != 0)
+		return false;
+	return static_cast<uint64_t>(fileInfo.st_size) >= size || ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+} // namespace posix_detail
+#endif
+
 class FopenAdapter
 {
 public:
@@ -23,12 +67,13 @@ public:
 			_handle = ::fopen(_filePath.c_str(), "rb");
 			break;
 		case OpenMode::Write:
-			_handle = ::fopen(_filePath.c_str(), "wb");
+			_handle = openFile("wb");
 			break;
 		case OpenMode::ReadWrite:
-			_handle = ::fopen(_filePath.c_str(), truncate ? "w+b" : "a+b");
-			if (!truncate && _handle)
-				(void)seek(0); // a+ is append mode - sets the cursor to the end, so need to seek to start manually
+			// Not "a+b": append mode sends every write to the end of the file, including the positional ones (pwritev)
+			_handle = truncate ? openFile("w+b") : openFile("r+b");
+			if (!_handle && !truncate)
+				_handle = openFile("w+b"); // r+ requires the file to exist
 			break;
 		default:
 			assert_and_return_unconditional_r("Unknown open mode " + std::to_string(static_cast<int>(mode)), false);
@@ -59,6 +104,62 @@ public:
 		return ::fwrite(targetBuffer, 1, dataSize, _handle) == dataSize;
 	}
 
+#ifndef _WIN32
+	// Writes all the buffers at the current position with pwritev(), bypassing the stdio buffer
+	[[nodiscard]] bool writeVectored(std::span<const ConstBuffer> buffers) noexcept
+	{
+		// Whatever stdio has buffered must land in the file first
+		if (::fflush(_handle) != 0)
+			return false;
+
+		const int fd = ::fileno(_handle);
+		auto offset = static_cast<off_t>(pos());
+
+		std::array<iovec, 64> iov;
+		for (size_t bufferIndex = 0; bufferIndex < buffers.size();)
+		{
+			const size_t batchSize = std::min(iov.size(), buffers.size() - bufferIndex);
+			for (size_t i = 0; i < batchSize; ++i)
+				iov[i] = iovec{ .iov_base = const_cast<void*>(buffers[bufferIndex + i].data), .iov_len = buffers[bufferIndex + i].size };
+
+			iovec* pending = iov.data();
+			int pendingCount = static_cast<int>(batchSize);
+			while (pendingCount > 0)
+			{
+				const auto written = ::pwritev(fd, pending, pendingCount, offset);
+				if (written <= 0)
+				{
+					if (written < 0 && errno == EINTR)
+						continue;
+					return false;
+				}
+
+				offset += written;
+
+				// Skip the buffers that have been written completely, then retry the rest of the partially written one
+				auto remaining = static_cast<size_t>(written);
+				while (pendingCount > 0 && remaining >= pending->iov_len)
+				{
+					remaining -= pending->iov_len;
+					++pending;
+					--pendingCount;
+				}
+
+				if (pendingCount > 0)
+				{
+					pending->iov_base = static_cast<char*>(pending->iov_base) + remaining;
+					pending->iov_len -= remaining;
+				}
+			}
+
+			bufferIndex += batchSize;
+		}
+
+		// Keep the stdio position in sync with the file
+		return ::fseek(_handle, static_cast<long>(offset), SEEK_SET) == 0;
+	}
+#endif
+
 	// Sets the absolute position from the beginning of the file
 	[[nodiscard]] bool seek(const uint64_t position) noexcept
 	{
@@ -97,6 +198,44 @@ public:
 		return ::fflush(_handle) == 0;
 	}
 
+	// Flushes the stdio buffer and makes the file contents durable
+	[[nodiscard]] bool sync() noexcept
+	{
+		if (::fflush(_handle) != 0)
+			return false;
+
+#ifdef _WIN32
+		return ::_commit(::_fileno(_handle)) == 0;
+#elif defined __APPLE__
+		return ::fsync(::fileno(_handle)) == 0;
+#else
+		return ::fdatasync(::fileno(_handle)) == 0;
+#endif
+	}
+
+	// Every write (that is, every stdio buffer flush) returns only once the data is durable: O_DSYNC, or the commit flag on Windows.
+	// Takes effect on the next open().
+	bool setWriteThrough(const bool enable) noexcept
+	{
+		_writeThrough = enable;
+		return true;
+	}
+
+	// Allocates the space for the file of 'size' bytes in advance (fallocate() where available), so that writing into it doesn't extend the file
+	[[nodiscard]] bool preallocate(const uint64_t size) noexcept
+	{
+		if (::fflush(_handle) != 0)
+			return false;
+
+#ifdef _WIN32
+		if (static_cast<uint64_t>(::_filelengthi64(::_fileno(_handle))) >= size)
+			return true;
+		return ::_chsize_s(::_fileno(_handle), static_cast<__int64>(size)) == 0;
+#else
+		return posix_detail::preallocate(::fileno(_handle), size);
+#endif
+	}
+
 	[[nodiscard]] bool clear() noexcept
 	{
 		assert_and_return_r(close(), false);
@@ -104,6 +243,32 @@ public:
 	}
 
 private:
+	// Opens the file for writing, honoring the write-through setting
+	[[nodiscard]] FILE* openFile(const std::string& stdioMode) const noexcept
+	{
+		if (!_writeThrough)
+			return ::fopen(_filePath.c_str(), stdioMode.c_str());
+
+#ifdef _WIN32
+		return ::fopen(_filePath.c_str(), (stdioMode + 'c').c_str());
+#else
+		int flags = O_CREAT | O_DSYNC | (stdioMode.find('+') != std::string::npos ? O_RDWR : O_WRONLY);
+		if (stdioMode.front() == 'a')
+			flags |= O_APPEND;
+		else if (stdioMode.front() == 'w')
+			flags |= O_TRUNC;
+
+		const int fd = ::open(_filePath.c_str(), flags, 0644);
+		if (fd < 0)
+			return nullptr;
+
+		FILE* handle = ::fdopen(fd, stdioMode.c_str());
+		if (!handle)
+			::close(fd);
+		return handle;
+#endif
+	}
+
 	static void toNativePath(std::string& path) noexcept
 	{
 #ifdef _WIN32
@@ -121,6 +286,7 @@ private:
 	std::string _filePath;
 	FILE* _handle = nullptr;
 	OpenMode _mode;
+	bool _writeThrough = false;
 };
 
 } // namespace io
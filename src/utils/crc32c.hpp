@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPPDB_CRC32C_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define CPPDB_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+// CRC-32C (Castagnoli), the checksum used by iSCSI, ext4 and others, with the initial value and the final XOR of 0xFFFFFFFF.
+// Computed with the CRC32 instructions of SSE 4.2 when the CPU has them (detected at run time), or with those of ARMv8 when the target has them (detected at compile time).
+// Otherwise, a table-driven implementation processing 8 bytes per step is used.
+namespace crc32c_detail {
+
+inline constexpr uint32_t Polynomial = 0x82F63B78; // Bit-reversed 0x1EDC6F41
+
+// Table #k gives the CRC of a byte followed by k zero bytes
+inline constexpr auto Tables = [] {
+	std::array<std::array<uint32_t, 256>, 8> tables{};
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ ((crc & 1) != 0 ? Polynomial : 0);
+		tables[0][i] = crc;
+	}
+
+	for (size_t k = 1; k < tables.size(); ++k)
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+			tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+	}
+
+	return tables;
+}();
+
+[[nodiscard]] inline uint32_t updateSoftware(uint32_t crc, const uint8_t* data, size_t size) noexcept
+{
+	for (; size >= 8; size -= 8, data += 8)
+	{
+		uint32_t low = 0, high = 0;
+		::memcpy(&low, data, 4);
+		::memcpy(&high, data + 4, 4);
+		low ^= crc; // Assumes a little-endian CPU, as the rest of the storage format does
+
+		crc = Tables[7][low & 0xFF] ^ Tables[6][(low >> 8) & 0xFF] ^ Tables[5][(low >> 16) & 0xFF] ^ Tables[4][low >> 24]
+			^ Tables[3][high & 0xFF] ^ Tables[2][(high >> 8) & 0xFF] ^ Tables[1][(high >> 16) & 0xFF] ^ Tables[0][high >> 24];
+	}
+
+	for (; size > 0; --size, ++data)
+		crc = (crc >> 8) ^ Tables[0][(crc ^ *data) & 0xFF];
+
+	return crc;
+}
+
+#if defined(CPPDB_CRC32C_X86)
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+[[nodiscard]] inline uint32_t updateHardware(uint32_t crc, const uint8_t* data, size_t size) noexcept
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64_t crc64 = crc;
+	for (; size >= 8; size -= 8, data += 8)
+	{
+		uint64_t word = 0;
+		::memcpy(&word, data, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = static_cast<uint32_t>(crc64);
+#endif
+
+	for (; size >= 4; size -= 4, data += 4)
+	{
+		uint32_t word = 0;
+		::memcpy(&word, data, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+	}
+
+	for (; size > 0; --size, ++data)
+		crc = _mm_crc32_u8(crc, *data);
+
+	return crc;
+}
+
+[[nodiscard]] inline bool hardwareSupported() noexcept
+{
+#ifdef _MSC_VER
+	int info[4]{};
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#elif defined(CPPDB_CRC32C_ARM)
+
+[[nodiscard]] inline uint32_t updateHardware(uint32_t crc, const uint8_t* data, size_t size) noexcept
+{
+	for (; size >= 8; size -= 8, data += 8)
+	{
+		uint64_t word = 0;
+		::memcpy(&word, data, sizeof(word));
+		crc = __crc32cd(crc, word);
+	}
+
+	for (; size > 0; --size, ++data)
+		crc = __crc32cb(crc, *data);
+
+	return crc;
+}
+
+[[nodiscard]] constexpr bool hardwareSupported() noexcept
+{
+	return true;
+}
+
+#else
+
+[[nodiscard]] inline uint32_t updateHardware(uint32_t crc, const uint8_t* data, size_t size) noexcept
+{
+	return updateSoftware(crc, data, size);
+}
+
+[[nodiscard]] constexpr bool hardwareSupported() noexcept
+{
+	return false;
+}
+
+#endif
+
+} // namespace crc32c_detail
+
+// Whether crc32c() uses the CPU instructions
+[[nodiscard]] inline bool crc32cHardwareAccelerated() noexcept
+{
+	static const bool supported = crc32c_detail::hardwareSupported();
+	return supported;
+}
+
+[[nodiscard]] inline uint32_t crc32c(const void* data, const size_t size) noexcept
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	const uint32_t crc = crc32cHardwareAccelerated() ? crc32c_detail::updateHardware(0xFFFFFFFF, bytes, size) : crc32c_detail::updateSoftware(0xFFFFFFFF, bytes, size);
+	return ~crc;
+}
+
+// Always table-driven, for testing and benchmarking
+[[nodiscard]] inline uint32_t crc32cSoftware(const void* data, const size_t size) noexcept
+{
+	return ~crc32c_detail::updateSoftware(0xFFFFFFFF, static_cast<const uint8_t*>(data), size);
+}
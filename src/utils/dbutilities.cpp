@@ -1,18 +1,107 @@
 #include "dbutilities.hpp"
 #include "assert/advanced_assert.h"
 
+#include <bit>
+#include <filesystem>
 #include <stdexcept>
 
-static size_t queryBlockSize()
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <fstream>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+// Anything else is the file system's preferred I/O size rather than the device block size (e.g. ZFS record size)
+static bool plausibleBlockSize(const size_t size)
+{
+	return size >= 512 && size <= 64 * 1024 && std::has_single_bit(size);
+}
+
+// The file may not exist yet, the directory it goes to does
+static std::string existingPath(const std::string& path)
+{
+	std::error_code ec;
+	if (std::filesystem::exists(path, ec))
+		return path;
+
+	const auto parent = std::filesystem::path{ path }.parent_path();
+	return parent.empty() ? std::string{ "." } : parent.string();
+}
+
+#ifdef __linux__
+static size_t readSysfsBlockSize(const std::string& fileName)
 {
-	// TODO: implement!
-	return 4096;
+	std::ifstream file{ fileName };
+	size_t size = 0;
+	return (file >> size) ? size : 0;
+}
+#endif
+
+size_t queryBlockSize(const std::string& path)
+{
+	const std::string target = existingPath(path);
+
+#ifdef _WIN32
+	char volumePath[MAX_PATH + 1]{};
+	if (!::GetVolumePathNameA(target.c_str(), volumePath, MAX_PATH))
+		return 0;
+
+	DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+	if (!::GetDiskFreeSpaceA(volumePath, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters))
+		return 0;
+
+	return plausibleBlockSize(bytesPerSector) ? bytesPerSector : 0;
+#else
+	struct stat fileStat {};
+	if (::stat(target.c_str(), &fileStat) != 0)
+		return 0;
+
+#ifdef __linux__
+	if (S_ISBLK(fileStat.st_mode))
+	{
+		// The log is the raw device itself
+		const int fd = ::open(target.c_str(), O_RDONLY);
+		if (fd < 0)
+			return 0;
+
+		unsigned int physicalBlockSize = 0;
+		const bool ok = ::ioctl(fd, BLKPBSZGET, &physicalBlockSize) == 0;
+		::close(fd);
+		return ok && plausibleBlockSize(physicalBlockSize) ? physicalBlockSize : 0;
+	}
+
+	// The device holding the file system. A partition has no queue of its own, it's its parent's.
+	const std::string deviceDir = "/sys/dev/block/" + std::to_string(major(fileStat.st_dev)) + ':' + std::to_string(minor(fileStat.st_dev));
+	for (const char* queueDir : { "/queue", "/../queue" })
+	{
+		const size_t physicalBlockSize = readSysfsBlockSize(deviceDir + queueDir + "/physical_block_size");
+		if (plausibleBlockSize(physicalBlockSize))
+			return physicalBlockSize;
+	}
+#endif
+
+	// No block device behind the file system (tmpfs, network file systems), or not Linux
+	struct statvfs fsStat {};
+	if (::statvfs(target.c_str(), &fsStat) != 0)
+		return 0;
+
+	return plausibleBlockSize(fsStat.f_bsize) ? static_cast<size_t>(fsStat.f_bsize) : 0;
+#endif
 }
 
-void checkBlockSize()
+bool checkBlockSize(const std::string& path, const size_t blockSize)
 {
-	if (queryBlockSize() != 4096)
-		fatalAbort("Unexpected cluster size!!!");
+	const size_t deviceBlockSize = queryBlockSize(path);
+	return deviceBlockSize == 0 || blockSize % deviceBlockSize == 0;
 }
 
 void fatalAbort(std::string_view message)
@@ -1,6 +1,12 @@
 #pragma once
+#include <stddef.h>
+#include <string>
 #include <string_view>
 
-void checkBlockSize();
+// The block size of the storage device holding 'path', or of the device the file would be created on: the unit the device writes atomically.
+// 0 if it can't be determined.
+size_t queryBlockSize(const std::string& path);
+// Whether blocks of 'blockSize' bytes are made of whole device blocks. True if the device block size is unknown.
+bool checkBlockSize(const std::string& path, size_t blockSize);
 
 void fatalAbort(std::string_view message);
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads for data-parallel loops. run(count, task) calls task(i) for every i in [0, count) and returns once all the calls are done.
+// The calling thread takes part in the work, so a pool of N threads only starts N - 1 of them, and a pool of 1 runs everything inline.
+// Only one thread is supposed to call run() at a time.
+class WorkerPool final
+{
+public:
+	// 0 = one thread per hardware core
+	explicit WorkerPool(size_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		_threads.reserve(threadCount - 1);
+		for (size_t i = 1; i < threadCount; ++i)
+			_threads.emplace_back(&WorkerPool::workerFunction, this);
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard lock(_mtx);
+			_terminate = true;
+		}
+		_cvStart.notify_all();
+
+		for (auto& thread : _threads)
+			thread.join();
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	[[nodiscard]] size_t threadCount() const noexcept
+	{
+		return _threads.size() + 1;
+	}
+
+	// task(i) returns false to report a failure. The remaining calls are then skipped, and run() returns false.
+	template <typename Task>
+	[[nodiscard]] bool run(const size_t count, Task&& task)
+	{
+		if (_threads.empty() || count <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!task(i))
+					return false;
+			}
+			return true;
+		}
+
+		{
+			std::lock_guard lock(_mtx);
+			_task = std::ref(task);
+			_count = count;
+			_next = 0;
+			_failed = false;
+			_activeWorkers = _threads.size();
+			++_generation;
+		}
+		_cvStart.notify_all();
+
+		processTasks();
+
+		std::unique_lock lock(_mtx);
+		_cvDone.wait(lock, [this] { return _activeWorkers == 0; });
+		_task = nullptr;
+		return !_failed;
+	}
+
+private:
+	void workerFunction()
+	{
+		uint64_t lastGeneration = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock lock(_mtx);
+				_cvStart.wait(lock, [&] { return _terminate || _generation != lastGeneration; });
+				if (_terminate)
+					return;
+
+				lastGeneration = _generation;
+			}
+
+			processTasks();
+
+			bool lastToFinish = false;
+			{
+				std::lock_guard lock(_mtx);
+				lastToFinish = --_activeWorkers == 0;
+			}
+			if (lastToFinish)
+				_cvDone.notify_one();
+		}
+	}
+
+	void processTasks()
+	{
+		for (size_t i = _next.fetch_add(1, std::memory_order_relaxed); i < _count; i = _next.fetch_add(1, std::memory_order_relaxed))
+		{
+			if (_failed.load(std::memory_order_relaxed))
+				return;
+
+			if (!_task(i))
+				_failed = true;
+		}
+	}
+
+private:
+	std::vector<std::thread> _threads;
+	std::function<bool(size_t)> _task;
+
+	std::mutex _mtx;
+	std::condition_variable _cvStart;
+	std::condition_variable _cvDone;
+
+	std::atomic<size_t> _next{ 0 };
+	std::atomic<bool> _failed{ false };
+	size_t _count = 0; // Written under _mtx before the workers are started, read-only while they run
+	size_t _activeWorkers = 0;
+	uint64_t _generation = 0;
+	bool _terminate = false;
+};
@@ -0,0 +1,79 @@
+#include "3rdparty/catch2/catch.hpp"
+#include "dbrecord.hpp"
+#include "serialization/dbrecord-serializer.hpp"
+#include "storage/storage_static_buffer.hpp"
+#include "storage/storage_std.hpp"
+#include "utils/dbutilities.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+TEST_CASE("DbRecordSerializer throughput: array-heavy records", "[.benchmark][dbrecord]")
+{
+	using ArrayHeavyRecord = DbRecord<Field<uint64_t, 61>, Field<std::string, 62>, Field<uint32_t, 63, true>, Field<double, 64, true>, Field<uint16_t, 65, true>>;
+	using RecordSerializer = DbRecordSerializer<ArrayHeavyRecord>;
+	static constexpr size_t NRecords = 20'000;
+	static constexpr const char* filePath = "./record_serializer_benchmark.bin";
+
+	std::vector<ArrayHeavyRecord> records;
+	records.reserve(NRecords);
+	for (size_t i = 0; i < NRecords; ++i)
+		records.emplace_back(uint64_t{ i }, "record-" + std::to_string(i), std::vector<uint32_t>(256, static_cast<uint32_t>(i)), std::vector<double>(64, 0.5), std::vector<uint16_t>(i % 128, 1));
+
+	size_t totalBytes = 0;
+	for (const auto& record : records)
+		totalBytes += record.totalSize();
+
+	const auto report = [&](const char* adapterName, const std::chrono::steady_clock::duration time) {
+		const auto timeNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+		printf("%-8s %.0f ns per record, %.0f MiB/s\n", adapterName, timeNs / NRecords, static_cast<double>(totalBytes) / (1024.0 * 1024.0) / (timeNs * 1e-9));
+	};
+
+	for (size_t pass = 0; pass < 2; ++pass)
+	{
+		{
+			io::VectorAdapter buffer(totalBytes);
+			StorageIO io{ buffer };
+			const auto timeStart = std::chrono::steady_clock::now();
+			for (const auto& record : records)
+			{
+				if (!RecordSerializer::serialize(record, io))
+					fatalAbort("serialize() failed!");
+			}
+			report("memory:", std::chrono::steady_clock::now() - timeStart);
+			REQUIRE(buffer.size() == totalBytes);
+
+			REQUIRE(io.seek(0));
+			ArrayHeavyRecord record;
+			size_t checksum = 0;
+			const auto readStart = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < NRecords; ++i)
+			{
+				if (!RecordSerializer::deserialize(record, io))
+					fatalAbort("deserialize() failed!");
+				checksum += record.fieldAtIndex<2>().value.size();
+			}
+			report("reading:", std::chrono::steady_clock::now() - readStart);
+			REQUIRE(checksum == NRecords * 256);
+		}
+
+		{
+			io::FopenAdapter file;
+			StorageIO io{ file };
+			REQUIRE(io.open(filePath, io::OpenMode::Write));
+			const auto timeStart = std::chrono::steady_clock::now();
+			for (const auto& record : records)
+			{
+				if (!RecordSerializer::serialize(record, io))
+					fatalAbort("serialize() failed!");
+			}
+			REQUIRE(io.flush());
+			report("stdio:", std::chrono::steady_clock::now() - timeStart);
+			REQUIRE(io.pos() == totalBytes);
+		}
+		CHECK(std::filesystem::remove(filePath));
+	}
+}
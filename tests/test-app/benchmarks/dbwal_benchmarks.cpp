@@ -0,0 +1,663 @@
+#include "3rdparty/catch2/catch.hpp"
+#include "dbwal.hpp"
+#include "storage/storage_io_uring.hpp"
+#include "storage/storage_static_buffer.hpp"
+#include "storage/storage_std.hpp"
+
+#include "system/timing.h"
+#include "threading/thread_helpers.h"
+#include "utility/integer_literals.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// CPU time consumed by all the threads of the process
+static uint64_t processCpuTimeUs() noexcept
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	const auto toUs = [](const FILETIME& t) {
+		return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10; // 100 ns units
+	};
+	return toUs(kernel) + toUs(user);
+#else
+	timespec t;
+	if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0)
+		return 0;
+
+	return static_cast<uint64_t>(t.tv_sec) * 1'000'000 + static_cast<uint64_t>(t.tv_nsec) / 1000;
+#endif
+}
+
+namespace {
+
+using F64 = Field<uint64_t, 1>;
+using FString = Field<std::string, 2>;
+using BenchmarkRecord = DbRecord<F64, FString>;
+
+struct CommitCost {
+	double cpuUsPerOp = 0.0;
+	double wallTimeMs = 0.0;
+	WAL::Stats stats;
+};
+
+template <class StorageAdapter>
+CommitCost measureCommitCost(StorageAdapter& walIoDevice, const std::string& walFilePath, const WAL::Options& options, const size_t nThreads, const size_t nOpsPerThread)
+{
+	DbWAL<BenchmarkRecord, StorageAdapter> wal{ walIoDevice, options };
+	REQUIRE(wal.openLogFile(walFilePath));
+
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string{ "Benchmark record payload" } } };
+
+	const auto threadFunction = [&] {
+		for (size_t i = 0; i < nOpsPerThread; ++i)
+		{
+			if (!wal.registerOperation(op))
+				fatalAbort("registerOperation() failed!");
+		}
+	};
+
+	const auto cpuTimeStart = processCpuTimeUs();
+	const auto wallTimeStart = timeElapsedMs();
+
+	std::deque<std::thread> threads;
+	for (size_t i = 0; i < nThreads; ++i)
+		threads.emplace_back(threadFunction);
+	joinAll(threads);
+
+	CommitCost cost;
+	cost.wallTimeMs = static_cast<double>(timeElapsedMs() - wallTimeStart);
+	cost.cpuUsPerOp = static_cast<double>(processCpuTimeUs() - cpuTimeStart) / static_cast<double>(nThreads * nOpsPerThread);
+
+	REQUIRE(wal.closeLogFile());
+	cost.stats = wal.stats();
+	return cost;
+}
+
+CommitCost measureCommitCost(const WAL::Options& options, const size_t nThreads, const size_t nOpsPerThread)
+{
+	io::VectorAdapter walData(nThreads * nOpsPerThread * 64);
+	return measureCommitCost(walData, {}, options, nThreads, nOpsPerThread);
+}
+
+} // namespace
+
+TEST_CASE("DbWAL flush waiting: parking vs. spinning", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperationsPerThread = 100;
+
+	for (const size_t nThreads : { 1, 8, 64 })
+	{
+		WAL::Options options;
+
+		options.flushWaitMode = WAL::FlushWaitMode::Spin;
+		const auto spin = measureCommitCost(options, nThreads, NOperationsPerThread);
+
+		options.flushWaitMode = WAL::FlushWaitMode::Park;
+		const auto park = measureCommitCost(options, nThreads, NOperationsPerThread);
+
+		printf("%2lu threads: spinning - %.1f us CPU per op (%.0f ms total), parking - %.1f us CPU per op (%.0f ms total)\n",
+			(unsigned long)nThreads, spin.cpuUsPerOp, spin.wallTimeMs, park.cpuUsPerOp, park.wallTimeMs);
+	}
+}
+
+TEST_CASE("DbWAL append throughput", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperationsPerThread = 2000;
+
+	for (const size_t nThreads : { 1, 2, 4, 8, 16, 32 })
+	{
+		// Sealing a block as soon as every thread has put an entry into it takes the timeout out of the picture
+		WAL::Options options;
+		options.flushThresholdOps = static_cast<uint32_t>(nThreads);
+
+		const auto cost = measureCommitCost(options, nThreads, NOperationsPerThread);
+		const double opsPerSecond = static_cast<double>(nThreads * NOperationsPerThread) * 1000.0 / std::max(cost.wallTimeMs, 1.0);
+		printf("%2lu threads: %.0f ops/s, %.1f us CPU per op\n", (unsigned long)nThreads, opsPerSecond, cost.cpuUsPerOp);
+	}
+}
+
+TEST_CASE("DbWAL durability modes", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NThreads = 8;
+	static constexpr size_t NOperationsPerThread = 250;
+	static constexpr const char* walFilePath = "./dbwal_benchmark.log";
+
+	static constexpr std::pair<WAL::Durability, const char*> modes[]{
+		{ WAL::Durability::SyncPerCommit, "sync per commit" },
+		{ WAL::Durability::WriteThrough, "write-through" },
+		{ WAL::Durability::Periodic, "periodic sync" },
+		{ WAL::Durability::None, "no sync" },
+	};
+
+	for (const auto& [durability, name] : modes)
+	{
+		WAL::Options options;
+		options.durability = durability;
+		options.flushThresholdOps = NThreads;
+
+		io::FopenAdapter walFile;
+		const auto cost = measureCommitCost(walFile, walFilePath, options, NThreads, NOperationsPerThread);
+		const double opsPerSecond = static_cast<double>(NThreads * NOperationsPerThread) * 1000.0 / std::max(cost.wallTimeMs, 1.0);
+		printf("%-16s %.0f ops/s, %.1f us CPU per op\n", name, opsPerSecond, cost.cpuUsPerOp);
+
+		CHECK(std::filesystem::remove(walFilePath));
+	}
+}
+
+TEST_CASE("DbWAL io_uring vs. stdio", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperationsPerThread = 1000;
+	static constexpr const char* walFilePath = "./dbwal_benchmark.log";
+
+	for (const auto durability : { WAL::Durability::SyncPerCommit, WAL::Durability::None })
+	{
+		for (const size_t nThreads : { 1_z, 8_z })
+		{
+			WAL::Options options;
+			options.durability = durability;
+			options.flushThresholdOps = static_cast<uint32_t>(nThreads);
+			// The segments are overwritten in place, as a long-running log would be
+			options.segmentBlocks = 256;
+
+			const auto report = [&](const char* adapterName, const CommitCost& cost) {
+				const double opsPerSecond = static_cast<double>(nThreads * NOperationsPerThread) * 1000.0 / std::max(cost.wallTimeMs, 1.0);
+				printf("%-8s %s, %zu thread(s): %.0f ops/s, %.1f us CPU per op\n", adapterName, durability == WAL::Durability::None ? "no sync" : "sync per commit", nThreads, opsPerSecond, cost.cpuUsPerOp);
+			};
+
+			{
+				io::FopenAdapter walFile;
+				report("stdio", measureCommitCost(walFile, walFilePath, options, nThreads, NOperationsPerThread));
+			}
+			CHECK(std::filesystem::remove(walFilePath));
+
+			{
+				io::IoUringAdapter walFile;
+				report("io_uring", measureCommitCost(walFile, walFilePath, options, nThreads, NOperationsPerThread));
+			}
+			CHECK(std::filesystem::remove(walFilePath));
+		}
+	}
+}
+
+TEST_CASE("DbWAL batch registration", "[.benchmark][dbwal]")
+{
+	// A single writer that can't group-commit with anyone else: every call pays the flush timeout
+	static constexpr size_t NOperations = 2000;
+
+	WAL::Options options;
+	options.flushTimeoutMs = 1;
+
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string{ "Benchmark record payload" } } };
+	const std::vector<Operation::Insert<BenchmarkRecord>> ops(NOperations, op);
+
+	for (const size_t batchSize : { 1_z, 10_z, 100_z, 1000_z })
+	{
+		io::VectorAdapter walData(NOperations * 64);
+		DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+		REQUIRE(wal.openLogFile({}));
+
+		const auto wallTimeStart = timeElapsedMs();
+		for (size_t i = 0; i < NOperations; i += batchSize)
+			REQUIRE(wal.registerOperations(std::span{ ops }.subspan(i, batchSize)));
+		const auto wallTimeMs = static_cast<double>(timeElapsedMs() - wallTimeStart);
+
+		REQUIRE(wal.closeLogFile());
+		printf("Batch size %4zu: %.0f ops/s\n", batchSize, static_cast<double>(NOperations) * 1000.0 / std::max(wallTimeMs, 1.0));
+	}
+}
+
+TEST_CASE("DbWAL verification", "[.benchmark][dbwal]")
+{
+	// Most of the operations have completed, as is the case after a normal shutdown
+	static constexpr size_t BatchSize = 1000;
+	static constexpr size_t NThreads = 8;
+
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string{ "Benchmark record payload" } } };
+	const std::vector<Operation::Insert<BenchmarkRecord>> ops(BatchSize, op);
+
+	for (const size_t nOperations : { 16'000_z, 160'000_z })
+	{
+		io::VectorAdapter walData(nOperations * 64);
+
+		WAL::Options options;
+		options.flushTimeoutMs = 1;
+		options.flushThresholdOps = NThreads;
+
+		{
+			DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+			REQUIRE(wal.openLogFile({}));
+
+			// The completion markers are logged by several threads so that they share the blocks
+			const auto threadFunction = [&] {
+				for (size_t i = 0; i < nOperations / NThreads; i += BatchSize)
+				{
+					const auto firstId = wal.registerOperations(std::span{ ops });
+					if (!firstId)
+						fatalAbort("registerOperations() failed!");
+
+					// Leaving every 100th operation pending
+					for (size_t k = 0; k < BatchSize; ++k)
+					{
+						if (k % 100 != 0 && !wal.updateOpStatus(*firstId + static_cast<WAL::OpID>(k), WAL::OpStatus::Successful))
+							fatalAbort("updateOpStatus() failed!");
+					}
+				}
+			};
+
+			std::deque<std::thread> threads;
+			for (size_t i = 0; i < NThreads; ++i)
+				threads.emplace_back(threadFunction);
+			joinAll(threads);
+
+			REQUIRE(wal.closeLogFile());
+		}
+
+		for (const auto& [mode, nVerificationThreads] : { std::pair{ WAL::VerificationMode::TwoPass, 1u }, std::pair{ WAL::VerificationMode::SinglePass, 1u }, std::pair{ WAL::VerificationMode::TwoPass, 4u }, std::pair{ WAL::VerificationMode::SinglePass, 4u } })
+		{
+			options.verificationMode = mode;
+			options.verificationThreads = nVerificationThreads;
+			DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+			REQUIRE(wal.openLogFile({}));
+
+			size_t nPending = 0;
+			const auto timeStart = timeElapsedMs();
+			REQUIRE(wal.verifyLog([&](auto&&) { ++nPending; }));
+			const auto timeMs = timeElapsedMs() - timeStart;
+
+			REQUIRE(nPending == nOperations / 100);
+			REQUIRE(wal.closeLogFile());
+
+			printf("%zu operations, %lu KiB log, %s, %u thread(s): %lu ms\n", nOperations, static_cast<unsigned long>(walData.size() / 1024), mode == WAL::VerificationMode::TwoPass ? "two passes" : "single pass", nVerificationThreads, static_cast<unsigned long>(timeMs));
+		}
+	}
+}
+
+TEST_CASE("DbWAL pending operation tracking", "[.benchmark][dbwal]")
+{
+	// Tens of thousands of operations in flight, completing out of order, with the checkpoint looked up every time
+	static constexpr size_t NOperations = 20'000;
+	static constexpr size_t CompletionLag = 1000;
+
+	std::vector<WAL::OpID> completionOrder;
+	for (size_t i = 0; i < NOperations; i += CompletionLag)
+	{
+		for (size_t k = CompletionLag; k-- > 0;)
+			completionOrder.push_back(static_cast<WAL::OpID>(1 + i + k));
+	}
+
+	const auto measure = [&](auto&& insert, auto&& remove, auto&& oldest) {
+		const auto timeStart = timeElapsedMs();
+		for (WAL::OpID id = 1; id <= NOperations; ++id)
+			insert(id);
+
+		WAL::OpID checkpointSum = 0;
+		for (const WAL::OpID id : completionOrder)
+		{
+			REQUIRE(remove(id));
+			checkpointSum += oldest();
+		}
+		REQUIRE(checkpointSum != 0);
+		return timeElapsedMs() - timeStart;
+	};
+
+	std::vector<WAL::OpID> vector;
+	const auto vectorTimeMs = measure(
+		[&](const WAL::OpID id) { vector.push_back(id); },
+		[&](const WAL::OpID id) {
+			const auto it = std::find(vector.begin(), vector.end(), id);
+			if (it == vector.end())
+				return false;
+			vector.erase(it);
+			return true;
+		},
+		[&] { return vector.empty() ? WAL::OpID{ 0 } : *std::min_element(vector.begin(), vector.end()); }
+	);
+
+	WAL::PendingOperations pending;
+	const auto bitmapTimeMs = measure(
+		[&](const WAL::OpID id) { pending.insert(id); },
+		[&](const WAL::OpID id) { return pending.remove(id); },
+		[&] { return pending.oldest().value_or(0); }
+	);
+
+	printf("%zu operations: vector - %lu ms, sliding bitmap - %lu ms\n", NOperations, static_cast<unsigned long>(vectorTimeMs), static_cast<unsigned long>(bitmapTimeMs));
+}
+
+TEST_CASE("DbWAL completion markers", "[.benchmark][dbwal]")
+{
+	// Every operation is completed right after it's registered, as a storage engine applying them one by one would
+	static constexpr size_t NThreads = 8;
+	static constexpr size_t NOperationsPerThread = 500;
+
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string{ "Benchmark record payload" } } };
+
+	for (const auto mode : { WAL::CompletionMarkers::Durable, WAL::CompletionMarkers::Lazy })
+	{
+		WAL::Options options;
+		options.completionMarkers = mode;
+		options.flushTimeoutMs = 1;
+
+		io::VectorAdapter walData(NThreads * NOperationsPerThread * 64);
+		DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+		REQUIRE(wal.openLogFile({}));
+
+		const auto threadFunction = [&] {
+			for (size_t i = 0; i < NOperationsPerThread; ++i)
+			{
+				const auto id = wal.registerOperation(op);
+				if (!id || !wal.updateOpStatus(*id, WAL::OpStatus::Successful))
+					fatalAbort("Failed to log the operation!");
+			}
+		};
+
+		const auto wallTimeStart = timeElapsedMs();
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < NThreads; ++i)
+			threads.emplace_back(threadFunction);
+		joinAll(threads);
+		const auto wallTimeMs = static_cast<double>(timeElapsedMs() - wallTimeStart);
+
+		REQUIRE(wal.closeLogFile());
+		printf("%-8s markers: %.0f ops/s, %.1f log bytes per op\n", mode == WAL::CompletionMarkers::Durable ? "durable" : "lazy",
+			static_cast<double>(NThreads * NOperationsPerThread) * 1000.0 / std::max(wallTimeMs, 1.0), static_cast<double>(walData.size()) / (NThreads * NOperationsPerThread));
+	}
+}
+
+TEST_CASE("DbWAL log volume under low load", "[.benchmark][dbwal]")
+{
+	// A single writer with a short timeout: most blocks are sealed on timeout holding a single entry
+	static constexpr size_t NOperations = 2000;
+
+	WAL::Options options;
+	options.flushTimeoutMs = 1;
+
+	io::VectorAdapter walData(NOperations * 512);
+	const auto stats = measureCommitCost(walData, {}, options, 1, NOperations).stats;
+
+	printf("%.0f log bytes per op (%.0f with whole 4 KiB blocks), padding: %.1f%%\n", static_cast<double>(walData.size()) / NOperations,
+		static_cast<double>(stats.blockCount) * 4096.0 / NOperations, 100.0 * static_cast<double>(stats.paddingBytesWritten) / std::max(static_cast<double>(stats.bytesWritten), 1.0));
+}
+
+TEST_CASE("DbWAL block checksums", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NBlocks = 50'000;
+	std::vector<std::byte> block(4096);
+	for (size_t i = 0; i < block.size(); ++i)
+		block[i] = static_cast<std::byte>(i * 31 + 7);
+
+	const auto measureThroughput = [&](const char* name, auto&& checksum) {
+		uint32_t sum = 0;
+		const auto timeStart = timeElapsedMs();
+		for (size_t i = 0; i < NBlocks; ++i)
+		{
+			block[0] = static_cast<std::byte>(i);
+			sum += checksum(block.data(), block.size());
+		}
+		const auto timeMs = std::max<uint64_t>(timeElapsedMs() - timeStart, 1);
+		printf("%-22s %6.0f MiB/s (%x)\n", name, static_cast<double>(NBlocks * block.size()) / 1024.0 / 1024.0 * 1000.0 / static_cast<double>(timeMs), sum);
+	};
+
+	measureThroughput(crc32cHardwareAccelerated() ? "CRC32C (hardware):" : "CRC32C (no hardware):", [](const void* data, size_t size) { return crc32c(data, size); });
+	measureThroughput("CRC32C (table-driven):", [](const void* data, size_t size) { return crc32cSoftware(data, size); });
+	measureThroughput("wheathash32:", [](const void* data, size_t size) { return wheathash32(data, size); });
+
+	// The whole write and recovery path: every block is checksummed once by the writer and once by verifyLog()
+	static constexpr size_t NOperations = 100'000;
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string(200, 'x') } };
+	const std::vector<Operation::Insert<BenchmarkRecord>> ops(NOperations, op);
+
+	for (const auto checksum : { WAL::BlockChecksum::Crc32c, WAL::BlockChecksum::WheatHash })
+	{
+		WAL::Options options;
+		options.blockChecksum = checksum;
+		options.flushTimeoutMs = 1;
+
+		io::VectorAdapter walData(NOperations * 256);
+		uint64_t writeTimeMs = 0;
+		{
+			DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+			REQUIRE(wal.openLogFile({}));
+
+			const auto timeStart = timeElapsedMs();
+			REQUIRE(wal.registerOperations(std::span{ ops }));
+			writeTimeMs = timeElapsedMs() - timeStart;
+
+			REQUIRE(wal.closeLogFile());
+		}
+
+		DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+		REQUIRE(wal.openLogFile({}));
+
+		size_t nPending = 0;
+		const auto timeStart = timeElapsedMs();
+		REQUIRE(wal.verifyLog([&](auto&&) { ++nPending; }));
+		const auto verificationTimeMs = timeElapsedMs() - timeStart;
+
+		REQUIRE(nPending == NOperations);
+		REQUIRE(wal.closeLogFile());
+
+		printf("%s, %lu KiB log: writing - %lu ms, verification - %lu ms\n", checksum == WAL::BlockChecksum::Crc32c ? "CRC32C" : "wheathash32",
+			static_cast<unsigned long>(walData.size() / 1024), static_cast<unsigned long>(writeTimeMs), static_cast<unsigned long>(verificationTimeMs));
+	}
+}
+
+TEST_CASE("DbWAL adaptive flush timeout", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperationsPerThread = 200;
+	static constexpr const char* walFilePath = "./dbwal_benchmark.log";
+
+	const Operation::Insert<BenchmarkRecord> op{ BenchmarkRecord{ uint64_t{ 42 }, std::string{ "Benchmark record payload" } } };
+
+	const auto measure = [&](const WAL::Options& options, const size_t nThreads, const char* name) {
+		io::FopenAdapter walFile;
+		DbWAL<BenchmarkRecord, io::FopenAdapter> wal{ walFile, options };
+		REQUIRE(wal.openLogFile(walFilePath));
+
+		std::vector<std::vector<uint64_t>> latencies(nThreads);
+		const auto threadFunction = [&](std::vector<uint64_t>& threadLatencies) {
+			threadLatencies.reserve(NOperationsPerThread);
+			for (size_t i = 0; i < NOperationsPerThread; ++i)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				if (!wal.registerOperation(op))
+					fatalAbort("registerOperation() failed!");
+				threadLatencies.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+			}
+		};
+
+		const auto wallTimeStart = timeElapsedMs();
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < nThreads; ++i)
+			threads.emplace_back(threadFunction, std::ref(latencies[i]));
+		joinAll(threads);
+		const auto wallTimeMs = std::max<uint64_t>(timeElapsedMs() - wallTimeStart, 1);
+
+		const auto stats = wal.stats().flushTimeout;
+		REQUIRE(wal.closeLogFile());
+		CHECK(std::filesystem::remove(walFilePath));
+
+		std::vector<uint64_t> allLatencies;
+		for (const auto& threadLatencies : latencies)
+			allLatencies.insert(allLatencies.end(), threadLatencies.begin(), threadLatencies.end());
+		std::sort(allLatencies.begin(), allLatencies.end());
+
+		printf("%2lu threads, %-8s %7.0f ops/s, p99 commit latency %6lu us; timeout %5lu us (arrivals %.0f ops/s, flush p99 %lu us)\n",
+			(unsigned long)nThreads, name, static_cast<double>(nThreads * NOperationsPerThread) * 1000.0 / static_cast<double>(wallTimeMs),
+			static_cast<unsigned long>(allLatencies[allLatencies.size() * 99 / 100]), static_cast<unsigned long>(stats.timeoutUs),
+			stats.arrivalRateOpsPerSecond, static_cast<unsigned long>(stats.flushLatencyP99Us));
+	};
+
+	for (const size_t nThreads : { 1, 8, 32 })
+	{
+		WAL::Options options;
+		options.flushTimeoutMs = 5;
+
+		options.flushTimeoutMode = WAL::FlushTimeoutMode::Fixed;
+		measure(options, nThreads, "fixed:");
+
+		options.flushTimeoutMode = WAL::FlushTimeoutMode::Adaptive;
+		measure(options, nThreads, "adaptive:");
+	}
+}
+
+TEST_CASE("DbWAL statistics overhead", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperationsPerThread = 2000;
+
+	for (const size_t nThreads : { 1, 8, 32 })
+	{
+		WAL::Options options;
+		options.flushThresholdOps = static_cast<uint32_t>(nThreads);
+
+		options.latencyStats = false;
+		const auto withoutLatencyStats = measureCommitCost(options, nThreads, NOperationsPerThread);
+
+		options.latencyStats = true;
+		const auto withLatencyStats = measureCommitCost(options, nThreads, NOperationsPerThread);
+
+		const auto& stats = withLatencyStats.stats;
+		printf("%2lu threads: %.2f us CPU per op without latency stats, %.2f us with; commit latency p50 %lu us, p99 %lu us; flush wait p99 %lu us; block lock hold p99 %lu us\n",
+			(unsigned long)nThreads, withoutLatencyStats.cpuUsPerOp, withLatencyStats.cpuUsPerOp,
+			static_cast<unsigned long>(stats.commitLatencyUs.percentile(50)), static_cast<unsigned long>(stats.commitLatencyUs.percentile(99)),
+			static_cast<unsigned long>(stats.flushWaitTimeUs.percentile(99)), static_cast<unsigned long>(stats.blockLockHoldTimeUs.percentile(99)));
+	}
+}
+
+namespace {
+
+// The same small record in the default and in the compact encoding
+template <int firstId>
+using SmallRecord = DbRecord<Field<uint64_t, firstId>, Field<int32_t, firstId + 1>, Field<std::string, firstId + 2>, Field<uint32_t, firstId + 3, true>>;
+using FixedSmallRecord = SmallRecord<41>;
+using CompactSmallRecord = SmallRecord<51>;
+
+template <class Record>
+void measureEncoding(const char* name, const size_t nOperations)
+{
+	std::vector<Operation::Insert<Record>> ops;
+	ops.reserve(nOperations);
+	for (size_t i = 0; i < nOperations; ++i)
+		ops.emplace_back(Record{ uint64_t{ i }, static_cast<int32_t>(i % 200) - 100, "user-" + std::to_string(i % 1000), std::vector<uint32_t>{ static_cast<uint32_t>(i % 50), 7 } });
+
+	// The whole entries, including the block framing and padding
+	io::VectorAdapter walData(nOperations * 64);
+	DbWAL<Record, io::VectorAdapter> wal{ walData, WAL::Options{} };
+	REQUIRE(wal.openLogFile({}));
+	REQUIRE(wal.registerOperations(std::span<const Operation::Insert<Record>>{ ops }));
+	REQUIRE(wal.closeLogFile());
+	const WAL::Stats stats = wal.stats();
+
+	// Serializing and deserializing the operations in memory, the same way the WAL does within a block
+	using Serializer = WAL::Serializer<Record>;
+	std::vector<std::byte> buffer(nOperations * 64);
+	io::SpanAdapter region{ std::span{ buffer } };
+	StorageIO io{ region };
+
+	const auto encodeStart = std::chrono::steady_clock::now();
+	for (const auto& op : ops)
+	{
+		if (!Serializer::serialize(op, io))
+			fatalAbort("serialize() failed!");
+	}
+	const auto encodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - encodeStart).count();
+	const uint64_t payloadBytes = io.pos();
+
+	REQUIRE(io.seek(0));
+	uint64_t checksum = 0;
+	const auto decodeStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < nOperations; ++i)
+	{
+		const bool success = Serializer::deserialize(io, [&](auto&& op) {
+			if constexpr (requires { op._record; })
+				checksum += op._record.template fieldAtIndex<0>().value;
+		});
+		if (!success)
+			fatalAbort("deserialize() failed!");
+	}
+	const auto decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - decodeStart).count();
+	REQUIRE(io.pos() == payloadBytes);
+	REQUIRE(checksum == nOperations * (nOperations - 1) / 2);
+
+	const auto perOp = [nOperations](const auto value) {
+		return static_cast<double>(value) / static_cast<double>(nOperations);
+	};
+	printf("%-8s %.1f bytes per op in the log, %.1f bytes of payload; encoding %.1f ns per op, decoding %.1f ns per op\n",
+		name, perOp(stats.bytesWritten), perOp(payloadBytes), perOp(encodeNs), perOp(decodeNs));
+}
+
+} // namespace
+
+template <>
+inline constexpr bool compactEncoding_v<CompactSmallRecord> = true;
+
+TEST_CASE("WAL compact encoding", "[.benchmark][dbwal]")
+{
+	static constexpr size_t NOperations = 200'000;
+
+	for (size_t pass = 0; pass < 2; ++pass)
+	{
+		measureEncoding<FixedSmallRecord>("fixed:", NOperations);
+		measureEncoding<CompactSmallRecord>("compact:", NOperations);
+	}
+}
+
+TEST_CASE("DbWAL verification: record views", "[.benchmark][dbwal]")
+{
+	// Recovery after a crash with every operation pending, the records being mostly strings
+	static constexpr size_t NOperations = 100'000;
+	const std::vector<Operation::Insert<BenchmarkRecord>> ops(NOperations, Operation::Insert<BenchmarkRecord>{ BenchmarkRecord{ uint64_t{ 42 }, std::string(400, 's') } });
+
+	io::VectorAdapter walData(NOperations * 450);
+	WAL::Options options;
+	{
+		DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+		REQUIRE(wal.openLogFile({}));
+		REQUIRE(wal.registerOperations(std::span{ ops }));
+		REQUIRE(wal.closeLogFile());
+	}
+
+	const auto measure = [&](const char* name, const unsigned int nThreads, auto&& receiver, const size_t& nBytesReceived) {
+		options.verificationThreads = nThreads;
+		DbWAL<BenchmarkRecord, io::VectorAdapter> wal{ walData, options };
+		REQUIRE(wal.openLogFile({}));
+
+		const auto timeStart = timeElapsedMs();
+		REQUIRE(wal.verifyLog(receiver));
+		const auto timeMs = timeElapsedMs() - timeStart;
+
+		REQUIRE(nBytesReceived == NOperations * 400);
+		REQUIRE(wal.closeLogFile());
+		printf("%-8s %u thread(s): %lu ms\n", name, nThreads, static_cast<unsigned long>(timeMs));
+	};
+
+	for (const unsigned int nThreads : { 1u, 4u })
+	{
+		size_t nBytesReceived = 0;
+		measure("records:", nThreads, [&](const auto& op) {
+			if constexpr (requires { op._record; })
+				nBytesReceived += op._record.template fieldValue<FString>().size();
+		}, nBytesReceived);
+
+		nBytesReceived = 0;
+		measure("views:", nThreads, WAL::RecordViews{ [&](const auto& op) {
+			if constexpr (requires { op._record; })
+				nBytesReceived += op._record.template fieldValue<FString>().size();
+		} }, nBytesReceived);
+	}
+}
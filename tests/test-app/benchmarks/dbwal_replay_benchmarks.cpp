@@ -0,0 +1,68 @@
+#include "3rdparty/catch2/catch.hpp"
+#include "WAL/wal_serializer.hpp"
+#include "storage/storage_static_buffer.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A translation unit of its own: deserializing the Find operations of a wide schema instantiates an operation type for every pair of fields,
+// which takes a few GB of compiler memory for 64 fields.
+
+namespace {
+
+// 64 scalar fields with the IDs 1 to 64 and an array field with the ID 65
+template <size_t... I>
+auto wideRecord(std::index_sequence<I...>) -> DbRecord<Field<uint32_t, static_cast<int>(I + 1)>..., Field<uint32_t, 65, true>>;
+using WideRecord = decltype(wideRecord(std::make_index_sequence<64>{}));
+
+template <int id>
+using WideField = Field<uint32_t, id, id == 65>;
+
+} // namespace
+
+TEST_CASE("WAL replay: 64-field record", "[.benchmark][dbwal]")
+{
+	using Serializer = WAL::Serializer<WideRecord>;
+
+	// Most of the field IDs are near the end of the schema
+	static constexpr size_t NEntries = 400'000;
+
+	io::VectorAdapter buffer(NEntries * 16);
+	{
+		StorageIO io{ buffer };
+		const std::vector<uint32_t> array{ 1, 2, 3 };
+		for (size_t i = 0; i < NEntries; i += 4)
+		{
+			const auto value = static_cast<uint32_t>(i);
+			REQUIRE(Serializer::serialize(Operation::Delete<WideRecord, WideField<64>>{ value }, io));
+			REQUIRE(Serializer::serialize(Operation::AppendToArray<WideRecord, WideField<63>, WideField<65>, false>{ value, array }, io));
+			REQUIRE(Serializer::serialize(Operation::Find<WideRecord, WideField<60>, WideField<62>>{ value, value + 1 }, io));
+			REQUIRE(Serializer::serialize(Operation::Delete<WideRecord, WideField<1>>{ value }, io));
+		}
+	}
+
+	StorageIO io{ buffer };
+	for (size_t pass = 0; pass < 3; ++pass)
+	{
+		REQUIRE(io.seek(0));
+
+		uint64_t checksum = 0;
+		const auto timeStart = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < NEntries; ++i)
+		{
+			const bool success = Serializer::deserialize(io, [&](auto&& op) {
+				checksum += static_cast<uint64_t>(std::remove_cvref_t<decltype(op)>::op);
+			});
+			if (!success)
+				fatalAbort("deserialize() failed!");
+		}
+		const auto timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timeStart).count();
+
+		REQUIRE(io.atEnd());
+		REQUIRE(checksum != 0);
+		printf("%.1f ns per entry\n", static_cast<double>(timeNs) / static_cast<double>(NEntries));
+	}
+}
@@ -1,8 +1,13 @@
 #include "3rdparty/catch2/catch.hpp"
 #include "dbrecord.hpp"
+#include "serialization/dbrecord-serializer.hpp"
+#include "storage/storage_static_buffer.hpp"
+#include "utility/constexpr_algorithms.hpp"
 
 #include <limits>
 #include <string>
+#include <string.h>
+#include <vector>
 
 TEST_CASE("DbRecord - construction from a pack of values", "[dbrecord]") {
 
@@ -171,3 +176,93 @@ TEST_CASE("DbRecord - array fields", "[dbrecord]") {
 		FAIL();
 	}
 }
+
+TEST_CASE("DbRecordSerializer: single write", "[dbrecord]")
+{
+	using FKey = Field<uint64_t, 1>;
+	using FFlag = Field<bool, 2>;
+	using FName = Field<std::string, 3>;
+	using FArray = Field<uint32_t, 4, true>;
+	using FStrings = Field<std::string, 5, true>;
+	using Record = DbRecord<FKey, FFlag, FName, FArray, FStrings>;
+	using RecordSerializer = DbRecordSerializer<Record>;
+
+	struct WriteCountingAdapter : io::VectorAdapter {
+		bool write(const void* data, const size_t size) noexcept
+		{
+			++nWrites;
+			return io::VectorAdapter::write(data, size);
+		}
+
+		size_t nWrites = 0;
+	};
+
+	// Laid out on the stack, on the heap, and with the empty values
+	const Record records[] {
+		Record{ uint64_t{ 7 }, true, std::string{ "Neptune" }, std::vector<uint32_t>{ 1, 2, 3 }, std::vector<std::string>{ "Triton", "", "Nereid" } },
+		Record{ uint64_t{ 8 }, false, std::string(5000, 'n'), std::vector<uint32_t>(3000, 0xABCDEF01), std::vector<std::string>(100, "Proteus") },
+		Record{}
+	};
+
+	for (const auto& record : records)
+	{
+		WriteCountingAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE(RecordSerializer::serialize(record, io));
+		REQUIRE(buffer.nWrites == 1);
+		REQUIRE(buffer.size() == record.totalSize());
+
+		// The same bytes as writing the fields one by one
+		io::VectorAdapter fieldByFieldBuffer;
+		StorageIO fieldByFieldIo{ fieldByFieldBuffer };
+		static_for<0, Record::fieldCount()>([&]<auto i>() {
+			REQUIRE(fieldByFieldIo.writeField(record.template fieldAtIndex<i>()));
+		});
+		REQUIRE(fieldByFieldBuffer.size() == buffer.size());
+		REQUIRE(::memcmp(fieldByFieldBuffer.data(), buffer.data(), buffer.size()) == 0);
+
+		REQUIRE(io.seek(0));
+		Record deserialized;
+		REQUIRE(RecordSerializer::deserialize(deserialized, io));
+		REQUIRE(deserialized == record);
+		REQUIRE(io.atEnd());
+	}
+}
+
+namespace {
+
+using CompactKey = Field<int64_t, 21>;
+using CompactCount = Field<uint32_t, 22>;
+using CompactRatio = Field<double, 23>;
+using CompactName = Field<std::string, 24>;
+using CompactDeltas = Field<int32_t, 25, true>;
+using CompactRecord = DbRecord<CompactKey, CompactCount, CompactRatio, CompactName, CompactDeltas>;
+
+}
+
+template <>
+inline constexpr bool compactEncoding_v<CompactRecord> = true;
+
+TEST_CASE("DbRecordSerializer: compact encoding", "[dbrecord]")
+{
+	using RecordSerializer = DbRecordSerializer<CompactRecord>;
+
+	const CompactRecord record(int64_t{ -3 }, uint32_t{ 200 }, 0.5, std::string(130, 'x'), std::vector<int32_t>{ 1, -1, 100'000, std::numeric_limits<int32_t>::min() });
+	for (const auto& r : { record, CompactRecord{} })
+	{
+		io::VectorAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE(RecordSerializer::serialize(r, io));
+		REQUIRE(buffer.size() == RecordSerializer::serializedSize(r));
+		REQUIRE(buffer.size() < r.totalSize());
+
+		REQUIRE(io.seek(0));
+		CompactRecord deserialized;
+		REQUIRE(RecordSerializer::deserialize(deserialized, io));
+		REQUIRE(deserialized == r);
+		REQUIRE(io.atEnd());
+	}
+
+	// 1 + 2 + 8 + (2 + 130) + (1 + 1 + 1 + 3 + 5) bytes
+	REQUIRE(RecordSerializer::serializedSize(record) == 154);
+}
@@ -1,3 +1,25 @@
+#include "3rdparty/catch2/catch.hpp"
+#include "storage/storage_io_interface.hpp"
+#include "storage/storage_io_uring.hpp"
+#include "storage/storage_static_buffer.hpp"
+
+#include "utility/integer_literals.hpp"
+
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <crtdbg.h>
+
+#define IGNORE_ASSERTION(...) do { [[maybe_unused]] const auto prevMode = _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_DEBUG); __VA_ARGS__; _CrtSetReportMode(_CRT_ASSERT, prevMode); } while(0)
+#else
+#define IGNORE_ASSERTION(...) __VA_ARGS__
+#endif
+
 //#include "3rdparty/catch2/catch.hpp"
 //#include "dbstorage.hpp"
 //#include "storage/storage_qt.hpp"
@@ -250,4 +272,131 @@
 //	catch (...) {
 //		FAIL();
 //	}
-//}
\ No newline at end of file
+//}
+
+TEST_CASE("StorageIO: reading arrays", "[dbstorage]")
+{
+	struct ReadCountingAdapter : io::VectorAdapter {
+		bool read(void* data, const size_t size) noexcept
+		{
+			++nReads;
+			return io::VectorAdapter::read(data, size);
+		}
+
+		size_t nReads = 0;
+	};
+
+	const auto checkRoundTrip = [](const auto& value, const size_t expectedReads) {
+		ReadCountingAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE(io.write(value));
+
+		REQUIRE(io.seek(0));
+		std::remove_cvref_t<decltype(value)> readValue(3); // Not empty: the old contents must be replaced
+		REQUIRE(io.read(readValue));
+		REQUIRE(readValue == value);
+		REQUIRE(buffer.nReads == expectedReads);
+		REQUIRE(io.atEnd());
+	};
+
+	SECTION("Trivially serializable items")
+	{
+		// The item count, then the items in one go
+		checkRoundTrip(std::vector<uint32_t>{}, 1);
+		checkRoundTrip(std::vector<uint32_t>{ 1, 2, 3 }, 2);
+
+		std::vector<uint32_t> largeArray(100'000);
+		for (size_t i = 0; i < largeArray.size(); ++i)
+			largeArray[i] = static_cast<uint32_t>(i * 7);
+		checkRoundTrip(largeArray, 2);
+
+		// Read in chunks
+		constexpr size_t ChunkItems = StorageIO<io::VectorAdapter>::MaxArrayReadChunkSize / sizeof(uint64_t);
+		checkRoundTrip(std::vector<uint64_t>(ChunkItems * 3 + 5, 0x0123456789ABCDEF), 1 + 4);
+		checkRoundTrip(std::vector<uint64_t>(ChunkItems, 42), 1 + 1);
+	}
+
+	SECTION("Nested arrays and strings")
+	{
+		// The item count, then every item on its own: its count and its items in one go
+		checkRoundTrip(std::vector<std::vector<uint16_t>>{ { 1, 2 }, {}, std::vector<uint16_t>(1000, 3) }, 1 + 2 + 1 + 2);
+		checkRoundTrip(std::vector<std::string>{ "Io", "Europa", "" }, 1 + 2 + 2 + 2);
+	}
+
+	SECTION("Truncated data")
+	{
+		io::VectorAdapter buffer;
+		StorageIO io{ buffer };
+		// The item count is way off, there's only a chunk's worth of items
+		REQUIRE(io.write(std::numeric_limits<uint32_t>::max()));
+		REQUIRE(io.write(std::vector<std::byte>(StorageIO<io::VectorAdapter>::MaxArrayReadChunkSize).data(), StorageIO<io::VectorAdapter>::MaxArrayReadChunkSize));
+
+		REQUIRE(io.seek(0));
+		std::vector<uint8_t> array;
+		IGNORE_ASSERTION(REQUIRE_FALSE(io.read(array)));
+		// Gave up at the second chunk
+		REQUIRE(array.capacity() <= 2 * StorageIO<io::VectorAdapter>::MaxArrayReadChunkSize);
+	}
+}
+
+TEST_CASE("IoUringAdapter: reading and writing", "[dbstorage]")
+{
+	static constexpr const char* filePath = "./io_uring_adapter_test.bin";
+
+	{
+		io::IoUringAdapter file;
+		StorageIO io{ file };
+		REQUIRE(io.open(filePath, io::OpenMode::ReadWrite));
+		REQUIRE(io.clear());
+
+		// More buffers than fit into a single submission, some of them registered
+		std::vector<std::vector<uint8_t>> chunks;
+		std::vector<io::ConstBuffer> buffers;
+		size_t totalSize = 0;
+		for (size_t i = 0; i < 150; ++i)
+		{
+			chunks.emplace_back(100 + i, static_cast<uint8_t>(i));
+			totalSize += chunks.back().size();
+		}
+		for (const auto& chunk : chunks)
+			buffers.push_back(io::ConstBuffer{ .data = chunk.data(), .size = chunk.size() });
+
+		// Optional, the writes work either way
+		[[maybe_unused]] const bool registered = io.registerBuffers(std::span{ buffers }.first(10));
+
+		REQUIRE(io.writeVectoredAndSync(buffers));
+		REQUIRE(io.writeVectored(buffers));
+		REQUIRE(io.write(uint32_t{ 0xDEADBEEF }));
+		REQUIRE(io.pos() == 2 * totalSize + 4);
+		REQUIRE(io.size() == 2 * totalSize + 4);
+		REQUIRE(io.sync());
+
+		REQUIRE(io.seek(0));
+		for (size_t pass = 0; pass < 2; ++pass)
+		{
+			for (const auto& chunk : chunks)
+			{
+				std::vector<uint8_t> data(chunk.size());
+				REQUIRE(io.read(data.data(), data.size()));
+				REQUIRE(data == chunk);
+			}
+		}
+
+		uint32_t value = 0;
+		REQUIRE(io.read(value));
+		REQUIRE(value == 0xDEADBEEF);
+		REQUIRE(io.atEnd());
+		REQUIRE(!io.read(value)); // Past the end
+
+		// Overwriting in the middle
+		REQUIRE(io.write(uint32_t{ 0x12345678 }, 10));
+		REQUIRE(io.read(value, 10));
+		REQUIRE(value == 0x12345678);
+		REQUIRE(io.size() == 2 * totalSize + 4);
+
+		REQUIRE(io.preallocate(1_z << 20));
+		REQUIRE(io.size() == 1_z << 20);
+	}
+
+	CHECK(std::filesystem::remove(filePath));
+}
@@ -1,5 +1,6 @@
 #include "3rdparty/catch2/catch.hpp"
 #include "dbwal.hpp"
+#include "storage/storage_io_uring.hpp"
 #include "storage/storage_static_buffer.hpp"
 
 #include "threading/thread_helpers.h"
@@ -9,7 +10,10 @@
 #include "utility/integer_literals.hpp"
 
 #include <array>
+#include <coroutine>
 #include <deque>
+#include <filesystem>
+#include <optional>
 
 #ifdef _WIN32
 #include <crtdbg.h>
@@ -87,7 +91,7 @@ TEST_CASE("DbWAL basics", "[dbwal]")
 	// Test updating op status
 	const auto id = wal.registerOperation(opAppend);
 	REQUIRE(id);
-	REQUIRE(buffer.pos() == 4096);
+	REQUIRE(buffer.pos() == 512); // One sector
 
 	// Rewind for verification without closing the log
 	buffer.seek(0);
@@ -96,7 +100,7 @@ TEST_CASE("DbWAL basics", "[dbwal]")
 	}));
 	REQUIRE(unfinishedOpsCount == 1);
 
-	buffer.seek(4096);
+	buffer.seek(512);
 	REQUIRE(wal.updateOpStatus(*id, WAL::OpStatus::Successful));
 	const auto bufferChecksum = wheathash64(buffer.data(), buffer.size());
 	IGNORE_ASSERTION(REQUIRE(wal.updateOpStatus(*id + 1, WAL::OpStatus::Successful) == false)); // No such ID
@@ -114,7 +118,7 @@ TEST_CASE("DbWAL basics", "[dbwal]")
 
 	// Closing the log
 	REQUIRE(wal.closeLogFile());
-	REQUIRE(buffer.size() == 8192);
+	REQUIRE(buffer.size() == 1024);
 }
 
 TEST_CASE("DbWAL: registering multiple operations - single thread", "[dbwal]")
@@ -135,8 +139,15 @@ TEST_CASE("DbWAL: registering multiple operations - single thread", "[dbwal]")
 		Operation::UpdateFull<RecordWithArray, F64, false> opUpdate(r1, 1'111'111'111'000ULL);
 		Operation::Find<RecordWithArray, F16, FString> opFind(int16_t{ -21999 }, "Venus");
 
+		WAL::Options options;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+		options.verificationThreads = GENERATE(1u, 4u);
+		options.completionMarkers = GENERATE(WAL::CompletionMarkers::Durable, WAL::CompletionMarkers::Lazy);
+		options.blockChecksum = GENERATE(WAL::BlockChecksum::Crc32c, WAL::BlockChecksum::WheatHash);
+		options.flushTimeoutMode = GENERATE(WAL::FlushTimeoutMode::Fixed, WAL::FlushTimeoutMode::Adaptive);
+
 		io::StaticBufferAdapter<80'000> walDataBuffer;
-		DbWAL<RecordWithArray, decltype(walDataBuffer)> wal{ walDataBuffer };
+		DbWAL<RecordWithArray, decltype(walDataBuffer)> wal{ walDataBuffer, options };
 		REQUIRE(wal.openLogFile({}));
 
 		std::vector<WAL::OpID> registeredOpIds;
@@ -251,8 +262,13 @@ TEST_CASE("DbWAL: registering multiple operations - multiple threads", "[dbwal]"
 		Operation::UpdateFull<RecordWithArray, F64, false> opUpdate(r1, 1'111'111'111'000ULL);
 		Operation::Find<RecordWithArray, F16, FString> opFind(int16_t{ -21999 }, "Venus");
 
+		WAL::Options options;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+		options.verificationThreads = GENERATE(1u, 4u);
+		options.completionMarkers = GENERATE(WAL::CompletionMarkers::Durable, WAL::CompletionMarkers::Lazy);
+
 		io::VectorAdapter walDataBuffer(100000);
-		DbWAL<RecordWithArray, decltype(walDataBuffer)> wal{ walDataBuffer };
+		DbWAL<RecordWithArray, decltype(walDataBuffer)> wal{ walDataBuffer, options };
 		REQUIRE(wal.openLogFile({}));
 
 		const auto registerOperationByIndex = [&](const size_t index) {
@@ -312,7 +328,7 @@ TEST_CASE("DbWAL: registering multiple operations - multiple threads", "[dbwal]"
 			}
 		};
 
-		const auto fillWal = [&threadFunction](bool issueUpdateOpStatusCalls) {
+		const auto fillWal = [&](bool issueUpdateOpStatusCalls) {
 			const auto startTime = timeElapsedMs();
 			std::deque<std::thread> threads;
 			// Start N threads
@@ -325,6 +341,11 @@ TEST_CASE("DbWAL: registering multiple operations - multiple threads", "[dbwal]"
 				printf("Filling the WAL with updateOpStatus() (%lu threads x %lu ops) took %F s\n", (unsigned long)NThreads, (unsigned long)NOperationsPerThread, (float)(timeElapsedMs() - startTime) / 1000.0f);
 			else
 				printf("Filling the WAL (%lu threads x %lu ops) took %F s\n", (unsigned long)NThreads, (unsigned long)NOperationsPerThread, (float)(timeElapsedMs() - startTime) / 1000.0f);
+
+			const auto stats = wal.stats();
+			printf("Max fill: %ld, avg. fill: %ld, padding: %.1f%%\n", (long)stats.maxBlockFill, (long)((stats.bytesWritten - stats.paddingBytesWritten) / stats.blockCount),
+				100.0 * (double)stats.paddingBytesWritten / (double)stats.bytesWritten);
+			printf("Blocks per group commit: max %ld, avg. %.2f\n", (long)stats.maxBlocksPerGroupCommit, (double)stats.blockCount / (double)stats.groupCommitCount);
 		};
 
 		SECTION("No updateOpStatus()")
@@ -436,8 +457,1425 @@ TEST_CASE("DbWAL: registering multiple operations - multiple threads", "[dbwal]"
 	catch (const std::exception& e) {
 		FAIL(e.what());
 	}
+}
+
+TEST_CASE("DbWAL: flusher thread mode", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using FString = Field<std::string, 2>;
+		using Record = DbRecord<F64, FString>;
+
+		WAL::Options options;
+		options.flushMode = WAL::FlushMode::FlusherThread;
+		options.flushTimeoutMs = 5;
+
+		SECTION("Timeout and full blocks only") {}
+		SECTION("Op count threshold") { options.flushThresholdOps = 3; }
+		SECTION("Byte threshold") { options.flushThresholdBytes = 1000; }
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		static constexpr size_t NOperationsPerThread = 300;
+		static constexpr size_t NThreads = 8;
+
+		std::array<std::vector<WAL::OpID>, NThreads> opIds;
+		const auto threadFunction = [&](const size_t threadIndex) {
+			for (size_t i = 0; i < NOperationsPerThread; ++i)
+			{
+				const Operation::Insert<Record> op{ Record{ uint64_t{ threadIndex * NOperationsPerThread + i }, std::string(i % 50, 'x') } };
+				const auto id = wal.registerOperation(op);
+				REQUIRE_THREAD_SAFE(id);
+				opIds[threadIndex].push_back(*id);
+			}
+		};
+
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < NThreads; ++i)
+			threads.emplace_back(threadFunction, i);
+		joinAll(threads);
+
+		std::vector<WAL::OpID> allIds;
+		for (const auto& ids : opIds)
+			allIds.insert(allIds.end(), begin_to_end(ids));
+		std::sort(begin_to_end(allIds));
+		REQUIRE(std::adjacent_find(begin_to_end(allIds)) == allIds.end());
+
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(walDataBuffer.size() % 512 == 0);
+		REQUIRE(wal.openLogFile({}));
+
+		std::vector<bool> recordSeen(NThreads * NOperationsPerThread, false);
+		size_t unfinishedOpsCount = 0;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				++unfinishedOpsCount;
+				const auto value = op._record.fieldValue<F64>();
+				REQUIRE(value < recordSeen.size());
+				REQUIRE(!recordSeen[value]);
+				recordSeen[value] = true;
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		REQUIRE(unfinishedOpsCount == NThreads * NOperationsPerThread);
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: batch registration", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using FString = Field<std::string, 2>;
+		using Record = DbRecord<F64, FString>;
+
+		WAL::Options options;
+		options.flushTimeoutMs = 5;
+
+		SECTION("Inline flushing") {}
+		SECTION("Op count threshold") { options.flushThresholdOps = 3; }
+		SECTION("Flusher thread") { options.flushMode = WAL::FlushMode::FlusherThread; }
+
+		io::VectorAdapter walDataBuffer(1'000'000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		static constexpr size_t NOperationsPerThread = 2000;
+		static constexpr size_t NThreads = 6;
+
+		std::array<std::vector<WAL::OpID>, NThreads> opIds;
+		const auto threadFunction = [&](const size_t threadIndex) {
+			RandomNumberGenerator<uint64_t> rng{ threadIndex, 1, 200 };
+			std::vector<Operation::Insert<Record>> batch;
+			for (size_t i = 0; i < NOperationsPerThread; )
+			{
+				// Odd threads log one operation at a time, even ones log batches up to several blocks long
+				const size_t batchSize = threadIndex % 2 == 0 ? std::min(static_cast<size_t>(rng.rand()), NOperationsPerThread - i) : 1;
+				batch.clear();
+				for (size_t k = 0; k < batchSize; ++k, ++i)
+					batch.emplace_back(Record{ uint64_t{ threadIndex * NOperationsPerThread + i }, std::string(i % 50, 'x') });
+
+				const auto firstId = wal.registerOperations(std::span<const Operation::Insert<Record>>{ batch });
+				REQUIRE_THREAD_SAFE(firstId);
+				for (size_t k = 0; k < batchSize; ++k)
+					opIds[threadIndex].push_back(*firstId + static_cast<WAL::OpID>(k));
+			}
+		};
+
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < NThreads; ++i)
+			threads.emplace_back(threadFunction, i);
+		joinAll(threads);
+
+		std::vector<WAL::OpID> allIds;
+		for (const auto& ids : opIds)
+			allIds.insert(allIds.end(), begin_to_end(ids));
+		std::sort(begin_to_end(allIds));
+		REQUIRE(std::adjacent_find(begin_to_end(allIds)) == allIds.end());
+
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(walDataBuffer.size() % 512 == 0);
+		REQUIRE(wal.openLogFile({}));
+
+		std::vector<bool> recordSeen(NThreads * NOperationsPerThread, false);
+		size_t unfinishedOpsCount = 0;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				++unfinishedOpsCount;
+				const auto value = op._record.fieldValue<F64>();
+				REQUIRE(value < recordSeen.size());
+				REQUIRE(!recordSeen[value]);
+				recordSeen[value] = true;
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		REQUIRE(unfinishedOpsCount == NThreads * NOperationsPerThread);
+
+		// The IDs must match the entries: the completed operations are no longer reported
+		static constexpr size_t NCompleted = 10;
+		for (size_t i = 0; i < NCompleted; ++i)
+			REQUIRE(wal.updateOpStatus(opIds[0][i], WAL::OpStatus::Successful));
+
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(wal.openLogFile({}));
+
+		std::fill(begin_to_end(recordSeen), false);
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				recordSeen[op._record.fieldValue<F64>()] = true;
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		REQUIRE(std::count(begin_to_end(recordSeen), true) == static_cast<ptrdiff_t>(NThreads * NOperationsPerThread - NCompleted));
+		REQUIRE(std::none_of(recordSeen.begin(), recordSeen.begin() + NCompleted, [](const bool seen) { return seen; }));
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+// Fire-and-forget coroutine
+struct DetachedTask {
+	struct promise_type {
+		DetachedTask get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+template <class WAL, class Record>
+DetachedTask registerSequentially(WAL& wal, const uint64_t firstValue, const size_t count, std::atomic<size_t>& nCompleted)
+{
+	// Each operation is only registered once the previous one has been flushed, which resumes the coroutine on the completion thread
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto ticket = wal.registerOperationAsync(Operation::Insert<Record>{ Record{ firstValue + i, std::string(i % 50, 'y') } });
+		REQUIRE_THREAD_SAFE(ticket);
+		const auto opId = co_await *ticket;
+		REQUIRE_THREAD_SAFE(opId == ticket->opId() && ticket->flushed());
+	}
+
+	nCompleted = count;
+	nCompleted.notify_all();
+}
+
+TEST_CASE("DbWAL: asynchronous registration", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using FString = Field<std::string, 2>;
+		using Record = DbRecord<F64, FString>;
+
+		WAL::Options options;
+		options.flushMode = WAL::FlushMode::FlusherThread;
+		options.flushTimeoutMs = 5;
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		static constexpr size_t NOperationsPerThread = 300;
+		static constexpr size_t NThreads = 4;
+		static constexpr size_t NSequentialOperations = 50;
+
+		std::atomic<size_t> nSequentialCompleted = 0;
+		registerSequentially<decltype(wal), Record>(wal, NThreads * NOperationsPerThread, NSequentialOperations, nSequentialCompleted);
+
+		std::atomic<size_t> nCallbacks = 0;
+		const auto threadFunction = [&](const size_t threadIndex) {
+			std::vector<decltype(wal)::FlushTicket> tickets;
+			for (size_t i = 0; i < NOperationsPerThread; ++i)
+			{
+				const Operation::Insert<Record> op{ Record{ uint64_t{ threadIndex * NOperationsPerThread + i }, std::string(i % 50, 'x') } };
+				const auto ticket = wal.registerOperationAsync(op);
+				REQUIRE_THREAD_SAFE(ticket);
+				REQUIRE_THREAD_SAFE(tickets.empty() || tickets.back().opId() < ticket->opId());
+
+				if (i % 2 == 0)
+					ticket->onFlushed([&nCallbacks, ticket = *ticket] {
+						REQUIRE_THREAD_SAFE(ticket.flushed());
+						++nCallbacks;
+					});
+
+				tickets.push_back(*ticket);
+			}
+
+			for (const auto& ticket : tickets)
+			{
+				ticket.wait();
+				REQUIRE_THREAD_SAFE(ticket.flushed());
+			}
+		};
+
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < NThreads; ++i)
+			threads.emplace_back(threadFunction, i);
+		joinAll(threads);
+
+		for (size_t n = nSequentialCompleted; n != NSequentialOperations; n = nSequentialCompleted)
+			nSequentialCompleted.wait(n);
+
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(nCallbacks == NThreads * NOperationsPerThread / 2);
+
+		REQUIRE(wal.openLogFile({}));
+		size_t unfinishedOpsCount = 0;
+		REQUIRE(wal.verifyLog([&](auto&&) {
+			++unfinishedOpsCount;
+		}));
+
+		REQUIRE(unfinishedOpsCount == NThreads * NOperationsPerThread + NSequentialOperations);
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: sealing every operation into a separate block", "[dbwal]")
+{
+	// Keeps all the block ring slots busy: sealed blocks pile up faster than they're written
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.flushThresholdOps = 1;
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		static constexpr size_t NOperationsPerThread = 100;
+		static constexpr size_t NThreads = 8;
+
+		const auto threadFunction = [&](const size_t threadIndex) {
+			for (size_t i = 0; i < NOperationsPerThread; ++i)
+			{
+				const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ threadIndex * NOperationsPerThread + i } } });
+				REQUIRE_THREAD_SAFE(id);
+			}
+		};
+
+		std::deque<std::thread> threads;
+		for (size_t i = 0; i < NThreads; ++i)
+			threads.emplace_back(threadFunction, i);
+		joinAll(threads);
+
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(walDataBuffer.size() == NThreads * NOperationsPerThread * 512);
+		REQUIRE(wal.openLogFile({}));
+
+		size_t unfinishedOpsCount = 0;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&&) {
+				++unfinishedOpsCount;
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		REQUIRE(unfinishedOpsCount == NThreads * NOperationsPerThread);
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: segmented log", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		// Every operation and every completion marker takes a block of its own
+		options.flushThresholdOps = 1;
+		options.segmentBlocks = 4;
+		options.segmentCount = 2;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+
+		static constexpr size_t SegmentSize = 4 * 4096;
+
+		io::VectorAdapter walDataBuffer(100000);
+		// Returns the last ID
+		const auto registerCompletedOperations = [&](auto& wal, const size_t count) {
+			WAL::OpID lastId = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i } } });
+				REQUIRE(id);
+				REQUIRE(wal.updateOpStatus(*id, WAL::OpStatus::Successful));
+				lastId = *id;
+			}
+			return lastId;
+		};
+
+		WAL::OpID pendingOpId = 0, lastOpId = 0;
+		size_t logSizeWithPendingOp = 0;
+		{
+			DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+			REQUIRE(wal.openLogFile({}));
+			REQUIRE(walDataBuffer.size() == 2 * SegmentSize);
+
+			// The segments are reused as soon as their operations complete
+			registerCompletedOperations(wal, 60);
+			REQUIRE(walDataBuffer.size() == 2 * SegmentSize);
+
+			// An operation that stays pending pins its segment, and the ring has to grow
+			const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ 12345 } } });
+			REQUIRE(id);
+			pendingOpId = *id;
+
+			registerCompletedOperations(wal, 30);
+			logSizeWithPendingOp = walDataBuffer.size();
+			REQUIRE(logSizeWithPendingOp > 2 * SegmentSize);
+			REQUIRE(logSizeWithPendingOp % SegmentSize == 0);
+
+			REQUIRE(wal.closeLogFile());
+		}
+
+		const auto verify = [&](auto& wal) {
+			std::vector<uint64_t> pendingValues;
+			REQUIRE(wal.verifyLog(overload{
+				[&](Operation::Insert<Record>&& op) {
+					pendingValues.push_back(op._record.template fieldValue<F64>());
+				},
+				[&](auto&&) {
+					FAIL("This overload shouldn't be called!");
+				}
+			}));
+			return pendingValues;
+		};
+
+		{
+			DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+			REQUIRE(wal.openLogFile({}));
+			REQUIRE(verify(wal) == std::vector<uint64_t>{ 12345 });
+
+			// The IDs carry on from the previous session, and its segments are free for reuse once verified
+			const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ 1 } } });
+			REQUIRE(id);
+			REQUIRE(*id > pendingOpId);
+			REQUIRE(wal.updateOpStatus(*id, WAL::OpStatus::Successful));
+
+			lastOpId = registerCompletedOperations(wal, 100);
+			REQUIRE(walDataBuffer.size() == logSizeWithPendingOp);
+
+			REQUIRE(wal.closeLogFile());
+		}
+
+		{
+			DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+			REQUIRE(wal.openLogFile({}));
+			// The operation reported by the previous verification is below the checkpoint now
+			REQUIRE(verify(wal).empty());
+
+			// No IDs are skipped on reopening, or they would soon run out
+			REQUIRE(registerCompletedOperations(wal, 1) == lastOpId + 1);
+			REQUIRE(wal.closeLogFile());
+		}
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: completion markers", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.completionMarkers = WAL::CompletionMarkers::Lazy;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+		options.flushTimeoutMs = 5;
+
+		// Enough operations for the first one to be too far behind the last block for a compact marker
+		static constexpr size_t NOperations = 40'000;
+		std::vector<Operation::Insert<Record>> ops;
+		ops.reserve(NOperations);
+		for (size_t i = 0; i < NOperations; ++i)
+			ops.emplace_back(Record{ uint64_t{ i } });
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		const auto firstOpId = wal.registerOperations(std::span<const Operation::Insert<Record>>{ ops });
+		REQUIRE(firstOpId);
+		const size_t logSizeWithoutMarkers = walDataBuffer.size();
+
+		// The markers don't take OpIDs, so all of them are relative to the ID following the last operation.
+		// The last 30'000 operations are close enough for the compact markers, every 10th of them stays pending.
+		static constexpr size_t FirstCompactOperation = NOperations - 30'000;
+		size_t nCompleted = 0;
+		for (size_t i = FirstCompactOperation; i < NOperations; ++i)
+		{
+			if (i % 10 == 0)
+				continue;
+
+			REQUIRE(wal.updateOpStatus(*firstOpId + static_cast<WAL::OpID>(i), i % 2 == 0 ? WAL::OpStatus::Successful : WAL::OpStatus::Failed));
+			++nCompleted;
+		}
+
+		// The first operation is too far behind, its marker is logged as a whole entry
+		REQUIRE(wal.updateOpStatus(*firstOpId, WAL::OpStatus::Successful));
+
+		REQUIRE(wal.closeLogFile());
+		// 3 bytes per marker
+		const size_t markerBytes = walDataBuffer.size() - logSizeWithoutMarkers;
+		REQUIRE(markerBytes <= (nCompleted * 3 / 4000 + 2) * 4096);
+
+		REQUIRE(wal.openLogFile({}));
+		std::vector<uint64_t> pendingValues;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				pendingValues.push_back(op._record.fieldValue<F64>());
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		std::vector<uint64_t> expectedPendingValues;
+		for (size_t i = 1; i < NOperations; ++i)
+		{
+			if (i < FirstCompactOperation || i % 10 == 0)
+				expectedPendingValues.push_back(i);
+		}
+		REQUIRE(pendingValues == expectedPendingValues);
+
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: torn tail", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.flushThresholdOps = 1;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		static constexpr size_t NOperations = 10;
+		for (size_t i = 0; i < NOperations; ++i)
+			REQUIRE(wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i } } }));
+
+		REQUIRE(wal.closeLogFile());
+		// One sector per block
+		REQUIRE(walDataBuffer.size() == NOperations * 512);
+
+		// Simulating a crash in the middle of writing the next group commit
+		std::vector<std::byte> tornCommit(512);
+		SECTION("Partial block")
+		{
+			REQUIRE(walDataBuffer.open({}, io::OpenMode::ReadWrite));
+			REQUIRE(walDataBuffer.seek(walDataBuffer.size() - tornCommit.size()));
+			REQUIRE(walDataBuffer.read(tornCommit.data(), tornCommit.size()));
+			REQUIRE(walDataBuffer.close());
+			tornCommit.resize(100);
+		}
+		SECTION("Whole block, corrupt")
+		{
+			REQUIRE(walDataBuffer.open({}, io::OpenMode::ReadWrite));
+			REQUIRE(walDataBuffer.seek(walDataBuffer.size() - tornCommit.size()));
+			REQUIRE(walDataBuffer.read(tornCommit.data(), tornCommit.size()));
+			REQUIRE(walDataBuffer.close());
+			tornCommit[200] ^= std::byte{ 0xFF };
+		}
+		SECTION("Several blocks, the first one lost")
+		{
+			// The blocks that made it to the disk must not be replayed, neither now nor after the next, shorter commit
+			io::VectorAdapter otherLogBuffer;
+			{
+				DbWAL<Record, decltype(otherLogBuffer)> otherWal{ otherLogBuffer, options };
+				REQUIRE(otherWal.openLogFile({}));
+				for (size_t i = 0; i < 3; ++i)
+					REQUIRE(otherWal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ 100 + i } } }));
+				REQUIRE(otherWal.closeLogFile());
+			}
+
+			tornCommit.resize(otherLogBuffer.size());
+			REQUIRE(tornCommit.size() == 3 * 512);
+			REQUIRE(otherLogBuffer.open({}, io::OpenMode::ReadWrite));
+			REQUIRE(otherLogBuffer.read(tornCommit.data(), tornCommit.size()));
+			REQUIRE(otherLogBuffer.close());
+			tornCommit[200] ^= std::byte{ 0xFF };
+		}
+
+		REQUIRE(walDataBuffer.open({}, io::OpenMode::ReadWrite));
+		REQUIRE(walDataBuffer.seekToEnd());
+		REQUIRE(walDataBuffer.write(tornCommit.data(), tornCommit.size()));
+		REQUIRE(walDataBuffer.close());
+		const size_t tornLogSize = walDataBuffer.size();
+
+		const auto verify = [&] {
+			std::vector<uint64_t> pendingValues;
+			REQUIRE(wal.openLogFile({}));
+			REQUIRE(wal.verifyLog(overload{
+				[&](Operation::Insert<Record>&& op) {
+					pendingValues.push_back(op._record.fieldValue<F64>());
+				},
+				[&](auto&&) {
+					FAIL("This overload shouldn't be called!");
+				}
+			}));
+			return pendingValues;
+		};
+
+		REQUIRE(verify().size() == NOperations);
+
+		// The torn commit is overwritten by the next one, and the rest of it zeroed
+		REQUIRE(wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ NOperations } } }));
+		REQUIRE(wal.closeLogFile());
+		REQUIRE(walDataBuffer.size() == std::max(tornLogSize, (NOperations + 1) * 512));
+
+		const auto pendingValues = verify();
+		REQUIRE(pendingValues.size() == NOperations + 1);
+		REQUIRE(pendingValues.back() == NOperations);
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: block checksum", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		io::VectorAdapter walDataBuffer(100000);
+		const auto registerAndVerify = [&](const WAL::BlockChecksum checksum, const uint64_t value) {
+			WAL::Options options;
+			options.blockChecksum = checksum;
+			options.flushThresholdOps = 1;
+
+			DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+			REQUIRE(wal.openLogFile({}));
+			std::vector<uint64_t> pendingValues;
+			REQUIRE(wal.verifyLog(overload{
+				[&](Operation::Insert<Record>&& op) {
+					pendingValues.push_back(op._record.fieldValue<F64>());
+				},
+				[&](auto&&) {
+					FAIL("This overload shouldn't be called!");
+				}
+			}));
+
+			REQUIRE(wal.registerOperation(Operation::Insert<Record>{ Record{ value } }));
+			REQUIRE(wal.closeLogFile());
+			return pendingValues;
+		};
+
+		// Every block records its checksum algorithm, so the setting can change between sessions
+		REQUIRE(registerAndVerify(WAL::BlockChecksum::WheatHash, 1).empty());
+		REQUIRE(registerAndVerify(WAL::BlockChecksum::Crc32c, 2) == std::vector<uint64_t>{ 1 });
+		REQUIRE(registerAndVerify(WAL::BlockChecksum::WheatHash, 3) == std::vector<uint64_t>{ 1, 2 });
+		REQUIRE(registerAndVerify(WAL::BlockChecksum::Crc32c, 4) == std::vector<uint64_t>{ 1, 2, 3 });
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+template <size_t BlockSize>
+static void testBlockSize(const uint32_t segmentBlocks)
+{
+	using F64 = Field<uint64_t, 1>;
+	using FString = Field<std::string, 2>;
+	using Record = DbRecord<F64, FString>;
+
+	WAL::Options options;
+	options.segmentBlocks = segmentBlocks;
+	options.flushTimeoutMs = 1;
+
+	// Each of these only fits into a block of this size
+	static constexpr size_t NOperations = 20;
+	const std::string payload(BlockSize / 2, 'x');
+
+	io::VectorAdapter walDataBuffer(100000);
+	DbWAL<Record, decltype(walDataBuffer), BlockSize> wal{ walDataBuffer, options };
+	REQUIRE(wal.openLogFile({}));
+
+	for (size_t i = 0; i < NOperations; ++i)
+	{
+		const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i }, payload } });
+		REQUIRE(id);
+		if (i % 2 == 1)
+			REQUIRE(wal.updateOpStatus(*id, WAL::OpStatus::Successful));
+	}
+	REQUIRE(wal.closeLogFile());
+
+	REQUIRE(wal.openLogFile({}));
+	std::vector<uint64_t> pendingValues;
+	REQUIRE(wal.verifyLog(overload{
+		[&](Operation::Insert<Record>&& op) {
+			REQUIRE(op._record.template fieldValue<FString>() == payload);
+			pendingValues.push_back(op._record.template fieldValue<F64>());
+		},
+		[&](auto&&) {
+			FAIL("This overload shouldn't be called!");
+		}
+	}));
+	REQUIRE(wal.closeLogFile());
+
+	std::vector<uint64_t> expectedPendingValues;
+	for (uint64_t i = 0; i < NOperations; i += 2)
+		expectedPendingValues.push_back(i);
+	REQUIRE(pendingValues == expectedPendingValues);
+}
+
+TEST_CASE("DbWAL: block sizes", "[dbwal]")
+{
+	try {
+		const uint32_t segmentBlocks = GENERATE(0u, 8u);
+		testBlockSize<8192>(segmentBlocks);
+		testBlockSize<16384>(segmentBlocks);
+		testBlockSize<65536>(segmentBlocks);
+
+		const size_t deviceBlockSize = queryBlockSize("./dbwal_block_size_test.log");
+		REQUIRE((deviceBlockSize == 0 || std::has_single_bit(deviceBlockSize)));
+		REQUIRE(checkBlockSize("./dbwal_block_size_test.log", 65536));
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("io_uring adapter", "[dbwal]")
+{
+	static constexpr const char* filePath = "./io_uring_adapter_test.bin";
+
+	SECTION("WAL")
+	{
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.durability = GENERATE(WAL::Durability::SyncPerCommit, WAL::Durability::WriteThrough);
+		// Only the segmented log file is reopened as is, the plain one starts anew
+		options.segmentBlocks = GENERATE(4u, 64u);
+		options.flushThresholdOps = 2;
+
+		std::vector<uint64_t> expectedPendingValues;
+		{
+			io::IoUringAdapter file;
+			DbWAL<Record, io::IoUringAdapter> wal{ file, options };
+			REQUIRE(wal.openLogFile(filePath));
+
+			for (uint64_t i = 0; i < 200; ++i)
+			{
+				const auto id = wal.registerOperation(Operation::Insert<Record>{ Record{ i } });
+				REQUIRE(id);
+				if (i % 3 == 0)
+					expectedPendingValues.push_back(i);
+				else
+					REQUIRE(wal.updateOpStatus(*id, WAL::OpStatus::Successful));
+			}
+
+			REQUIRE(wal.closeLogFile());
+		}
+
+		io::IoUringAdapter file;
+		DbWAL<Record, io::IoUringAdapter> wal{ file, options };
+		REQUIRE(wal.openLogFile(filePath));
+
+		std::vector<uint64_t> pendingValues;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				pendingValues.push_back(op._record.template fieldValue<F64>());
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+		REQUIRE(pendingValues == expectedPendingValues);
+		REQUIRE(wal.closeLogFile());
+	}
+
+	SECTION("Two WALs on one adapter")
+	{
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.durability = WAL::Durability::SyncPerCommit;
+		// The segmented log is reopened as is, so the second WAL appends to the first one's log
+		options.segmentBlocks = 64;
+		options.flushThresholdOps = 2;
+
+		// The block ring of each WAL is registered with the adapter, which outlives them both. The second WAL is likely to be constructed at the same address.
+		io::IoUringAdapter file;
+		std::optional<DbWAL<Record, io::IoUringAdapter>> wal;
+		std::vector<uint64_t> expectedPendingValues;
+		for (uint64_t round = 0; round < 2; ++round)
+		{
+			wal.emplace(file, options);
+			REQUIRE(wal->openLogFile(filePath));
+			for (uint64_t i = 0; i < 50; ++i)
+			{
+				const uint64_t value = round * 1000 + i;
+				REQUIRE(wal->registerOperation(Operation::Insert<Record>{ Record{ value } }));
+				expectedPendingValues.push_back(value);
+			}
+
+			REQUIRE(wal->closeLogFile());
+			REQUIRE(file.registeredBufferCount() == 0);
+			wal.reset();
+		}
+
+		wal.emplace(file, options);
+		REQUIRE(wal->openLogFile(filePath));
+
+		std::vector<uint64_t> pendingValues;
+		REQUIRE(wal->verifyLog(overload{
+			[&](Operation::Insert<Record>&& op) {
+				pendingValues.push_back(op._record.template fieldValue<F64>());
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+		REQUIRE(pendingValues == expectedPendingValues);
+		REQUIRE(wal->closeLogFile());
+		REQUIRE(file.registeredBufferCount() == 0);
+
+		// Destroyed without closing the log
+		wal.emplace(file, options);
+		REQUIRE(wal->openLogFile(filePath));
+		wal.reset();
+		REQUIRE(file.registeredBufferCount() == 0);
+	}
+
+	CHECK(std::filesystem::remove(filePath));
+}
+
+TEST_CASE("WAL: serialized operation size", "[dbwal]")
+{
+	using F64 = Field<uint64_t, 1>;
+	using F16 = Field<int16_t, 2>;
+	using FString = Field<std::string, 3>;
+	using FArray = Field<uint32_t, 4, true>;
+
+	using RecordWithArray = DbRecord<F64, F16, FString, FArray>;
+	using Serializer = WAL::Serializer<RecordWithArray>;
+	const RecordWithArray record(1'000'000'000'000ULL, int16_t{ -32700 }, "Hello!", std::vector<uint32_t>{ {123, 456, 789} });
+
+	// Entries are serialized in place into the space reserved for them, so the size has to be exact
+	const auto checkSize = [](const auto& op) {
+		io::VectorAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE(Serializer::serialize(op, io));
+		REQUIRE(Serializer::serializedSize(op) == buffer.size());
+	};
+
+	checkSize(Operation::Insert<RecordWithArray>{ record });
+	checkSize(Operation::Insert<RecordWithArray>{ RecordWithArray{} });
+	checkSize(Operation::Find<RecordWithArray, F16, FString>{ int16_t{ -21999 }, "Venus" });
+	checkSize(Operation::UpdateFull<RecordWithArray, F64, false>{ record, 1'111'111'111'000ULL });
+	checkSize(Operation::UpdateFull<RecordWithArray, FString, true>{ record, "Mars" });
+	checkSize(Operation::AppendToArray<RecordWithArray, F16, FArray, true>{ int16_t{ -31000 }, record });
+	checkSize(Operation::AppendToArray<RecordWithArray, FString, FArray, false>{ "Jupiter", std::vector<uint32_t>{ 5, 6 } });
+	checkSize(Operation::Delete<RecordWithArray, FString>{ "Mars" });
+	checkSize(Operation::Delete<RecordWithArray, F64>{ 42ULL });
+	checkSize(WAL::OperationCompletedMarker{ .status = WAL::OpStatus::Successful });
+}
+
+namespace {
+
+using CompactKey = Field<int64_t, 11>;
+using CompactCount = Field<uint32_t, 12>;
+using CompactRatio = Field<double, 13>;
+using CompactName = Field<std::string, 14>;
+using CompactDeltas = Field<int32_t, 15, true>;
+using CompactRecord = DbRecord<CompactKey, CompactCount, CompactRatio, CompactName, CompactDeltas>;
+
+}
+
+template <>
+inline constexpr bool compactEncoding_v<CompactRecord> = true;
+
+TEST_CASE("WAL: compact encoding", "[dbwal]")
+{
+	SECTION("Varints")
+	{
+		for (const uint64_t value : { uint64_t{ 0 }, uint64_t{ 127 }, uint64_t{ 128 }, uint64_t{ 16383 }, uint64_t{ 16384 }, uint64_t{ 1'000'000'007 }, std::numeric_limits<uint64_t>::max() })
+		{
+			std::array<uint8_t, compact::MaxVarintSize<uint64_t>> buffer{};
+			const size_t size = compact::encodeVarint(value, buffer.data());
+			REQUIRE(size == compact::varintSize(value));
+
+			uint64_t decoded = 0;
+			REQUIRE(compact::decodeVarint(buffer.data(), size, decoded) == size);
+			REQUIRE(decoded == value);
+			// Cut off
+			REQUIRE(compact::decodeVarint(buffer.data(), size - 1, decoded) == 0);
+
+			// Padded to the full size, it decodes to the same value
+			compact::encodeVarintPadded(value, buffer.data(), buffer.size());
+			REQUIRE(compact::decodeVarint(buffer.data(), buffer.size(), decoded) == buffer.size());
+			REQUIRE(decoded == value);
+		}
+
+		REQUIRE(compact::varintSize(127) == 1);
+		REQUIRE(compact::varintSize(128) == 2);
+		REQUIRE(compact::varintSize(std::numeric_limits<uint64_t>::max()) == 10);
+
+		REQUIRE(compact::zigzagEncode(int32_t{ 0 }) == 0u);
+		REQUIRE(compact::zigzagEncode(int32_t{ -1 }) == 1u);
+		REQUIRE(compact::zigzagEncode(int32_t{ 1 }) == 2u);
+		REQUIRE(compact::zigzagEncode(int16_t{ -2 }) == 3u);
+		for (const int64_t value : { int64_t{ 0 }, int64_t{ -64 }, int64_t{ 64 }, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() })
+			REQUIRE(compact::zigzagDecode<int64_t>(compact::zigzagEncode(value)) == value);
+	}
+
+	SECTION("Operations")
+	{
+		using Serializer = WAL::Serializer<CompactRecord>;
+
+		const CompactRecord record(int64_t{ -3 }, uint32_t{ 200 }, 0.5, std::string(130, 'x'), std::vector<int32_t>{ 1, -1, 100'000, std::numeric_limits<int32_t>::min() });
+		const auto checkRoundTrip = [](const auto& op) {
+			io::VectorAdapter buffer;
+			StorageIO io{ buffer };
+			REQUIRE(Serializer::serialize(op, io));
+			REQUIRE(Serializer::serializedSize(op) == buffer.size());
+
+			REQUIRE(io.seek(0));
+			size_t nReceived = 0;
+			REQUIRE(Serializer::deserialize(io, overload{
+				[&](const std::remove_cvref_t<decltype(op)>& deserialized) {
+					++nReceived;
+					if constexpr (requires { deserialized.keyValue; })
+						REQUIRE(deserialized.keyValue == op.keyValue);
+				},
+				[](const auto&) {
+					FAIL("Unexpected operation type");
+				}
+			}));
+			REQUIRE(nReceived == 1);
+			REQUIRE(io.atEnd());
+		};
+
+		checkRoundTrip(Operation::Insert<CompactRecord>{ record });
+		checkRoundTrip(Operation::Find<CompactRecord, CompactCount, CompactName>{ uint32_t{ 5 }, "Venus" });
+		checkRoundTrip(Operation::UpdateFull<CompactRecord, CompactKey, false>{ record, int64_t{ -1'000'000 } });
+		checkRoundTrip(Operation::AppendToArray<CompactRecord, CompactKey, CompactDeltas, false>{ int64_t{ 7 }, std::vector<int32_t>{ -5, 6 } });
+		checkRoundTrip(Operation::AppendToArray<CompactRecord, CompactName, CompactDeltas, true>{ "Mars", record });
+		checkRoundTrip(Operation::Delete<CompactRecord, CompactKey>{ int64_t{ -42 } });
+		checkRoundTrip(Operation::Delete<CompactRecord, CompactName>{ "Jupiter" });
+	}
+
+	SECTION("Log")
+	{
+		WAL::Options options;
+		options.completionMarkers = WAL::CompletionMarkers::Lazy;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+		options.verificationThreads = GENERATE(1u, 2u);
+		options.flushTimeoutMs = 5;
+
+		// Enough operations for the first one to be too far behind the last block for a footer marker,
+		// so that its marker is logged as an entry with the OpID far from the implied one
+		static constexpr size_t NOperations = 40'000;
+		std::vector<Operation::Insert<CompactRecord>> ops;
+		ops.reserve(NOperations);
+		for (size_t i = 0; i < NOperations; ++i)
+			ops.emplace_back(CompactRecord{ -static_cast<int64_t>(i), static_cast<uint32_t>(i), 0.0, std::to_string(i), std::vector<int32_t>{ static_cast<int32_t>(i) } });
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<CompactRecord, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		const auto firstOpId = wal.registerOperations(std::span<const Operation::Insert<CompactRecord>>{ ops });
+		REQUIRE(firstOpId);
+		// A few more one by one
+		for (size_t i = 0; i < 10; ++i)
+			REQUIRE(wal.registerOperation(Operation::Insert<CompactRecord>{ CompactRecord{ int64_t{ 1 }, uint32_t{ 1 }, 1.0, "x", std::vector<int32_t>{} } }));
+
+		for (size_t i = NOperations - 1'000; i < NOperations; ++i)
+		{
+			if (i % 10 != 0)
+				REQUIRE(wal.updateOpStatus(*firstOpId + static_cast<WAL::OpID>(i), WAL::OpStatus::Successful));
+		}
+		REQUIRE(wal.updateOpStatus(*firstOpId, WAL::OpStatus::Successful));
+		REQUIRE(wal.closeLogFile());
+
+		REQUIRE(wal.openLogFile({}));
+		std::vector<int64_t> pendingKeys;
+		REQUIRE(wal.verifyLog(overload{
+			[&](Operation::Insert<CompactRecord>&& op) {
+				const auto& record = op._record;
+				REQUIRE(record.fieldValue<CompactName>() == (record.fieldValue<CompactKey>() == 1 ? "x" : std::to_string(-record.fieldValue<CompactKey>())));
+				pendingKeys.push_back(record.fieldValue<CompactKey>());
+			},
+			[&](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		}));
+
+		std::vector<int64_t> expectedPendingKeys;
+		for (size_t i = 1; i < NOperations; ++i)
+		{
+			if (i < NOperations - 1'000 || i % 10 == 0)
+				expectedPendingKeys.push_back(-static_cast<int64_t>(i));
+		}
+		expectedPendingKeys.insert(expectedPendingKeys.end(), 10, int64_t{ 1 });
+		REQUIRE(pendingKeys == expectedPendingKeys);
+
+		REQUIRE(wal.closeLogFile());
+	}
+}
+
+TEST_CASE("WAL: record views", "[dbwal]")
+{
+	using FKey = Field<uint64_t, 1>;
+	using F16 = Field<int16_t, 2>;
+	using FName = Field<std::string, 3>;
+	using FArray = Field<uint32_t, 4, true>;
+	using FText = Field<std::string, 5>;
+	using Record = DbRecord<FKey, F16, FName, FArray, FText>;
+	using View = RecordView<Record>;
+
+	const auto checkView = [](const View& view, const Record& record) {
+		REQUIRE(view.fieldValue<FKey>() == record.fieldValue<FKey>());
+		REQUIRE(view.fieldValue<FName>() == record.fieldValue<FName>());
+		REQUIRE(view.fieldValue<F16>() == record.fieldValue<F16>());
+		REQUIRE(view.fieldValue<FArray>() == record.fieldValue<FArray>());
+		REQUIRE(view.fieldValue<FArray>().size() == record.fieldValue<FArray>().size());
+		REQUIRE(view.fieldValue<FText>() == record.fieldValue<FText>());
+		REQUIRE(view.toRecord() == record);
+	};
+
+	SECTION("Serializer")
+	{
+		using Serializer = WAL::Serializer<Record>;
+
+		const Record record(uint64_t{ 42 }, int16_t{ -7 }, std::string{ "Saturn" }, std::vector<uint32_t>{ 1, 2, 0xFFFFFFFF }, std::string(300, 't'));
+		const Record emptyRecord;
+
+		io::VectorAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE(Serializer::serialize(Operation::Insert<Record>{ record }, io));
+		REQUIRE(Serializer::serialize(Operation::Insert<Record>{ emptyRecord }, io));
+		REQUIRE(Serializer::serialize(Operation::UpdateFull<Record, FName, true>{ record, "Titan" }, io));
+		REQUIRE(Serializer::serialize(Operation::AppendToArray<Record, FKey, FArray, true>{ uint64_t{ 5 }, record }, io));
+		REQUIRE(Serializer::serialize(Operation::AppendToArray<Record, FKey, FArray, false>{ uint64_t{ 6 }, std::vector<uint32_t>{ 3, 4 } }, io));
+		REQUIRE(Serializer::serialize(Operation::Find<Record, F16, FText>{ int16_t{ 8 }, "Rhea" }, io));
+		REQUIRE(Serializer::serialize(Operation::Delete<Record, FName>{ "Mimas" }, io));
+
+		REQUIRE(io.seek(0));
+		size_t nReceived = 0;
+		auto receiver = WAL::RecordViews{ overload{
+			[&](Operation::Insert<View>&& op) {
+				checkView(op._record, nReceived == 0 ? record : emptyRecord);
+				++nReceived;
+			},
+			[&](Operation::UpdateFull<View, FName, true>&& op) {
+				checkView(op.record, record);
+				REQUIRE(op.keyValue == "Titan");
+				++nReceived;
+			},
+			[&](Operation::AppendToArray<View, FKey, FArray, true>&& op) {
+				checkView(op.record, record);
+				REQUIRE(op.keyValue == 5);
+				++nReceived;
+			},
+			[&](Operation::AppendToArray<View, FKey, FArray, false>&& op) {
+				REQUIRE(op.array == std::vector<uint32_t>{ 3, 4 });
+				++nReceived;
+			},
+			[&](Operation::Find<View, F16, FText>&& op) {
+				REQUIRE(std::get<0>(op._fields).value == 8);
+				++nReceived;
+			},
+			[&](Operation::Delete<View, FName>&& op) {
+				REQUIRE(op.keyValue == "Mimas");
+				++nReceived;
+			},
+			[](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		} };
+
+		while (!io.atEnd())
+			REQUIRE(Serializer::deserialize(io, receiver));
+		REQUIRE(nReceived == 7);
+	}
+
+	SECTION("Log")
+	{
+		WAL::Options options;
+		options.verificationMode = GENERATE(WAL::VerificationMode::TwoPass, WAL::VerificationMode::SinglePass);
+		options.verificationThreads = GENERATE(1u, 2u);
+		options.flushTimeoutMs = 5;
+
+		// Enough for the multithreaded verification to replay more than one chunk
+		static constexpr size_t NOperations = 3'000;
+		const auto makeRecord = [](const size_t i) {
+			return Record{ uint64_t{ i }, static_cast<int16_t>(i), std::to_string(i), std::vector<uint32_t>(i % 7, static_cast<uint32_t>(i)), std::string(i % 2000, 'a') };
+		};
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+
+		std::vector<Operation::Insert<Record>> ops;
+		ops.reserve(NOperations);
+		for (size_t i = 0; i < NOperations; ++i)
+			ops.emplace_back(makeRecord(i));
+
+		const auto firstOpId = wal.registerOperations(std::span<const Operation::Insert<Record>>{ ops });
+		REQUIRE(firstOpId);
+		for (size_t i = 0; i < NOperations; i += 2)
+			REQUIRE(wal.updateOpStatus(*firstOpId + static_cast<WAL::OpID>(i), WAL::OpStatus::Successful));
+		REQUIRE(wal.closeLogFile());
+
+		REQUIRE(wal.openLogFile({}));
+		size_t nextPending = 1;
+		REQUIRE(wal.verifyLog(WAL::RecordViews{ overload{
+			[&](Operation::Insert<View>&& op) {
+				checkView(op._record, makeRecord(nextPending));
+				nextPending += 2;
+			},
+			[](auto&&) {
+				FAIL("This overload shouldn't be called!");
+			}
+		} }));
+		REQUIRE(nextPending == NOperations + 1);
+
+		REQUIRE(wal.closeLogFile());
+	}
+}
+
+TEST_CASE("WAL: deserializing unknown field IDs", "[dbwal]")
+{
+	using F64 = Field<uint64_t, 1>;
+	using F16 = Field<int16_t, 2>;
+	using FString = Field<std::string, 3>;
+	using FArray = Field<uint32_t, 4, true>;
+
+	using RecordWithArray = DbRecord<F64, F16, FString, FArray>;
+	using Serializer = WAL::Serializer<RecordWithArray>;
+
+	// Composes an entry from the values and deserializes it
+	const auto deserialize = [](const auto&... values) {
+		io::VectorAdapter buffer;
+		StorageIO io{ buffer };
+		REQUIRE((io.write(values) && ...));
+		REQUIRE(io.seek(0));
+
+		size_t nReceived = 0;
+		const bool success = Serializer::deserialize(io, [&](auto&&) { ++nReceived; });
+		REQUIRE(nReceived == (success ? 1u : 0u));
+		return success;
+	};
+
+	REQUIRE(deserialize(OpCode::Delete, uint8_t{ 1 }, uint64_t{ 42 }));
+	REQUIRE(!deserialize(OpCode::Delete, uint8_t{ 0 }, uint64_t{ 42 }));
+	REQUIRE(!deserialize(OpCode::Delete, uint8_t{ 200 }, uint64_t{ 42 }));
+
+	// Key, array, insertIfNotPresent, key value, array
+	REQUIRE(deserialize(OpCode::AppendToArray, uint8_t{ 2 }, uint8_t{ 4 }, false, int16_t{ 5 }, std::vector<uint32_t>{ 7 }));
+	REQUIRE(!deserialize(OpCode::AppendToArray, uint8_t{ 5 }, uint8_t{ 4 }, false, int16_t{ 5 }, std::vector<uint32_t>{ 7 }));
+	// Not an array
+	REQUIRE(!deserialize(OpCode::AppendToArray, uint8_t{ 2 }, uint8_t{ 1 }, false, int16_t{ 5 }, std::vector<uint32_t>{ 7 }));
+
+	// The field count, the IDs, the values
+	REQUIRE(deserialize(OpCode::Find, uint8_t{ 2 }, uint8_t{ 2 }, uint8_t{ 1 }, int16_t{ 5 }, uint64_t{ 42 }));
+	REQUIRE(deserialize(OpCode::Find, uint8_t{ 1 }, uint8_t{ 1 }, uint64_t{ 42 }));
+	REQUIRE(!deserialize(OpCode::Find, uint8_t{ 2 }, uint8_t{ 2 }, uint8_t{ 99 }, int16_t{ 5 }, uint64_t{ 42 }));
+	REQUIRE(!deserialize(OpCode::Find, uint8_t{ 2 }, uint8_t{ 99 }, uint8_t{ 2 }, uint64_t{ 42 }, int16_t{ 5 }));
+}
+
+TEST_CASE("WAL: adaptive flush timeout", "[dbwal]")
+{
+	static constexpr uint64_t MaxTimeoutUs = 50'000;
+	static constexpr uint64_t LatencyTargetUs = 10'000;
+	static constexpr size_t BlockCapacity = 4000;
+
+	uint64_t timeStamp = 1'000'000;
+	SECTION("A lone writer stops waiting")
+	{
+		WAL::AdaptiveFlushTimeout timeout{ MaxTimeoutUs, LatencyTargetUs, BlockCapacity };
+		REQUIRE(timeout.timeoutUs() == LatencyTargetUs);
+
+		// Nothing else arrives while the only writer waits for its own block
+		for (int i = 0; i < 20; ++i)
+		{
+			timeStamp += timeout.timeoutUs() + 100;
+			timeout.blockSealed(1, 50, timeStamp, true);
+			timeout.flushed(100);
+		}
+
+		REQUIRE(timeout.timeoutUs() == 0);
+		const auto stats = timeout.stats();
+		REQUIRE(stats.flushLatencyUs == 100);
+		REQUIRE(stats.arrivalRateOpsPerSecond > 0.0);
+	}
+
+	SECTION("Concurrent writers")
+	{
+		WAL::AdaptiveFlushTimeout timeout{ MaxTimeoutUs, LatencyTargetUs, BlockCapacity };
+		for (int i = 0; i < 10; ++i)
+		{
+			timeStamp += 1000;
+			timeout.blockSealed(1, 50, timeStamp, true);
+		}
+		const uint64_t loneWriterTimeout = timeout.timeoutUs();
+
+		// 5 ops of 50 bytes per 1 ms: a block fills up in 16 ms, which is more than the latency target allows
+		for (int i = 0; i < 50; ++i)
+		{
+			timeStamp += 1000;
+			timeout.blockSealed(5, 250, timeStamp, true, timeout.timeoutUs());
+			timeout.flushed(1000);
+		}
+
+		REQUIRE(timeout.timeoutUs() > loneWriterTimeout);
+		const auto stats = timeout.stats();
+		REQUIRE(stats.flushLatencyP99Us == 1000);
+		REQUIRE(timeout.timeoutUs() == LatencyTargetUs - stats.flushLatencyP99Us);
+		REQUIRE(stats.arrivalRateOpsPerSecond == Approx(5000.0).epsilon(0.01));
+
+		// The arrival rate triples: now a block fills up sooner than that
+		for (int i = 0; i < 50; ++i)
+		{
+			timeStamp += 1000;
+			timeout.blockSealed(15, 750, timeStamp, false);
+		}
+		REQUIRE(timeout.timeoutUs() == Approx(BlockCapacity * 1000 / 750).margin(10));
+	}
+
+	SECTION("Writers arriving together")
+	{
+		// E. g. a fixed number of writers, each waiting for its previous commit: they all show up within 100 us, and the rest of the wait is wasted
+		WAL::AdaptiveFlushTimeout timeout{ MaxTimeoutUs, LatencyTargetUs, BlockCapacity };
+		for (int i = 0; i < 50; ++i)
+		{
+			timeStamp += timeout.timeoutUs() + 100;
+			timeout.blockSealed(8, 400, timeStamp, true, 100);
+			timeout.flushed(100);
+		}
+
+		REQUIRE(timeout.timeoutUs() >= 200);
+		REQUIRE(timeout.timeoutUs() <= 250);
+	}
+
+	SECTION("Slow flushes")
+	{
+		WAL::AdaptiveFlushTimeout timeout{ MaxTimeoutUs, LatencyTargetUs, BlockCapacity };
+		for (int i = 0; i < 50; ++i)
+		{
+			timeout.flushed(i % 2 == 0 ? 6000 : 8000);
+			timeStamp += 1000;
+			timeout.blockSealed(5, 250, timeStamp, true, timeout.timeoutUs());
+		}
+
+		// The mean of 7 ms and the deviation of 1 ms leave no time for waiting
+		REQUIRE(timeout.stats().flushLatencyP99Us >= LatencyTargetUs);
+		REQUIRE(timeout.timeoutUs() == 0);
+	}
+}
+
+TEST_CASE("DbWAL: adaptive flush timeout", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		WAL::Options options;
+		options.flushTimeoutMode = WAL::FlushTimeoutMode::Adaptive;
+		options.flushMode = GENERATE(WAL::FlushMode::Inline, WAL::FlushMode::FlusherThread);
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+		REQUIRE(wal.stats().flushTimeout.timeoutUs == options.commitLatencyTargetUs);
+
+		// A lone writer gains nothing from waiting, 200 waits of 10 ms would take 2 s
+		static constexpr size_t NOperations = 200;
+		const auto timeStart = timeElapsedMs();
+		for (size_t i = 0; i < NOperations; ++i)
+			REQUIRE(wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i } } }));
+
+		REQUIRE(timeElapsedMs() - timeStart < 1000);
+		const auto stats = wal.stats().flushTimeout;
+		REQUIRE(stats.timeoutUs == 0);
+		REQUIRE(stats.arrivalRateOpsPerSecond > 0.0);
+
+		REQUIRE(wal.closeLogFile());
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("DbWAL: statistics", "[dbwal]")
+{
+	try {
+		using F64 = Field<uint64_t, 1>;
+		using Record = DbRecord<F64>;
+
+		static constexpr size_t NOperations = 10;
+
+		WAL::Options options;
+		options.flushTimeoutMs = 1;
+		options.flushMode = GENERATE(WAL::FlushMode::Inline, WAL::FlushMode::FlusherThread);
+		options.latencyStats = GENERATE(false, true);
+
+		io::VectorAdapter walDataBuffer(100000);
+		DbWAL<Record, decltype(walDataBuffer)> wal{ walDataBuffer, options };
+		REQUIRE(wal.openLogFile({}));
+		REQUIRE(wal.stats().blockCount == 0);
+
+		SECTION("Blocks sealed on timeout")
+		{
+			// A lone writer: every operation and every completion marker goes into a block of its own
+			for (size_t i = 0; i < NOperations; ++i)
+			{
+				const auto opId = wal.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i } } });
+				REQUIRE(opId);
+				REQUIRE(wal.updateOpStatus(*opId, WAL::OpStatus::Successful));
+			}
+			REQUIRE(wal.closeLogFile());
+
+			const auto stats = wal.stats();
+			REQUIRE(stats.operationCount == NOperations);
+			REQUIRE(stats.completionMarkerCount == NOperations);
+			REQUIRE(stats.blockCount == 2 * NOperations);
+			REQUIRE(stats.timeoutBlockCount == stats.blockCount);
+			REQUIRE(stats.fullBlockCount == 0);
+			REQUIRE(stats.closeBlockCount == 0);
+
+			REQUIRE(stats.bytesWritten == walDataBuffer.size());
+			REQUIRE(stats.paddingBytesWritten < stats.bytesWritten);
+			REQUIRE(stats.maxBlockFill < 512);
+			REQUIRE(stats.blockFillHistogram[0] == stats.blockCount);
+
+			REQUIRE(stats.groupCommitCount == stats.blockCount);
+			REQUIRE(stats.maxBlocksPerGroupCommit == 1);
+			REQUIRE(stats.groupCommitTimeUs.count == stats.groupCommitCount);
+			REQUIRE(stats.blockLockHoldTimeUs.count == stats.blockCount);
+
+			if (options.latencyStats)
+			{
+				// Every call waits out the 1 ms timeout
+				REQUIRE(stats.commitLatencyUs.count == 2 * NOperations);
+				REQUIRE(stats.flushWaitTimeUs.count == 2 * NOperations);
+				REQUIRE(stats.commitLatencyUs.percentile(50) >= 1000);
+				REQUIRE(stats.commitLatencyUs.mean() >= 1000.0);
+				REQUIRE(stats.flushWaitTimeUs.sum <= stats.commitLatencyUs.sum);
+			}
+			else
+			{
+				REQUIRE(stats.commitLatencyUs.count == 0);
+				REQUIRE(stats.flushWaitTimeUs.count == 0);
+			}
+		}
+
+		SECTION("Full blocks")
+		{
+			// The threshold seals every block as soon as it has an entry, except for the lazy markers, which only go out on closing the log
+			options.flushThresholdOps = 1;
+			DbWAL<Record, decltype(walDataBuffer)> walWithThreshold{ walDataBuffer, options };
+			REQUIRE(wal.closeLogFile());
+			REQUIRE(walWithThreshold.openLogFile({}));
+			for (size_t i = 0; i < NOperations; ++i)
+				REQUIRE(walWithThreshold.registerOperation(Operation::Insert<Record>{ Record{ uint64_t{ i } } }));
+			REQUIRE(walWithThreshold.closeLogFile());
+
+			const auto stats = walWithThreshold.stats();
+			REQUIRE(stats.operationCount == NOperations);
+			REQUIRE(stats.blockCount == NOperations);
+			REQUIRE(stats.fullBlockCount == NOperations);
+			REQUIRE(stats.timeoutBlockCount == 0);
+
+			// Another instance's counters are separate
+			REQUIRE(wal.stats().operationCount == 0);
+		}
+	}
+	catch (const std::exception& e) {
+		FAIL(e.what());
+	}
+}
+
+TEST_CASE("WAL: statistics histogram", "[dbwal]")
+{
+	WAL::Histogram histogram;
+	REQUIRE(histogram.percentile(99) == 0);
+	REQUIRE(histogram.mean() == 0.0);
+
+	// 90 values of 10 and 10 of 1000
+	for (const auto& [value, count] : { std::pair{ uint64_t{ 10 }, uint64_t{ 90 } }, std::pair{ uint64_t{ 1000 }, uint64_t{ 10 } } })
+	{
+		histogram.buckets[WAL::Histogram::bucketIndex(value)] += count;
+		histogram.count += count;
+		histogram.sum += value * count;
+		histogram.max = std::max(histogram.max, value);
+	}
+
+	REQUIRE(WAL::Histogram::bucketIndex(0) == 0);
+	REQUIRE(WAL::Histogram::bucketIndex(1) == 1);
+	REQUIRE(WAL::Histogram::bucketIndex(10) == 4);
+	REQUIRE(WAL::Histogram::bucketIndex(std::numeric_limits<uint64_t>::max()) == WAL::Histogram::BucketCount - 1);
 
-	printf("Max fill: %ld, avg. fill: %ld\n", (long)maxFill.load(), (long)totalSizeWritten.load() / (long)totalBlockCount.load());
+	REQUIRE(histogram.mean() == 109.0);
+	REQUIRE(histogram.percentile(50) == 15); // The upper bound of [8, 16)
+	REQUIRE(histogram.percentile(89) == 15);
+	REQUIRE(histogram.percentile(95) == 1000); // [512, 1024) is capped by the maximum
+	REQUIRE(histogram.percentile(100) == 1000);
+}
+
+TEST_CASE("WAL: pending operations", "[dbwal]")
+{
+	WAL::PendingOperations pending;
+	REQUIRE(pending.empty());
+	REQUIRE(!pending.oldest());
+
+	for (WAL::OpID id = 100; id < 300; ++id)
+		pending.insert(id);
+	REQUIRE(pending.size() == 200);
+	REQUIRE(pending.oldest() == 100u);
+
+	// Completing out of order
+	REQUIRE(pending.remove(150));
+	REQUIRE(!pending.remove(150));
+	REQUIRE(!pending.contains(150));
+	REQUIRE(pending.oldest() == 100u);
+
+	for (WAL::OpID id = 100; id < 200; ++id)
+		REQUIRE(pending.remove(id) == (id != 150));
+	REQUIRE(pending.oldest() == 200u);
+	REQUIRE(!pending.contains(100));
+	REQUIRE(!pending.remove(99));
+
+	// Added after the window has moved past it
+	pending.insert(120);
+	REQUIRE(pending.oldest() == 120u);
+	REQUIRE(pending.contains(120));
+	REQUIRE(pending.remove(120));
+	REQUIRE(pending.oldest() == 200u);
+
+	for (WAL::OpID id = 299; id >= 200; --id)
+		REQUIRE(pending.remove(id));
+	REQUIRE(pending.empty());
+	REQUIRE(!pending.oldest());
+
+	// A gap in the IDs, as between the sessions of a segmented log
+	pending.insert(1'000'000);
+	REQUIRE(pending.oldest() == 1'000'000u);
+	REQUIRE(pending.size() == 1);
 }
 
 /* Entry structure :
@@ -61,6 +61,9 @@ INCLUDEPATH += \
 SOURCES += tests_main.cpp \
 #	benchmarks/dbfilegaps_benchmarks.cpp \
 	benchmarks/dbindex_benchmarks.cpp \
+	benchmarks/dbrecord_benchmarks.cpp \
+	benchmarks/dbwal_benchmarks.cpp \
+	benchmarks/dbwal_replay_benchmarks.cpp \
 	dbfield_tests.cpp \
 #	dbfilegaps_tester.cpp \
 	cpp-db_sanity_checks.cpp \
@@ -73,7 +76,8 @@ SOURCES += tests_main.cpp \
 	dbrecord_tests.cpp \
 	dbstorage_tests.cpp \
 	dbwal_tests.cpp \
-	index_test_helpers.cpp
+	index_test_helpers.cpp \
+	utils_tests.cpp
 
 HEADERS += \
 	dbfilegaps_tester.hpp
@@ -0,0 +1,30 @@
+#include "3rdparty/catch2/catch.hpp"
+#include "utils/crc32c.hpp"
+
+#include "random/randomnumbergenerator.h"
+
+#include <string_view>
+#include <vector>
+
+TEST_CASE("CRC32C", "[utils]")
+{
+	// The check value of the algorithm
+	static constexpr std::string_view checkInput = "123456789";
+	REQUIRE(crc32c(checkInput.data(), checkInput.size()) == 0xE3069283);
+	REQUIRE(crc32cSoftware(checkInput.data(), checkInput.size()) == 0xE3069283);
+	REQUIRE(crc32c(nullptr, 0) == 0);
+
+	// All the lengths and alignments of the tail handling
+	RandomNumberGenerator<uint32_t> rng{ 42, 0, 255 };
+	std::vector<uint8_t> data(4096 + 16);
+	for (auto& byte : data)
+		byte = static_cast<uint8_t>(rng.rand());
+
+	for (size_t offset = 0; offset < 8; ++offset)
+	{
+		for (size_t size = 0; size <= 64; ++size)
+			REQUIRE(crc32c(data.data() + offset, size) == crc32cSoftware(data.data() + offset, size));
+
+		REQUIRE(crc32c(data.data() + offset, 4096) == crc32cSoftware(data.data() + offset, 4096));
+	}
+}